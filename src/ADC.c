@@ -2,13 +2,33 @@
  *
  *  @brief Analog-to-Digital Converter module.
  *
- *  This contains the functions for converting analog signals to digital.
+ *  This contains the functions for converting analog signals to digital. The
+ *  converter runs in the background, one reading per timer tick, taking each
+ *  channel in turn and keeping a running average of its latest readings. A tick
+ *  either takes a reading and moves on to the next channel, or starts that channel
+ *  converting once its holding capacitor has had a tick to charge.
  *
  *  @author A.Pope
  *  @date 02-08-2016
  */
 #include "ADC.h"
 
+#define ADC_WINDOW 8  //Readings of each channel in its running average (a power of two, so the average is a shift)
+#define ADC_SHIFT  3  //log2(ADC_WINDOW)
+#define ADC_FILL_MS ((2 * ADC_CHANNELS * ADC_WINDOW) + 2) //Longest a window takes to fill after ADC_Restart (1ms ticks), with a tick to spare either end
+#define ADC_WAIT_US 100 //Time between checks of a window that is still filling
+
+#if ((2 * ADC_CHANNELS * ADC_WINDOW) != ADC_WINDOW_MS)
+#error "ADC_WINDOW_MS must be the ticks a window of readings takes"
+#endif
+
+static volatile uint16_t window[ADC_CHANNELS][ADC_WINDOW]; /*< The latest readings, oldest overwritten first */
+static volatile uint16_t windowSum[ADC_CHANNELS];          /*< Sum of the readings in each window */
+static volatile uint8_t windowLen[ADC_CHANNELS];           /*< Readings in each window, up to ADC_WINDOW */
+static uint8_t windowNext[ADC_CHANNELS];                   /*< Next reading to overwrite in each window */
+static uint8_t channel;                                    /*< Channel being converted */
+static bool acquiring;                                     /*< TRUE while the channel settles before it is converted */
+
 bool ADC_Init(void) {
   //Clear PORTA and Set to Input
   PORTA = 0;
@@ -19,7 +39,7 @@ bool ADC_Init(void) {
   ADCON1bits.ADCS2 = 0; //Clock: Fosc/32
   ADCON0bits.ADCS1 = 1;
   ADCON0bits.ADCS0 = 0;
-  ADCON0bits.CHS2 = 0;  //We are using channel 0 (AN0) for IR sensor
+  ADCON0bits.CHS2 = 0;  //Start with channel 0 (AN0), channel 1 (AN1) is taken in turn with it
   ADCON0bits.CHS1 = 0;
   ADCON0bits.CHS0 = 0;
 
@@ -33,18 +53,73 @@ bool ADC_Init(void) {
 
   __delay_us(50);       // Delay for ADC acquisition
 
+  ADC_Restart();
+  channel = ADC_SHORT_IR;
+  acquiring = false;
+  GO = 1;               // Start the first conversion, the timer tick picks it up
+  
   return true;
 }
 
-unsigned int ADC_GetVal(void) {
-  volatile unsigned int adcRAW;
-  ADRESH = 0;          // Reset the ADRES value registers
-  ADRESL = 0;
-  
-  GO = 1;              // Start the ADC process
-  while (GO) continue; // Wait for conversion complete
+void ADC_Sample(void) {
+  uint16_t adcRAW;
+  uint8_t next;
+
+  if (acquiring) {
+    acquiring = false;
+    GO = 1; //The channel has had a tick to settle, so convert it
+    return;
+  }
+
+  if (GO)
+    return; //Still converting, try again next tick
 
   //Get the 10-bits from the ADRES registers (right-justified)
   adcRAW = (ADRESL + (ADRESH * 256));
-  return (adcRAW);
-}
\ No newline at end of file
+
+  //Replace the oldest reading in the channel's window, keeping the sum up to date
+  next = windowNext[channel];
+  windowSum[channel] = (windowSum[channel] - window[channel][next]) + adcRAW;
+  window[channel][next] = adcRAW;
+  windowNext[channel] = (next + 1) % ADC_WINDOW;
+  if (windowLen[channel] < ADC_WINDOW)
+    windowLen[channel]++;
+
+  //Move on to the next channel, and let it settle until the next tick before converting it
+  channel = (channel + 1) % ADC_CHANNELS;
+  ADCON0bits.CHS0 = channel;
+  acquiring = true;
+}
+
+uint16_t ADC_GetAverage(uint8_t chan) {
+  uint16_t sum, waits = ADC_FILL_MS * (1000 / ADC_WAIT_US);
+  bool tick = INTCONbits.T0IE;
+
+  //Wait for a full window of readings, but only while the tick is running to take them
+  while ((windowLen[chan] < ADC_WINDOW) && tick && waits--)
+    __delay_us(ADC_WAIT_US);
+  if (windowLen[chan] < ADC_WINDOW)
+    return ADC_NOT_READY;
+
+  INTCONbits.T0IE = 0; //The sum is two bytes, so don't let the tick change it half way through reading it
+  sum = windowSum[chan];
+  INTCONbits.T0IE = tick;
+
+  return ((sum + (ADC_WINDOW / 2)) >> ADC_SHIFT); //Rounded to the nearest ADC value
+}
+
+void ADC_Restart(void) {
+  uint8_t i, chan;
+  bool tick = INTCONbits.T0IE;
+
+  INTCONbits.T0IE = 0;
+  for (chan = 0; chan < ADC_CHANNELS; chan++) {
+    for (i = 0; i < ADC_WINDOW; i++) {
+      window[chan][i] = 0;
+    }
+    windowSum[chan] = 0;
+    windowLen[chan] = 0;
+    windowNext[chan] = 0;
+  }
+  INTCONbits.T0IE = tick;
+}
@@ -15,17 +15,42 @@ extern "C" {
 #endif
 #include "types.h"
 
+/* Channels converted in the background */
+#define ADC_SHORT_IR 0 /* AN0 - Short Range IR */
+#define ADC_LONG_IR  1 /* AN1 - Long Range IR */
+#define ADC_CHANNELS 2
+
+#define ADC_NOT_READY 0xFFFF /* ADC_GetAverage of a window that hasn't filled, above any 10-bit value */
+#define ADC_WINDOW_MS 32     /* Time (ms) a running average spans, so the most its readings lag by */
+
 /*! @brief Sets up the ADC before first use.
  *
  *  @return bool - TRUE if the ADC was successfully initialized.
  */
 bool ADC_Init(void);
 
-/*! @brief Returns a digital value (converted from analog)
+/*! @brief Takes the last conversion into its channel's running average and starts
+ *         the next channel converting.
  *
- *  @return value - The converted digital value
+ *  @note Called from the timer interrupt every tick (1ms). A reading and the start of the
+ *        next conversion take a tick each, so each channel is read every 2 * ADC_CHANNELS ticks.
+ */
+void ADC_Sample(void);
+
+/*! @brief Returns the running average of the latest digital values (converted from analog)
+ *         of a channel
+ *
+ *  @param chan - The channel (ADC_SHORT_IR or ADC_LONG_IR)
+ *  @return value - The average converted digital value, ADC_NOT_READY if the window isn't full
+ *  @note Waits for the window to fill after ADC_Restart (up to about 34ms), but only while the
+ *        timer interrupt is enabled. With it off the window can't fill, so there is no wait.
+ */
+uint16_t ADC_GetAverage(uint8_t chan);
+
+/*! @brief Throws away the readings in the running averages of every channel, e.g. once
+ *         the sensors have been turned to face somewhere else.
  */
-unsigned int ADC_GetVal(void);
+void ADC_Restart(void);
 
 #ifdef	__cplusplus
 }
@@ -2,84 +2,79 @@
  *
  *  @brief Routines for the IR sensor.
  *
- *  This contains the functions for operating the Infra-Red (IR) distance sensor.
+ *  This contains the functions for operating the Infra-Red (IR) distance sensors.
  *
  *  @author Andrew.P, Andrew.T
  *  @date 02-08-2016
  */
-#include <math.h>
 #include "IR.h"
 #include "ADC.h"
+#include "IRTABLE.h" //Generated by tools/irgen.py from the sensor calibration
+
+#ifdef IR_LONG_RANGE
+#define IR_BLEND_NEAR 1000 //Short range readings closer than this (mm) are used alone, the long range sensor can't see them
+#define IR_BLEND_FAR  1500 //Short range readings from this far (mm) have seen nothing, so the long range is used alone
+#endif
+
+/* Private function prototypes */
+static uint16_t shortDistance(uint16_t data);
+#ifdef IR_LONG_RANGE
+static uint16_t longDistance(uint16_t data);
+#endif
+/* End Private function prototypes */
 
 bool IR_Init(void) {
   return ADC_Init();
 }
 
-/*! @brief Determines the distance from a raw ADC value.
+/*! @brief Converts a short range reading to a distance.
  *
- *  @param ADCdata - The raw ADC data to convert
- *  @return distance - The distance in mm
+ *  @param data - The averaged ADC data to convert
+ *  @return distance - The distance in mm, 0 if closer than the sensor is calibrated for (or
+ *                     there is no reading, ADC_NOT_READY is above the table)
  */
-static double calcDistance(double ADCdata) {
-  /* The following uses ranges of raw ADC data, to select the most 'accurate'
-   * distance conversion equation.
-   */
-  double dist_cm = 0;
+static uint16_t shortDistance(uint16_t data) {
+  if (data >= IR_TABLE_SIZE)
+    return 0; //Closer than the sensor is calibrated for
 
-  if( ADCdata >= 379 && ADCdata < 510 ){  //20-30
-    dist_cm = ((ADCdata-772)/-13.1); 
-  } 
-  else if ( ADCdata >= 295 && ADCdata < 379 ){ //30-40
-    dist_cm = ((ADCdata-631)/-8.4);
-  }
-  else if ( ADCdata >= 240 && ADCdata < 295 ){  //40-50
-    dist_cm = ((ADCdata-515)/-5.5);
-  }
-  else if ( ADCdata >= 197 && ADCdata < 240 ){  //50-60
-    dist_cm = ((ADCdata-455)/-4.3);
-  }
-  else if ( ADCdata >= 173 && ADCdata < 197){  //60-70
-    dist_cm = ((ADCdata-341)/-2.4);
-  }
-  else if ( ADCdata >= 153 && ADCdata < 173){  //70-80
-    dist_cm = ((ADCdata-313)/-2);
-  }
-  else if ( ADCdata >= 137 && ADCdata < 153 ){  //80-90
-    dist_cm = ((ADCdata-281)/-1.6);
-  }
-  else if ( ADCdata >= 122 && ADCdata < 137){  //90-100
-    dist_cm = ((ADCdata-272)/-1.5);
-  }
-  else if ( ADCdata >= 108 && ADCdata < 122){  //100-110
-    dist_cm = ((ADCdata-262)/-1.4);
-  }
-  else if ( ADCdata >= 99 && ADCdata < 108 ){ //110-120
-    dist_cm = ((ADCdata - 207)/-0.9);
-  }
-  else if ( ADCdata >= 91 && ADCdata < 99 ){  //120-130
-    dist_cm = ((ADCdata-195)/-0.8);           //the equation between 120-140 is the same
-  }
-  else if ( ADCdata >= 83 && ADCdata < 91 ){  //130-140
-    dist_cm = ((ADCdata - 195)/-0.8);
-  }
-  else if ( ADCdata >= 78 && ADCdata < 83 ){  //140-150
-    dist_cm = ((ADCdata - 152)/-0.5);
-  }
-  else if (ADCdata >= 0 && ADCdata < 84){
-    dist_cm = 150;
-  }
-  
-  return (dist_cm * 10); //Convert to mm before returning
+  return IrDistance[data];
 }
-  
-double IR_Measure(void) {
-  double data = 0;
 
-  /* Get 20 samples from the ADC module and find the average */
-  for (int i = 0; i < 20; i++) {
-    data += ADC_GetVal();
-  }
-  data = (data / 20);
+#ifdef IR_LONG_RANGE
+/*! @brief Converts a long range reading to a distance.
+ *
+ *  @param data - The averaged ADC data to convert
+ *  @return distance - The distance in mm, 0 if outside of what the sensor can measure
+ */
+static uint16_t longDistance(uint16_t data) {
+  if (data < IR_LONG_FIRST || data >= (IR_LONG_FIRST + IR_LONG_SIZE))
+    return 0; //Too far to see, or too close to tell apart from far
+
+  return IrLongDistance[data - IR_LONG_FIRST];
+}
+#endif
+
+uint16_t IR_Measure(void) {
+  //Averages of the latest readings, kept by the timer interrupt
+  uint16_t shortDist = shortDistance(ADC_GetAverage(ADC_SHORT_IR));
+#ifdef IR_LONG_RANGE
+  uint16_t longDist = longDistance(ADC_GetAverage(ADC_LONG_IR));
+  int32_t weight;
+
+  if (shortDist < IR_BLEND_NEAR || longDist == 0)
+    return shortDist; //Only the short range sensor can measure this
   
-  return calcDistance(data);  //Returns the converted ADC value to distance in mm
-}
\ No newline at end of file
+  if (shortDist >= IR_BLEND_FAR)
+    return longDist;  //Further than the short range sensor can see
+
+  //Both can see the wall, so trust the long range sensor more the further away it is
+  weight = shortDist - IR_BLEND_NEAR;
+  return (uint16_t) (shortDist + ((((int32_t) longDist - shortDist) * weight) / (IR_BLEND_FAR - IR_BLEND_NEAR)));
+#else
+  return shortDist;
+#endif
+}
+
+void IR_Restart(void) {
+  ADC_Restart();
+}
@@ -2,7 +2,7 @@
  *
  *  @brief Routines for the IR sensor.
  *
- *  This contains the functions for operating the Infra-Red (IR) distance sensor.
+ *  This contains the functions for operating the Infra-Red (IR) distance sensors.
  *
  *  @author Andrew.P, Andrew.T
  *  @date 02-08-2016
@@ -15,17 +15,36 @@ extern "C" {
 #endif
 #include "types.h"
 
-/*! @brief Sets up the IR sensor peripheral before first use.
+/* Define IR_LONG_RANGE to blend in the long range sensor on AN1 from 1m. Its table in IRTABLE.h
+ * is the typical curve from the datasheet, not one measured on the robot, so it is off until the
+ * sensor has been calibrated (see tools/irgen.py). Without it the short range sensor is used alone.
+ */
+//#define IR_LONG_RANGE
+
+/*! @brief Sets up the IR sensor peripherals before first use.
  *
  *  @return bool - TRUE if the IR sensor was successfully initialized.
  */
 bool IR_Init(void);
 
-/*! @brief The IR sensor will perform a distance measurement
+/*! @brief Returns the distance the IR sensors currently measure, averaged over the
+ *         latest readings.
+ *
+ *  With IR_LONG_RANGE, the short range sensor is used up to 1m and the long range sensor
+ *  past 1.5m. In between, the two are blended, trusting the long range sensor more the
+ *  further away the wall is.
+ *
+ *  @return distance - Returns the measured distance in mm (0 if closer than 200mm, or if the
+ *                     short range sensor has no readings, e.g. the timer interrupt is off)
+ */
+uint16_t IR_Measure(void);
+
+/*! @brief Forgets the readings taken so far, so the next measurement is only of where
+ *         the sensor faces now.
  *
- *  @return distance - Returns the measured distance in mm
+ *  @note Call after turning the sensor. The next IR_Measure waits for fresh readings.
  */
-double IR_Measure(void);
+void IR_Restart(void);
 #ifdef	__cplusplus
 }
 #endif
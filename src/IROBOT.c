@@ -8,11 +8,14 @@
  *  @author A.Pope, K.Leone, C.Stewart, J.Lynch
  *  @date 02-09-2016
  */
+#include "ADC.h"
 #include "IR.h"
 #include "EEPROM.h"
 #include "USART.h"
 #include "PATH.h"
+#include "TOUR.h"
 #include "MOVE.h"
+#include "POSE.h"
 #include "SM.h"
 #include "OPCODES.h"
 #include "IROBOT.h"
@@ -37,49 +40,77 @@ __EEPROM_DATA(9, 10, 11, 12, 13, 14, 15, 16);
 #define DRIVE_TURN_SPEED  330
 #define DRIVE_ROTATE_SPEED 210
 #define ANGLE_ER 3
+#define BOX_LENGTH POSE_BOX_LENGTH //Distance between the centres of two boxes (mm)
+#define EXPLORE_WALL_DIST 800 //An IR reading closer than this (mm) is a wall on the side of the box being scanned
+#define IR_STEPS_45 (SM_STEPS_FOR_180 / 4) //Stepper half-steps to turn the IR 45 degrees
+#define IR_FRONT    0                      //IR orientations (stepper half-steps CW from facing forward)
+#define IR_RIGHT_45 IR_STEPS_45
+#define IR_BACK     SM_STEPS_FOR_180
+#define IR_LEFT_45  ((SM_STEPS_FOR_180 * 2) - IR_STEPS_45)
+#define APPROACH_STOP_DIST 500  //Front wall approaches stop this far (mm) from the wall
+#define APPROACH_SLOW_DIST 1000 //Front wall approaches slow down from top speed this close (mm) to the wall
+#define LEAVE_STOP_DIST    900  //Back wall departures stop this far (mm) from the wall
+#define RUN_MAX_BOXES      30   //Most boxes driven in one run, so its length (mm) fits an int16_t
+#define RUN_POINTS (MAZE_NUM_WAYPOINTS + 1) //The way-points of a lap from the maze definition, then home
+
+#if (RUN_POINTS > TOUR_MAX_POINTS)
+#error "The maze has more way-points than TOUR can order, raise TOUR_MAX_POINTS"
+#endif
 
 /* Private function prototypes */
-static void resetIRPos(void);
+static void faceIR(uint16_t orientation);
 static void loadSongs(void);
 static void playSong(uint8_t songNo);
 static bool moveForwardFrom(TORDINATE ord, TSENSORS * sens, int16_t * movBack);
+static bool moveAlong(TORDINATE * ord, TSENSORS * sens, int16_t * movBack, bool * vicsFound);
+static bool driveRun(TORDINATE * ord, TPATH_ORD boxes, TSENSORS * sens, int16_t * movBack, bool * vicsFound);
+static int16_t runTravelled(TORDINATE start, uint8_t heading);
+static bool onRun(TORDINATE start, uint8_t heading, TPATH_ORD boxes, TORDINATE cell);
 static bool findNextSquare(TORDINATE currOrd, bool doRotate);
-static int16_t getNextPathVal(TORDINATE currOrd);
 static bool areAllVictimsFound(TORDINATE curr);
+static void scanBox(TORDINATE ord);
+static void returnHome(TORDINATE currOrd, TORDINATE home);
 static bool victimFound(void);
 static bool wallFollow(TDIRECTION irDir, TSENSORS * sens, int16_t moveDist, int16_t * movBack);
+static bool approachFrontWall(TSENSORS * sens, int * dist);
+static bool leaveBackWall(TSENSORS * sens, int * dist);
 static bool errorHandle(TORDINATE ord, TORDINATE wayP, TSENSORS sensor, int16_t movBack);
 /* End Private function prototypes */
 
 bool IROBOT_Init(void){
-  return (USART_Init() && IR_Init() && SM_Init() && MOVE_Init() && PATH_Init());
+  return (USART_Init() && IR_Init() && SM_Init() && MOVE_Init() && PATH_Init() && POSE_Init() && TOUR_Init());
 }
 
 void IROBOT_Start(void){
+  static const uint8_t fullMode[] = {OP_START, OP_FULL};
+
   //Put the IROBOT in full control mode and load songs
-  USART_OutChar(OP_START);
-  USART_OutChar(OP_FULL);
+  USART_Write(fullMode, sizeof(fullMode));
   loadSongs();
+  MOVE_StartStream(); //Sensors are streamed from now on
 }
 
 void IROBOT_MazeRun(void){
   bool bothVicsFound = false; TSENSORS sens;
-  uint8_t i = 0; int16_t movBack = 0;
+  uint8_t i = 0; int16_t movBack = 0; uint8_t mapVersion;
   
-  /* Initialize way-points */
-  TORDINATE home = {1, 3};
-  TORDINATE currOrd = {1, 3};
-  TORDINATE wayP1 = {2, 3};
-  TORDINATE wayP2 = {3, 2};
-  TORDINATE wayP3 = {3, 3};
-  TORDINATE wayP4 = {3, 1};
-  TORDINATE wayP5 = {0, 0};
-  TORDINATE wayP6 = {2, 1};
+  /* Initialize way-points, as marked in the maze definition */
+  static const TORDINATE wayPoints[MAZE_NUM_WAYPOINTS] = MAZE_WAYPOINTS;
+  TORDINATE home = MAZE_HOME;
+  TORDINATE currOrd = MAZE_HOME;
   
   /* Initialize the list of way-points */
-  TORDINATE wayList[7];
-  wayList[0] = wayP1; wayList[1] = wayP2; wayList[2] = wayP3; wayList[3] = wayP4;
-  wayList[4] = wayP5; wayList[5] = wayP6; wayList[6] = home;
+  TORDINATE wayList[RUN_POINTS];
+  for(i = 0; i < MAZE_NUM_WAYPOINTS; i++){
+    wayList[i] = wayPoints[i];
+  }
+  wayList[MAZE_NUM_WAYPOINTS] = home;
+  i = 0;
+
+  //Visit the way-points in the order that reaches them soonest
+  TOUR_Order(currOrd, wayList, RUN_POINTS);
+  mapVersion = PATH_GetMapVersion();
+  POSE_Set(home, PATH_GetHeading()); //The run starts lined up in the home box
 
   while(!bothVicsFound){
     //Loop through WayPoint List and continue to move around the maze, until both victims are found
@@ -95,34 +126,83 @@ void IROBOT_MazeRun(void){
         
         //Find next square to move to, and rotate robot to face
         findNextSquare(currOrd, true);                
-        if(moveForwardFrom(currOrd, &sens, &movBack)) //If a Sensor was triggered during the move forward routine
+        if(moveAlong(&currOrd, &sens, &movBack, &bothVicsFound)) //If a Sensor was triggered during the move forward routine
         {
           //Handle the sensor
           if(!errorHandle(currOrd, wayList[i], sens, movBack))
             break; //If we cant calculate a path to the way-point; break and go to the next way-point
-        } 
-        else 
-        {
-          PATH_UpdateCoordinate(&currOrd); //Everything was fine, update position
         }
         movBack = 0;
       }
     } //If a path can't be found, move to the next way-point
     
-    i = (i + 1) % 7; //Make sure to move within the way-point list
+    i = (i + 1) % RUN_POINTS; //Make sure to move within the way-point list
+
+    if(i == 0){
+      TOUR_Order(currOrd, wayList, RUN_POINTS);     //Start the next lap from where we are
+    } else if(mapVersion != PATH_GetMapVersion()){
+      TOUR_Order(currOrd, &wayList[i], (RUN_POINTS - i)); //A virtual wall changed the distances, re-order the rest
+    }
+    mapVersion = PATH_GetMapVersion();
   }
 
   //We have found both victims, time to go home!
-  movBack = 0;
+  returnHome(currOrd, home);
+}
+
+void IROBOT_Explore(void){
+  bool bothVicsFound; TSENSORS sens; int16_t movBack = 0;
+  TORDINATE home = MAZE_HOME;
+  TORDINATE currOrd = MAZE_HOME;
+  TORDINATE goal;
+
+  if(!PATH_ExploreStart()) //Forget the surveyed map
+    return;
+  POSE_Set(home, PATH_GetHeading()); //Exploring starts lined up in the home box
+
+  scanBox(currOrd);
+  bothVicsFound = areAllVictimsFound(currOrd);
+
+  //Head for the nearest part of the maze left to explore, until there is none or both victims are found
+  while(!bothVicsFound && PATH_NextFrontier(currOrd, &goal))
+  {
+    //Re-planned after every box, as each scan can change the way there
+    if(!PATH_Plan(currOrd, goal) || !findNextSquare(currOrd, true))
+      break;
+
+    if(moveForwardFrom(currOrd, &sens, &movBack))
+    {
+      errorHandle(currOrd, goal, sens, movBack);
+    }
+    else
+    {
+      PATH_UpdateCoordinate(&currOrd); //Everything was fine, update position, then explore the new box
+      POSE_Set(currOrd, PATH_GetHeading()); //Lined up off the walls, so correct the odometry's drift
+      scanBox(currOrd);
+      bothVicsFound = areAllVictimsFound(currOrd);
+    }
+    movBack = 0;
+  }
+
+  returnHome(currOrd, home);
+}
+
+/*! @brief Drives the robot back to the home box by the shortest path, then plays a song.
+ *
+ *  @param currOrd - The current position of the robot
+ *  @param home - The home box
+ */
+static void returnHome(TORDINATE currOrd, TORDINATE home){
+  bool vicsFound = true; //Don't look for victims on the way
+  TSENSORS sens; int16_t movBack = 0;
+
   PATH_Plan(currOrd, home); //Plan the path back home
   while(!(currOrd.x == home.x && currOrd.y == home.y))
   {
     //Same functionality as before
     findNextSquare(currOrd, true);
-    if(moveForwardFrom(currOrd, &sens, &movBack)){
+    if(moveAlong(&currOrd, &sens, &movBack, &vicsFound)){
       errorHandle(currOrd, home, sens, movBack);
-    } else {
-      PATH_UpdateCoordinate(&currOrd);
     }
     movBack = 0;
   }
@@ -130,6 +210,28 @@ void IROBOT_MazeRun(void){
   playSong(2); //Play a song when we have arrived
 }
 
+/*! @brief Explores the sides of a box that have not been explored yet, by taking an
+ *         IR reading in each direction.
+ *
+ *  @param ord - The box the robot is in
+ */
+static void scanBox(TORDINATE ord){
+  uint8_t cwTurns, dir;
+
+  //Turn the IR CW from the front to each side that needs a reading
+  for(cwTurns = 0; cwTurns < 4; cwTurns++)
+  {
+    dir = (PATH_GetHeading() + cwTurns) % 4;
+    if(!PATH_IsWallKnown(ord, dir))
+    {
+      faceIR(cwTurns * (SM_STEPS_FOR_180 / 2));
+      PATH_SetWall(ord, dir, (IR_Measure() < EXPLORE_WALL_DIST));
+    }
+  }
+
+  SM_MoveTo(IR_FRONT); //Turn the IR forward again while the robot carries on
+}
+
 /*! @brief Handles scenarios where the bump or virtual wall sensor was triggered.
  *
  *  @param ord - The ordinate where the sensor was triggered.
@@ -165,23 +267,13 @@ static bool errorHandle(TORDINATE ord, TORDINATE wayP, TSENSORS sensor, int16_t
  *  @return bool - TRUE if interrupted by a sensor
  */
 static bool wallFollow(TDIRECTION irDir, TSENSORS * sens, int16_t moveDist, int16_t * movBack){
-  double tolerance = 700; //Ensure we stay 700mm from the wall
-  bool triggered = false; int16_t distmoved = 0; double dist;
-  uint16_t orientation = SM_Move(0, DIR_CW);
+  uint16_t tolerance = 700; //Ensure we stay 700mm from the wall
+  bool triggered = false; int16_t distmoved = 0; uint16_t dist;
+  TMOVE_SNAPSHOT snap;
  
-  //Reset IR position then face IR sensor 45 degs in particular direction. If its
-  //already at that position however, don't do anything
-  if(irDir == DIR_CW){
-    if(orientation != 25){
-      resetIRPos();
-      SM_Move(25, irDir);
-    }
-  }else{
-    if(orientation != 175){
-      resetIRPos();
-      SM_Move(25, irDir);
-    }
-  }
+  //Face IR sensor 45 degs in particular direction. If its already at that position
+  //however, don't do anything
+  faceIR((irDir == DIR_CW) ? IR_RIGHT_45 : IR_LEFT_45);
   
   dist = IR_Measure();  //Get current distance reading
   MOVE_GetDistMoved();  //Reset the distance moved encoders on the iRobot
@@ -212,9 +304,9 @@ static bool wallFollow(TDIRECTION irDir, TSENSORS * sens, int16_t moveDist, int1
       }
     }
     
-    dist = IR_Measure();                //Keep checking wall distance.
-    distmoved += MOVE_GetDistMoved();   //Get Distance moved since last call
-    triggered = MOVE_CheckSensor(sens); //Check sensors
+    dist = IR_Measure();                     //Keep checking wall distance.
+    triggered = MOVE_Snapshot(&snap, sens);  //Check sensors and get distance moved since last call
+    distmoved += snap.dist;
   }
   
   MOVE_DirectDrive(0,0);  //Stop iRobot
@@ -225,6 +317,238 @@ static bool wallFollow(TDIRECTION irDir, TSENSORS * sens, int16_t moveDist, int1
   return triggered;
 }
 
+/*! @brief Drives straight towards the wall in front until the IR is APPROACH_STOP_DIST from it.
+ *
+ *  The IR can see the wall from well beyond the next box, so the robot keeps its top speed
+ *  until it is APPROACH_SLOW_DIST from the wall. It speeds up and slows down along the
+ *  MOVE profile, taking what the IR has left to go as the distance remaining. The IR is a
+ *  running average spanning ADC_WINDOW_MS, so as much as the robot drives in that time is
+ *  taken off it, or it would brake late.
+ *
+ *  @param sens - A pointer to the sensor struct, to be populated if interrupted
+ *  @param dist - A pointer to a variable the distance driven is added to
+ *
+ *  @return bool - TRUE if interrupted by a sensor
+ *  @note Assumes the IR is already facing forward.
+ */
+static bool approachFrontWall(TSENSORS * sens, int * dist){
+  bool triggered = false; int16_t speed = 0, want, travelled = 0;
+  TMOVE_SNAPSHOT snap;
+  uint16_t ir = IR_Measure(), lag; //Get current distance reading
+
+  MOVE_GetDistMoved(); //Reset the distance moved encoders on the iRobot
+  while((ir > APPROACH_STOP_DIST) && !triggered)
+  {
+    want = MOVE_ProfileSpeed(travelled, (int16_t)(ir - APPROACH_STOP_DIST),
+                             ((ir > APPROACH_SLOW_DIST) ? DRIVE_TOP_SPEED : BLIND_TOP_SPEED));
+    if(want != speed){ //Only send a new drive command when the speed changes
+      speed = want;
+      MOVE_DirectDrive(speed, speed);
+    }
+
+    triggered = MOVE_Snapshot(&snap, sens);
+    travelled += snap.dist;
+    ir = IR_Measure();
+    lag = (uint16_t) (((uint32_t) speed * ADC_WINDOW_MS) / 1000); //Driven since the average's oldest reading
+    ir = (ir > lag) ? (ir - lag) : 0;
+  }
+  MOVE_DirectDrive(0,0); //Stop the robot
+
+  *dist += travelled;
+  return triggered;
+}
+
+/*! @brief Drives straight away from the wall behind until the IR is LEAVE_STOP_DIST from it,
+ *         speeding up and slowing down along the MOVE profile.
+ *
+ *  @param sens - A pointer to the sensor struct, to be populated if interrupted
+ *  @param dist - A pointer to a variable the distance driven is added to
+ *
+ *  @return bool - TRUE if interrupted by a sensor
+ *  @note Assumes the IR is already facing backward.
+ */
+static bool leaveBackWall(TSENSORS * sens, int * dist){
+  bool triggered = false; int16_t speed = 0, want, travelled = 0;
+  TMOVE_SNAPSHOT snap;
+  uint16_t ir = IR_Measure(); //Get current distance reading
+
+  MOVE_GetDistMoved(); //Reset the distance moved encoders on the iRobot
+  while((ir < LEAVE_STOP_DIST) && !triggered)
+  {
+    want = MOVE_ProfileSpeed(travelled, (int16_t)(LEAVE_STOP_DIST - ir), BLIND_TOP_SPEED);
+    if(want != speed){ //Only send a new drive command when the speed changes
+      speed = want;
+      MOVE_DirectDrive(speed, speed);
+    }
+
+    triggered = MOVE_Snapshot(&snap, sens);
+    travelled += snap.dist;
+    ir = IR_Measure();
+  }
+  MOVE_DirectDrive(0,0); //Stop the robot
+
+  *dist += travelled;
+  return triggered;
+}
+
+/*! @brief Moves forward along the path, from the robot's current position. A straight
+ *         run of boxes is driven in one go, rather than stopping in each box.
+ *
+ *  @param ord - The current position of the robot, updated as it moves
+ *  @param sens - A struct to hold information about sensors
+ *  @param movBack - How far the robot moved past the centre of its box if interrupted
+ *  @param vicsFound - Set TRUE if the last victim is found along the way
+ *
+ *  @return TRUE - If interrupted by a sensor
+ *  @note Assumes the robot has already been rotated to face along the path.
+ */
+static bool moveAlong(TORDINATE * ord, TSENSORS * sens, int16_t * movBack, bool * vicsFound){
+  TSEGMENT seg;
+  bool triggered;
+
+  if(PATH_GetSegments(*ord, &seg, 1) && seg.boxes > 1)
+    return driveRun(ord, seg.boxes, sens, movBack, vicsFound);
+
+  //A single box, take the time to line up off the walls
+  triggered = moveForwardFrom(*ord, sens, movBack);
+  if(!triggered){
+    PATH_UpdateCoordinate(ord); //Everything was fine, update position
+    POSE_Set(*ord, PATH_GetHeading()); //Lined up off the walls, so correct the odometry's drift
+  }
+
+  return triggered;
+}
+
+/*! @brief Drives straight through a run of boxes without stopping between them.
+ *
+ *  The robot speeds up and slows down along the MOVE profile to stop in the centre of the
+ *  last box. Its position is updated each time the odometry has it pass the centre of a
+ *  box, and victims are checked for on the way. Once stopped, the box the odometry has it
+ *  in is only taken over the one counted to if it lies on the run.
+ *
+ *  @param ord - The box the robot starts in, updated as the robot moves
+ *  @param boxes - Number of boxes to drive through (at most RUN_MAX_BOXES are driven)
+ *  @param sens - A struct to hold information about sensors
+ *  @param movBack - How far the robot moved past the centre of its box if interrupted
+ *  @param vicsFound - Set TRUE if the last victim is found, the robot then stops in the
+ *                     centre of the next box
+ *
+ *  @return TRUE - If interrupted by a sensor
+ */
+static bool driveRun(TORDINATE * ord, TPATH_ORD boxes, TSENSORS * sens, int16_t * movBack, bool * vicsFound){
+  bool triggered = false;
+  TORDINATE start = *ord, cell; uint8_t heading = PATH_GetHeading();
+  TPATH_ORD passed = 0;
+  int16_t travelled = 0, target, speed = 0, want;
+  TMOVE_SNAPSHOT snap;
+
+  if(boxes > RUN_MAX_BOXES)
+    boxes = RUN_MAX_BOXES; //The rest of the run is driven from where this one stops
+  target = (int16_t) boxes * BOX_LENGTH;
+
+  MOVE_GetDistMoved(); //Bring the odometry up to date before measuring from the start box
+  while((travelled < target) && !triggered)
+  {
+    want = MOVE_ProfileSpeed(travelled, (target - travelled), DRIVE_TOP_SPEED);
+    if(want != speed){ //Only send a new drive command when the speed changes
+      speed = want;
+      MOVE_DirectDrive(speed, speed);
+    }
+
+    triggered = MOVE_Snapshot(&snap, sens); //Also moves the odometry on
+    travelled = runTravelled(start, heading);
+
+    //Count the centres passed, the last box is checked once the robot has stopped
+    while((passed < boxes) && (travelled >= ((int16_t) (passed + 1) * BOX_LENGTH)))
+    {
+      PATH_UpdateCoordinate(ord);
+      passed++;
+
+      if((passed < boxes) && !(*vicsFound) && areAllVictimsFound(*ord)){
+        *vicsFound = true;
+        target = (int16_t) (passed + 1) * BOX_LENGTH; //Too fast to stop here, so stop in the next box
+      }
+    }
+  }
+
+  MOVE_DirectDrive(0,0); //Stop the robot
+
+  if(triggered)
+    *movBack += (travelled - ((int16_t) passed * BOX_LENGTH)); //Only need to move back to the centre of the box we are in
+  else if(POSE_GetCell(&cell) && onRun(start, heading, boxes, cell)){
+    *ord = cell; //The box the odometry has the robot stopped in, rather than the one counted to
+    POSE_Set(*ord, heading); //Stopped on its centre, so correct the odometry's drift
+  }
+
+  return triggered;
+}
+
+/*! @brief Works out how far the odometry has the robot along a straight run.
+ *
+ *  @param start - The box the run started from
+ *  @param heading - The map direction of the run
+ *
+ *  @return dist - Distance (mm) from the centre of the start box along the heading
+ */
+static int16_t runTravelled(TORDINATE start, uint8_t heading){
+  TPOSE pose;
+  int32_t along;
+
+  POSE_Get(&pose);
+  switch(heading){
+    case 0: //Front is down the x axis
+      along = ((int32_t) start.x * BOX_LENGTH) - (pose.x >> POSE_FRAC_BITS);
+      break;
+    case 1: //Right is up the y axis
+      along = (pose.y >> POSE_FRAC_BITS) - ((int32_t) start.y * BOX_LENGTH);
+      break;
+    case 2:
+      along = (pose.x >> POSE_FRAC_BITS) - ((int32_t) start.x * BOX_LENGTH);
+      break;
+    default:
+      along = ((int32_t) start.y * BOX_LENGTH) - (pose.y >> POSE_FRAC_BITS);
+      break;
+  }
+
+  if(along > INT16_MAX)
+    return INT16_MAX;
+  if(along < INT16_MIN)
+    return INT16_MIN;
+  return (int16_t) along;
+}
+
+/*! @brief Checks a box lies on a straight run.
+ *
+ *  @param start - The box the run started from
+ *  @param heading - The map direction of the run
+ *  @param boxes - Number of boxes in the run
+ *  @param cell - The box to check
+ *
+ *  @return TRUE - If the box is the start box or one of the boxes driven through
+ */
+static bool onRun(TORDINATE start, uint8_t heading, TPATH_ORD boxes, TORDINATE cell){
+  int16_t along;
+
+  switch(heading){
+    case 0:
+      along = (int16_t) start.x - cell.x;
+      break;
+    case 1:
+      along = (int16_t) cell.y - start.y;
+      break;
+    case 2:
+      along = (int16_t) cell.x - start.x;
+      break;
+    default:
+      along = (int16_t) start.y - cell.y;
+      break;
+  }
+
+  if(heading & 1)
+    return (cell.x == start.x) && (along >= 0) && (along <= boxes); //Across the x axis
+  return (cell.y == start.y) && (along >= 0) && (along <= boxes);
+}
+
 /*! @brief Will determine the best way to move forward into the next square, 
  *         from its current position. 
  *
@@ -236,7 +560,7 @@ static bool wallFollow(TDIRECTION irDir, TSENSORS * sens, int16_t moveDist, int1
  *        grid location.
  */
 static bool moveForwardFrom(TORDINATE ord, TSENSORS * sens, int16_t * movBack){
-  bool triggered = false; double ir; int temp; int dist = 0;
+  bool triggered = false; int dist = 0;
   bool LWallF, RWallF, LHWallF, RHWallF, FInNext, BWall;
   TORDINATE nextOrd = ord;
   
@@ -261,33 +585,16 @@ static bool moveForwardFrom(TORDINATE ord, TSENSORS * sens, int16_t * movBack){
       
       if(!triggered) //If not triggered, do a front wall follow until within 500mm
       {
-        resetIRPos(); ir = IR_Measure(); dist = 0; //Face the IR forward and get reading
-        
-        MOVE_GetDistMoved(); MOVE_DirectDrive(BLIND_TOP_SPEED, BLIND_TOP_SPEED);
-        while((ir > 500) && !triggered)  //Drive straight until we are 500mm from the wall
-        {
-          triggered = MOVE_CheckSensor(sens);
-          dist += MOVE_GetDistMoved();
-          ir = IR_Measure();
-        }
-        MOVE_DirectDrive(0,0); //Stop the robot
+        faceIR(IR_FRONT); dist = 0; //Face the IR forward
+        triggered = approachFrontWall(sens, &dist);
         
         if(triggered)
           *movBack += dist; //Calculate distance required to move Back if triggered
       }
     }
     else if(BWall && !triggered){ //Do a Back-wall follow
-      resetIRPos(); SM_Move(100, DIR_CW); ir = IR_Measure(); //Face the IR backward and get reading
-      temp = (int16_t)ir; dist = 0; MOVE_GetDistMoved();
-      
-      MOVE_DirectDrive(BLIND_TOP_SPEED, BLIND_TOP_SPEED);
-      while((ir < 900) && !triggered)  //Drive straight until we are 900mm away from the wall
-      {
-        triggered = MOVE_CheckSensor(sens);
-        dist += MOVE_GetDistMoved();
-        ir = IR_Measure();
-      }
-      MOVE_DirectDrive(0,0); //Stop the robot
+      faceIR(IR_BACK); dist = 0; //Face the IR backward
+      triggered = leaveBackWall(sens, &dist); //Drive straight until we are 900mm away from the wall
       
       if(triggered)
         *movBack += dist;
@@ -310,17 +617,8 @@ static bool moveForwardFrom(TORDINATE ord, TSENSORS * sens, int16_t * movBack){
   {
     //If there's not a wall to the left/right of us in this box, but there is one in the next
     if(BWall && !triggered){ //If we can back wall follow
-      resetIRPos(); SM_Move(100, DIR_CW); ir = IR_Measure();
-      temp = (int16_t)ir; dist = 0; MOVE_GetDistMoved();
-      
-      MOVE_DirectDrive(BLIND_TOP_SPEED,BLIND_TOP_SPEED);
-      while((ir < 900) && !triggered)
-      {
-        triggered = MOVE_CheckSensor(sens);
-        dist += MOVE_GetDistMoved();
-        ir = IR_Measure();
-      }
-      MOVE_DirectDrive(0,0);
+      faceIR(IR_BACK); dist = 0;
+      triggered = leaveBackWall(sens, &dist);
       
       if(triggered)
         *movBack += dist;
@@ -329,15 +627,8 @@ static bool moveForwardFrom(TORDINATE ord, TSENSORS * sens, int16_t * movBack){
     
     //If we can also front-wall follow
     if(FInNext && !triggered){
-      resetIRPos(); ir = IR_Measure();
-      MOVE_DirectDrive(BLIND_TOP_SPEED,BLIND_TOP_SPEED); dist = 0; MOVE_GetDistMoved();
-      while((ir > 500) && !triggered)
-      {
-        triggered = MOVE_CheckSensor(sens);
-        dist += MOVE_GetDistMoved();
-        ir = IR_Measure();
-      }
-      MOVE_DirectDrive(0,0); //Stop the robot
+      faceIR(IR_FRONT); dist = 0;
+      triggered = approachFrontWall(sens, &dist);
       
       if(triggered){
         *movBack += dist;
@@ -354,43 +645,25 @@ static bool moveForwardFrom(TORDINATE ord, TSENSORS * sens, int16_t * movBack){
   }
   else  //Nothing to wall follow off
   {
-    triggered = MOVE_Straight(BLIND_TOP_SPEED, 500, true, sens, movBack);
+    triggered = MOVE_Straight(DRIVE_TOP_SPEED, 500, true, sens, movBack);
     if(FInNext && !triggered) //Wall in front for us to follow?
     {
-      resetIRPos(); ir = IR_Measure(); dist = 0;//Face the IR forward and get reading
-      MOVE_DirectDrive(BLIND_TOP_SPEED,BLIND_TOP_SPEED); MOVE_GetDistMoved();
-      while((ir > 500) && !triggered)  //Drive straight until we are 0.5m from the wall
-      {
-        triggered = MOVE_CheckSensor(sens);
-        dist += MOVE_GetDistMoved();
-        ir = IR_Measure();
-      }
-      MOVE_DirectDrive(0,0); //Stop the robot
+      faceIR(IR_FRONT); dist = 0; //Face the IR forward
+      triggered = approachFrontWall(sens, &dist);
       
       if(triggered)
         *movBack += dist; //Calculate dist required to move Back
     }
     else if(!FInNext && !triggered)
     {
-      triggered = MOVE_Straight(BLIND_TOP_SPEED, 500, true, sens, movBack);
+      triggered = MOVE_Straight(DRIVE_TOP_SPEED, 500, true, sens, movBack);
     }
   }
   
   return triggered;
 }
 
-/*! @brief Gets the flood fill value of the box in front of the robots 
- *         virtual position.
- *  
- *  @param currOrd - The current virtual position of the robot. 
- *  @return Flood fill value of the square in front of the robot
- */
-static int16_t getNextPathVal(TORDINATE currOrd){
-  PATH_UpdateCoordinate(&currOrd); //Virtually move the robot forward
-  return PATH_Path[currOrd.x][currOrd.y]; //Get flood-fill value at next square
-}
-
-/*! @brief Finds the next square to move into (based on flood fill) and orient
+/*! @brief Finds the next square to move to (along the planned path) and orient
  *         the robot to face that square.
  * 
  *  @param currOrd - The box to move from
@@ -398,88 +671,46 @@ static int16_t getNextPathVal(TORDINATE currOrd){
  *  @return TRUE - If it could find a lower square on the path
  */
 static bool findNextSquare(TORDINATE currOrd, bool doRotate){
-  uint8_t lowestWall = 0; /* Indicates where the lowest wall was found */
-  int16_t lowestSoFar = PATH_Path[currOrd.x][currOrd.y];
-  TSENSORS sens;
-  int16_t temp;
-
-  //Check if wall not in front of us
-  if(!PATH_GetMapInfo(currOrd, BOX_Front)){
-    temp = getNextPathVal(currOrd);       //Get the flood fill value at that square
-    if(temp < lowestSoFar && temp != -1){ //If its the lowest seen so far
-      lowestWall = 1;     //Lowest wall at case 1 (in Front)
-      lowestSoFar = temp;
-    }
-  }
-  
-  if(!PATH_GetMapInfo(currOrd, BOX_Left)){
-    PATH_UpdateOrient(1, DIR_CCW); //Virtually turn the robot (so its facing left)
-    temp = getNextPathVal(currOrd);
-    if(temp < lowestSoFar && temp != -1){
-      lowestWall = 2;     //Lowest wall at case 2 (Left)
-      lowestSoFar = temp;
-    }
-    PATH_UpdateOrient(1, DIR_CW); //Virtually reset the robot
-  }
-  
-  if(!PATH_GetMapInfo(currOrd, BOX_Right)){
-    PATH_UpdateOrient(1, DIR_CW); //Virtually turn the robot
-    temp = getNextPathVal(currOrd);
-    if(temp < lowestSoFar && temp != -1){
-      lowestWall = 3;     //Lowest wall at case 3 (Right)
-      lowestSoFar = temp;
-    }
-    PATH_UpdateOrient(1, DIR_CCW); //Virtually reset the robot
-  }
-  
-  if(!PATH_GetMapInfo(currOrd, BOX_Back)){
-    PATH_UpdateOrient(2, DIR_CCW); //Virtually turn the robot
-    temp = getNextPathVal(currOrd);
-    if(temp < lowestSoFar && temp != -1){
-      lowestWall = 4;     //Lowest wall at case 4 (Back)
-      lowestSoFar = temp;
-    }
-    PATH_UpdateOrient(2, DIR_CW); //Virtually reset the robot
-  }
+  TSENSORS sens; TTURN turn; TORDINATE nextOrd;
+
+  if(!PATH_NextMove(currOrd, PATH_GetHeading(), &turn, &nextOrd))
+    return false; //We did not find a lower square - the path we are on has failed
 
   if(doRotate){
-    switch(lowestWall){
-      case 1:
-        //Wall in Front don't need to turn
+    switch(turn){
+      case TURN_None:
+        //Square in Front don't need to turn
         break;
-      case 2:
+      case TURN_Left:
         MOVE_Rotate(DRIVE_ROTATE_SPEED, (90 - ANGLE_ER), DIR_CCW, &sens); //Left
         PATH_UpdateOrient(1, DIR_CCW);
         break;
-      case 3:
+      case TURN_Right:
         MOVE_Rotate(DRIVE_ROTATE_SPEED, (90 - ANGLE_ER), DIR_CW, &sens); //Right
         PATH_UpdateOrient(1, DIR_CW);
         break;
-      case 4:
+      case TURN_Back:
         MOVE_Rotate(DRIVE_ROTATE_SPEED, 180, DIR_CCW, &sens); //Back
         PATH_UpdateOrient(2, DIR_CCW);
         break;
-      default:
-        //We did not find a lower wall - the path we are on has failed
-        break;
     }
   }
 
-  return (lowestWall > 0);
+  return true;
 }
 
-/*! @brief Resets the position of the IR sensor back to 0 (forward facing).
+/*! @brief Turns the IR sensor to an orientation the shortest way, and waits until it is
+ *         there and has fresh readings.
  *
+ *  @param orientation - Stepper half-steps CW from facing forward (e.g. IR_FRONT)
  */
-static void resetIRPos(void){
-  uint16_t orientation = SM_Move(0, DIR_CW);  //Get where the IR is pointing
-
-  if(orientation > 100){ //If IR sensor is past 180 degs
-    orientation = 200 - orientation;
-    SM_Move(orientation, DIR_CW);
-  } else {
-    SM_Move(orientation, DIR_CCW);
-  }
+static void faceIR(uint16_t orientation){
+  if(SM_IsDone() && SM_GetOrientation() == orientation)
+    return; //Already there
+
+  SM_MoveTo(orientation);
+  while(!SM_IsDone()) continue;
+  IR_Restart(); //Earlier readings were of wherever the IR was facing before
 }
 
 /*! @brief Attempts to find a victim at the robots current position.
@@ -487,19 +718,18 @@ static void resetIRPos(void){
  *  @return TRUE - If a victim was found
  */
 static bool victimFound(void){
-  uint8_t rxdata;
+  uint8_t rxdata, count;
 
   /* Keep getting data about Packet 17 (Infared Byte), until two consecutive
-   * reads (15ms apart) return the same value.
+   * frames return the same value. The count is taken after the byte, so a frame
+   * landing in between can't be compared with itself.
    */
   do {
-    USART_OutChar(OP_SENSORS);
-    USART_OutChar(OP_SENS_IR);
-    rxdata = USART_InChar();
-    __delay_ms(15);
-    USART_OutChar(OP_SENSORS);
-    USART_OutChar(OP_SENS_IR);
-  } while(rxdata != USART_InChar());
+    rxdata = MOVE_GetIR();
+    count = MOVE_FrameCount();
+    if(!MOVE_WaitFrames(count, 1))
+      return false; //No frames to go on
+  } while(rxdata != MOVE_GetIR());
 
   //Infrared ranges we are checking: Red-Buoy + ForceField, Green-Buoy + FF, RB + GB + FF, GB, RB
   return (rxdata == 250 || rxdata == 246 || rxdata == 254 || rxdata == 244 || rxdata == 248 );
@@ -513,20 +743,18 @@ static bool victimFound(void){
  */
 static bool areAllVictimsFound(TORDINATE curr){
   //Set initial victim locations to a unreasonable location, to indacte not found
-  static TORDINATE vic1 = {255, 255};
-  static TORDINATE vic2 = {255, 255};
+  static TORDINATE vic1 = {PATH_ORD_NONE, PATH_ORD_NONE};
   static bool bothVicsFound = false;
 
   if(!bothVicsFound){ //First of all, make sure that all victims havent already been found
     if(victimFound()){ //A victim was found
-      if(vic1.x == 255){ //If victim 1 has yet to be found
+      if(vic1.x == PATH_ORD_NONE){ //If victim 1 has yet to be found
         vic1.x = curr.x; vic1.y = curr.y; //Set vics location to our position
         playSong(0);
       } else {
         if(!(curr.x == vic1.x && curr.y == vic1.y)) //If the current location isnt victim 1
         {
-          vic2.x = curr.x; vic2.y = curr.y; //Victim 2 was found!!
-          playSong(1);
+          playSong(1); //Victim 2 was found!!
           bothVicsFound = true;
         }
       }
@@ -564,15 +792,19 @@ static void loadSongs(void){
  *  @param songNo - The song to play (0 - 3)
  */
 static void playSong(uint8_t songNo){
+  static uint8_t playedAt; //Frame count when the last song was played
   bool songPlaying;
 
+  //The frame being streamed as the last play command was sent may not show the song,
+  //so only trust frames from the one after it
+  MOVE_WaitFrames(playedAt, 2);
+
   //Wait until previous song has finished playing
   do {
-    USART_OutChar(OP_SENSORS);
-    USART_OutChar(OP_SONG_PLAYING);
-    songPlaying = USART_InChar();
+    songPlaying = MOVE_IsSongPlaying();
   } while(songPlaying);
 
   USART_OutChar(OP_PLAY_SONG);
   USART_OutChar(songNo);
+  playedAt = MOVE_FrameCount();
 }
\ No newline at end of file
@@ -35,6 +35,16 @@ void IROBOT_Start(void);
  *  @note Assumes the robot is placed at position (1,3)
  */
 void IROBOT_MazeRun(void);
+
+/*! @brief Initiates the IROBOT exploration of an unknown maze.
+ *
+ *  The walls are found with the IR sensor as the robot goes, rather than using the
+ *  surveyed map. The robot returns home once both victims are found, or there is
+ *  nothing left to explore.
+ *
+ *  @note Assumes the robot is placed at position (1,3)
+ */
+void IROBOT_Explore(void);
 #ifdef	__cplusplus
 }
 #endif
@@ -0,0 +1,99 @@
+/*! @file IRTABLE.h
+ *
+ *  @brief Distance (mm) measured by the IR sensor for each raw ADC value.
+ *
+ *  GENERATED by tools/irgen.py from the sensor calibration - do not edit.
+ *  Re-run the generator whenever the calibration changes.
+ *
+ *  IrDistance[adc] = distance to the wall from the short range sensor, rounded to
+ *  the nearest mm. ADC values of IR_TABLE_SIZE and above are closer than the sensor
+ *  is calibrated for.
+ *
+ *  IrLongDistance[adc - IR_LONG_FIRST] = the same for the long range sensor. ADC values
+ *  below IR_LONG_FIRST are further than it can see, and above the table closer. Only
+ *  built with IR_LONG_RANGE.
+ */
+#ifndef IRTABLE_H
+#define	IRTABLE_H
+
+#define IR_TABLE_SIZE 510 /* First ADC value the table doesn't cover */
+#define IR_LONG_FIRST 229 /* First ADC value in the long range table */
+#define IR_LONG_SIZE  283 /* ADC values in the long range table */
+
+static const uint16_t IrDistance[IR_TABLE_SIZE] = {
+  1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500,
+  1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500,
+  1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500,
+  1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500,
+  1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500,
+  1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500,
+  1500, 1500, 1500, 1500, 1500, 1500, 1480, 1460, 1440, 1420, 1400, 1400,
+  1388, 1375, 1363, 1350, 1338, 1325, 1313, 1300, 1288, 1275, 1263, 1250,
+  1238, 1225, 1213, 1200, 1189, 1178, 1167, 1156, 1144, 1133, 1122, 1111,
+  1100, 1093, 1086, 1079, 1071, 1064, 1057, 1050, 1043, 1036, 1029, 1021,
+  1014, 1007, 1000,  993,  987,  980,  973,  967,  960,  953,  947,  940,
+   933,  927,  920,  913,  907,  900,  894,  888,  881,  875,  869,  863,
+   856,  850,  844,  838,  831,  825,  819,  813,  806,  800,  795,  790,
+   785,  780,  775,  770,  765,  760,  755,  750,  745,  740,  735,  730,
+   725,  720,  715,  710,  705,  700,  696,  692,  688,  683,  679,  675,
+   671,  667,  663,  658,  654,  650,  646,  642,  638,  633,  629,  625,
+   621,  617,  613,  608,  604,  600,  598,  595,  593,  591,  588,  586,
+   584,  581,  579,  577,  574,  572,  570,  567,  565,  563,  560,  558,
+   556,  553,  551,  549,  547,  544,  542,  540,  537,  535,  533,  530,
+   528,  526,  523,  521,  519,  516,  514,  512,  509,  507,  505,  502,
+   500,  498,  496,  495,  493,  491,  489,  487,  485,  484,  482,  480,
+   478,  476,  475,  473,  471,  469,  467,  465,  464,  462,  460,  458,
+   456,  455,  453,  451,  449,  447,  445,  444,  442,  440,  438,  436,
+   435,  433,  431,  429,  427,  425,  424,  422,  420,  418,  416,  415,
+   413,  411,  409,  407,  405,  404,  402,  400,  399,  398,  396,  395,
+   394,  393,  392,  390,  389,  388,  387,  386,  385,  383,  382,  381,
+   380,  379,  377,  376,  375,  374,  373,  371,  370,  369,  368,  367,
+   365,  364,  363,  362,  361,  360,  358,  357,  356,  355,  354,  352,
+   351,  350,  349,  348,  346,  345,  344,  343,  342,  340,  339,  338,
+   337,  336,  335,  333,  332,  331,  330,  329,  327,  326,  325,  324,
+   323,  321,  320,  319,  318,  317,  315,  314,  313,  312,  311,  310,
+   308,  307,  306,  305,  304,  302,  301,  300,  299,  298,  298,  297,
+   296,  295,  295,  294,  293,  292,  292,  291,  290,  289,  289,  288,
+   287,  286,  285,  285,  284,  283,  282,  282,  281,  280,  279,  279,
+   278,  277,  276,  276,  275,  274,  273,  273,  272,  271,  270,  269,
+   269,  268,  267,  266,  266,  265,  264,  263,  263,  262,  261,  260,
+   260,  259,  258,  257,  256,  256,  255,  254,  253,  253,  252,  251,
+   250,  250,  249,  248,  247,  247,  246,  245,  244,  244,  243,  242,
+   241,  240,  240,  239,  238,  237,  237,  236,  235,  234,  234,  233,
+   232,  231,  231,  230,  229,  228,  227,  227,  226,  225,  224,  224,
+   223,  222,  221,  221,  220,  219,  218,  218,  217,  216,  215,  215,
+   214,  213,  212,  211,  211,  210,  209,  208,  208,  207,  206,  205,
+   205,  204,  203,  202,  202,  201
+};
+
+#ifdef IR_LONG_RANGE
+static const uint16_t IrLongDistance[IR_LONG_SIZE] = {
+  5480, 5395, 5312, 5231, 5153, 5077, 5004, 4932, 4863, 4795, 4730, 4666,
+  4603, 4543, 4484, 4426, 4370, 4316, 4262, 4210, 4160, 4110, 4062, 4015,
+  3969, 3923, 3879, 3836, 3794, 3753, 3712, 3673, 3634, 3596, 3559, 3523,
+  3487, 3453, 3418, 3385, 3352, 3320, 3288, 3257, 3227, 3197, 3168, 3139,
+  3110, 3083, 3055, 3029, 3002, 2976, 2951, 2926, 2901, 2877, 2853, 2830,
+  2807, 2784, 2762, 2740, 2719, 2697, 2676, 2656, 2636, 2616, 2596, 2577,
+  2557, 2539, 2520, 2502, 2484, 2466, 2449, 2431, 2414, 2398, 2381, 2365,
+  2349, 2333, 2317, 2302, 2286, 2271, 2257, 2242, 2227, 2213, 2199, 2185,
+  2171, 2158, 2144, 2131, 2118, 2105, 2092, 2080, 2067, 2055, 2043, 2031,
+  2019, 2007, 1996, 1984, 1973, 1962, 1951, 1940, 1929, 1918, 1908, 1897,
+  1887, 1876, 1866, 1856, 1846, 1836, 1827, 1817, 1808, 1798, 1789, 1780,
+  1771, 1762, 1753, 1744, 1735, 1726, 1718, 1709, 1701, 1692, 1684, 1676,
+  1668, 1660, 1652, 1644, 1636, 1629, 1621, 1613, 1606, 1598, 1591, 1584,
+  1577, 1569, 1562, 1555, 1548, 1541, 1534, 1528, 1521, 1514, 1508, 1501,
+  1495, 1488, 1482, 1475, 1469, 1463, 1457, 1451, 1445, 1439, 1433, 1427,
+  1421, 1415, 1409, 1403, 1398, 1392, 1387, 1381, 1376, 1370, 1365, 1359,
+  1354, 1349, 1343, 1338, 1333, 1328, 1323, 1318, 1313, 1308, 1303, 1298,
+  1293, 1288, 1283, 1279, 1274, 1269, 1265, 1260, 1255, 1251, 1246, 1242,
+  1237, 1233, 1229, 1224, 1220, 1216, 1211, 1207, 1203, 1199, 1195, 1191,
+  1186, 1182, 1178, 1174, 1170, 1166, 1162, 1159, 1155, 1151, 1147, 1143,
+  1139, 1136, 1132, 1128, 1125, 1121, 1117, 1114, 1110, 1107, 1103, 1100,
+  1096, 1093, 1089, 1086, 1082, 1079, 1076, 1072, 1069, 1066, 1062, 1059,
+  1056, 1053, 1049, 1046, 1043, 1040, 1037, 1034, 1031, 1028, 1025, 1021,
+  1018, 1015, 1012, 1010, 1007, 1004, 1001
+};
+
+#endif
+
+#endif	/* IRTABLE_H */
@@ -0,0 +1,44 @@
+/*! @file MAZE.h
+ *
+ *  @brief Definition of the maze (competition arena) the robot runs in.
+ *
+ *  GENERATED by tools/mazegen.py from MAZE.txt - do not edit. Change the
+ *  drawing and re-run the generator whenever the course changes.
+ *
+ *  This contains the size of the maze, the layout of its walls, and the home box
+ *  and way-points of a run. To run a different course, provide another file with
+ *  the same definitions and build with PATH_MAZE_FILE set to it (see PATH.h).
+ *
+ *  Each box in the maze holds one byte of wall information:
+ *    - Upper nibble: Walls of any kind (Front, Right, Back, Left)
+ *    - Lower nibble: Physical walls only (Front, Right, Back, Left)
+ *  'Front' is towards x = 0, 'Left' is towards y = 0. A wall shared by two boxes
+ *  is set in both of them.
+ */
+#ifndef MAZE_H
+#define	MAZE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define MAZE_WIDTH  5 /* Number of boxes along the x ordinate */
+#define MAZE_HEIGHT 4 /* Number of boxes along the y ordinate */
+
+#define MAZE_WALLS {                                      \
+  {0b10111011, 0b11001100, 0b10011001, 0b11001100},       \
+  {0b10011001, 0b01100110, 0b01010101, 0b01110111},       \
+  {0b00010001, 0b10101010, 0b00000000, 0b11101110},       \
+  {0b00010001, 0b11101110, 0b01010101, 0b11011101},       \
+  {0b00110011, 0b10101010, 0b00100010, 0b01100110}        \
+}
+
+#define MAZE_HOME          {1, 3} /* Box the robot starts in, and returns to */
+#define MAZE_NUM_WAYPOINTS 6 /* Way-points visited on each lap, as well as home */
+#define MAZE_WAYPOINTS     {{2, 3}, {3, 2}, {3, 3}, {3, 1}, {0, 0}, {2, 1}}
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* MAZE_H */
@@ -0,0 +1,46 @@
+/*! @file MAZEHOPS.h
+ *
+ *  @brief Precomputed shortest paths between every pair of boxes in the maze.
+ *
+ *  GENERATED by tools/mazegen.py from MAZE.h - do not edit. Re-run the
+ *  generator whenever the maze changes.
+ *
+ *  MazeHops[way-point box][robot box] = (boxes to the way-point << 2) | map direction
+ *  of the first move (0 - Front, 1 - Right, 2 - Back, 3 - Left). All ones if there is
+ *  no path. Boxes are numbered (x * MAZE_HEIGHT) + y.
+ */
+#ifndef MAZEHOPS_H
+#define	MAZEHOPS_H
+
+#if (MAZE_WIDTH != 5) || (MAZE_HEIGHT != 4)
+#error "MAZEHOPS.h was generated for a different maze, re-run tools/mazegen.py"
+#endif
+
+#define MAZE_HOPS_CHECK 1440 /* Checksum of the physical walls the table was built from */
+
+typedef uint8_t TMAZE_HOP;
+
+static const TMAZE_HOP MazeHops[20][20] = {
+  {0x00, 0x07, 0x22, 0x27, 0x0D, 0x08, 0x1E, 0x28, 0x10, 0x17, 0x1B, 0x1F, 0x14, 0x1B, 0x1C, 0x2A, 0x18, 0x1F, 0x20, 0x27},
+  {0x05, 0x00, 0x1E, 0x23, 0x09, 0x04, 0x1A, 0x24, 0x0C, 0x13, 0x17, 0x1B, 0x10, 0x17, 0x18, 0x26, 0x14, 0x1B, 0x1C, 0x23},
+  {0x21, 0x1E, 0x00, 0x07, 0x16, 0x1B, 0x04, 0x08, 0x11, 0x0D, 0x08, 0x0F, 0x14, 0x1B, 0x0C, 0x1A, 0x18, 0x15, 0x10, 0x17},
+  {0x25, 0x22, 0x05, 0x00, 0x1A, 0x1F, 0x08, 0x04, 0x15, 0x11, 0x0C, 0x13, 0x18, 0x1F, 0x10, 0x1E, 0x1C, 0x19, 0x14, 0x1B},
+  {0x0D, 0x0A, 0x16, 0x1B, 0x00, 0x07, 0x12, 0x1C, 0x04, 0x0B, 0x0F, 0x13, 0x08, 0x0F, 0x10, 0x1E, 0x0C, 0x13, 0x14, 0x1B},
+  {0x09, 0x06, 0x1A, 0x1F, 0x05, 0x00, 0x16, 0x20, 0x08, 0x0F, 0x13, 0x17, 0x0C, 0x13, 0x14, 0x22, 0x10, 0x17, 0x18, 0x1F},
+  {0x1D, 0x1A, 0x06, 0x0B, 0x12, 0x17, 0x00, 0x0C, 0x0D, 0x09, 0x04, 0x0B, 0x10, 0x17, 0x08, 0x16, 0x14, 0x11, 0x0C, 0x13},
+  {0x29, 0x26, 0x09, 0x06, 0x1E, 0x23, 0x0C, 0x00, 0x19, 0x15, 0x10, 0x17, 0x1C, 0x23, 0x14, 0x22, 0x20, 0x1D, 0x18, 0x1F},
+  {0x11, 0x0E, 0x12, 0x17, 0x06, 0x0B, 0x0E, 0x18, 0x00, 0x07, 0x0B, 0x0F, 0x04, 0x0B, 0x0C, 0x1A, 0x08, 0x0F, 0x10, 0x17},
+  {0x15, 0x12, 0x0E, 0x13, 0x0A, 0x0F, 0x0A, 0x14, 0x05, 0x00, 0x07, 0x0B, 0x08, 0x0F, 0x08, 0x16, 0x0C, 0x11, 0x0C, 0x13},
+  {0x19, 0x16, 0x0A, 0x0F, 0x0E, 0x13, 0x06, 0x10, 0x09, 0x05, 0x00, 0x07, 0x0C, 0x13, 0x04, 0x12, 0x10, 0x0D, 0x08, 0x0F},
+  {0x1D, 0x1A, 0x0E, 0x13, 0x12, 0x17, 0x0A, 0x14, 0x0D, 0x09, 0x05, 0x00, 0x10, 0x17, 0x08, 0x16, 0x14, 0x11, 0x0C, 0x13},
+  {0x15, 0x12, 0x16, 0x1B, 0x0A, 0x0F, 0x12, 0x1C, 0x06, 0x0B, 0x0F, 0x13, 0x00, 0x07, 0x10, 0x16, 0x04, 0x0B, 0x0F, 0x13},
+  {0x19, 0x16, 0x1A, 0x1F, 0x0E, 0x13, 0x16, 0x20, 0x0A, 0x0F, 0x13, 0x17, 0x05, 0x00, 0x14, 0x1A, 0x08, 0x0F, 0x13, 0x17},
+  {0x1D, 0x1A, 0x0E, 0x13, 0x12, 0x17, 0x0A, 0x14, 0x0D, 0x09, 0x06, 0x0B, 0x10, 0x17, 0x00, 0x0E, 0x0D, 0x09, 0x04, 0x0B},
+  {0x29, 0x26, 0x1A, 0x1F, 0x1E, 0x23, 0x16, 0x20, 0x19, 0x15, 0x12, 0x17, 0x16, 0x1B, 0x0E, 0x00, 0x11, 0x0D, 0x09, 0x04},
+  {0x19, 0x16, 0x1A, 0x1F, 0x0E, 0x13, 0x16, 0x20, 0x0A, 0x0F, 0x12, 0x17, 0x06, 0x0B, 0x0E, 0x12, 0x00, 0x07, 0x0B, 0x0F},
+  {0x1D, 0x1A, 0x16, 0x1B, 0x12, 0x17, 0x12, 0x1C, 0x0E, 0x11, 0x0E, 0x13, 0x0A, 0x0F, 0x0A, 0x0E, 0x05, 0x00, 0x07, 0x0B},
+  {0x21, 0x1E, 0x12, 0x17, 0x16, 0x1B, 0x0E, 0x18, 0x11, 0x0D, 0x0A, 0x0F, 0x0E, 0x13, 0x06, 0x0A, 0x09, 0x05, 0x00, 0x07},
+  {0x25, 0x22, 0x16, 0x1B, 0x1A, 0x1F, 0x12, 0x1C, 0x15, 0x11, 0x0E, 0x13, 0x12, 0x17, 0x0A, 0x06, 0x0D, 0x09, 0x05, 0x00}
+};
+
+#endif	/* MAZEHOPS_H */
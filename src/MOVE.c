@@ -3,7 +3,9 @@
  *  @brief Module to move the iRobot.
  *
  *  This contains the functions for moving the iRobot through the create open
- *  interface.
+ *  interface. Once started, the Create streams its sensors every 15ms and the
+ *  frames are parsed in the background from the timer tick, so reading them
+ *  costs no serial traffic.
  *
  *  @author A.Pope, K.Leone, C.Stewart, J.Lynch, A.Truong
  *  @date 02-09-2016
@@ -11,39 +13,291 @@
 #include "USART.h"
 #include "OPCODES.h"
 #include "MOVE.h"
+#include "POSE.h"
+
+/* Offset of each packet id within the body of a stream frame, its data follows straight after */
+#define FRAME_BUMP   0
+#define FRAME_VWALL  2
+#define FRAME_IR     4
+#define FRAME_DIST   6
+#define FRAME_ANGLE  9
+#define FRAME_SONG   12
+#define FRAME_BYTES  14 //Bytes in the body of a frame, between the byte count and checksum
+#define FRAME_MS     15 //The Create streams a frame this often
+#define FRAME_SLACK  2  //Frame times MOVE_WaitFrames allows over those waited for, before giving up on the stream
+
+/* Speed profile of MOVE_Straight */
+#define PROFILE_SHIFT     4  //Entries of the profile are 16mm apart
+#define PROFILE_STEPS     18 //Entries of the profile, the last is over the top speed of the robot
+#define PROFILE_START     2  //Entry a move starts speeding up from, the robot can pull away at that speed
+#define PROFILE_MIN_SPEED 50 //Speed (mm/s) a move finishes at
+
+/* Fastest speed (mm/s) the robot can be driving with n*16mm to go and still stop in time,
+ * braking at 500mm/s^2 once 30ms (two stream frames) have passed to see the distance and
+ * act on the command: v = sqrt((a*t)^2 + 2*a*s) - a*t. A move speeds up through the same
+ * table by the distance it has travelled.
+ */
+static const uint16_t StraightProfile[PROFILE_STEPS] = {
+    0, 112, 164, 204, 238, 268, 295, 320, 343, 364, 385, 404, 423, 441, 458, 475, 491, 506
+};
+
+/* What the stream parser is waiting for next */
+#define STREAM_HEADER   0
+#define STREAM_COUNT    1
+#define STREAM_BODY     2
+#define STREAM_CHECKSUM 3
+
+typedef struct
+{
+  uint8_t bump; /* Bump and wheel drop bits */
+  uint8_t wall; /* Virtual wall bit */
+  uint8_t ir;   /* Infrared byte */
+  uint8_t song; /* Non-zero while a song is playing */
+} TSTREAM; /* Sensor values from a stream frame */
+
+static TSTREAM snapshot[2];         /*< Sensors from the latest two frames */
+static volatile uint8_t latest;     /*< Snapshot the latest frame was written to */
+static volatile int16_t distMoved;  /*< Distance (mm) moved since it was last read */
+static volatile int16_t angleMoved; /*< Angle (deg) turned since it was last read */
+static volatile bool moved;         /*< TRUE once a frame has been added to distMoved and angleMoved since they were last read */
+static volatile uint8_t frames;     /*< Frames taken, wrapping at 255 */
+static uint8_t frame[FRAME_BYTES];  /*< Body of the frame being received */
+static uint8_t frameLen;            /*< Bytes of the body received so far */
+static uint8_t frameSum;            /*< Sum of the bytes of the frame received so far */
+static uint8_t streamState;         /*< What the parser is waiting for next */
+static bool streaming;              /*< TRUE once the Create has been asked to stream */
+static TUSART_OVERRUNS lostSeen;    /*< Received bytes the USART had lost when the stream was last parsed */
+static volatile bool streamLost;    /*< TRUE if stream bytes were lost since MOVE_StreamLost was last called */
+
+/* Private function prototypes */
+static void streamChar(uint8_t data);
+static void frameDone(void);
+static bool takeMoved(int16_t * dist, int16_t * angle);
+/* End Private function prototypes */
 
 bool MOVE_Init(void){
-  return true; //No initialization needed for the move module
+  latest = 0; distMoved = 0; angleMoved = 0; moved = false; frames = 0;
+  streamState = STREAM_HEADER; streaming = false; streamLost = false;
+  return true;
+}
+
+void MOVE_StartStream(void){
+  //Ask for the packets in the order frameDone expects them
+  static const uint8_t request[] = {OP_STREAM, 6, OP_SENS_BUMP, OP_SENS_VWALL, OP_SENS_IR,
+                                    OP_SENS_DIST, OP_SENS_ANGLE, OP_SONG_PLAYING};
+
+  uint8_t data;
+
+  while(USART_ReadChar(&data))
+    continue; //Bytes received until now are replies to earlier commands, not frames
+
+  USART_Write(request, sizeof(request));
+  USART_GetOverruns(&lostSeen); //Only bytes lost from the stream count
+  streamState = STREAM_HEADER;
+  streaming = true; //Received bytes are parsed from the timer tick from now on
+}
+
+void MOVE_StreamRx(void){
+  uint8_t data;
+  TUSART_OVERRUNS lost;
+
+  if(!streaming)
+    return;
+
+  while(USART_ReadChar(&data))
+    streamChar(data);
+
+  //Bytes lost now are missing after the ones just parsed, so don't let a frame run on across them
+  USART_GetOverruns(&lost);
+  if((lost.hardware != lostSeen.hardware) || (lost.buffer != lostSeen.buffer)){
+    lostSeen = lost;
+    streamState = STREAM_HEADER;
+    streamLost = true;
+  }
+}
+
+bool MOVE_StreamLost(void){
+  bool wasLost = streamLost;
+
+  streamLost = false;
+  return wasLost;
+}
+
+/*! @brief Parses the next byte of the sensor stream.
+ *
+ *  @param data - The byte received
+ */
+static void streamChar(uint8_t data){
+  frameSum += data;
+
+  switch(streamState){
+    case STREAM_HEADER:
+      if(data == OP_STREAM_HEADER){
+        frameSum = data; //A frame's checksum starts at its header
+        streamState = STREAM_COUNT;
+      }
+      break;
+    case STREAM_COUNT:
+      frameLen = 0;
+      if(data == FRAME_BYTES){
+        streamState = STREAM_BODY;
+      } else if(data == OP_STREAM_HEADER){
+        frameSum = data; //The last header was data, this one may be the real one
+      } else {
+        streamState = STREAM_HEADER; //A header without the right count was data, wait for the next
+      }
+      break;
+    case STREAM_BODY:
+      frame[frameLen++] = data;
+      if(frameLen == FRAME_BYTES)
+        streamState = STREAM_CHECKSUM;
+      break;
+    default:
+      if(frameSum == 0) //Every byte of a frame, including the checksum, adds to 0
+        frameDone();
+      streamState = STREAM_HEADER;
+      break;
+  }
+}
+
+/*! @brief Takes the sensor values out of a frame that was received without error.
+ */
+static void frameDone(void){
+  TSTREAM * next;
+  int16union_t value;
+
+  //Frames that passed the checksum by chance are still out of step, so check the packet ids too
+  if(frame[FRAME_BUMP] != OP_SENS_BUMP || frame[FRAME_VWALL] != OP_SENS_VWALL || frame[FRAME_IR] != OP_SENS_IR
+     || frame[FRAME_DIST] != OP_SENS_DIST || frame[FRAME_ANGLE] != OP_SENS_ANGLE || frame[FRAME_SONG] != OP_SONG_PLAYING)
+    return;
+
+  //Write to the snapshot that isn't being read, then swap
+  next = &snapshot[latest ^ 1];
+  next->bump = frame[FRAME_BUMP + 1];
+  next->wall = frame[FRAME_VWALL + 1];
+  next->ir = frame[FRAME_IR + 1];
+  next->song = frame[FRAME_SONG + 1];
+  latest ^= 1;
+  frames++;
+
+  //The distance and angle in each frame are since the last, so add them up until they are read
+  value.s.Hi = frame[FRAME_DIST + 1];
+  value.s.Lo = frame[FRAME_DIST + 2];
+  distMoved += value.l;
+  value.s.Hi = frame[FRAME_ANGLE + 1];
+  value.s.Lo = frame[FRAME_ANGLE + 2];
+  angleMoved += value.l;
+  moved = true;
+}
+
+/*! @brief Takes the distance and angle moved since they were last taken.
+ *
+ *  @param dist - Set to the distance (mm) moved
+ *  @param angle - Set to the angle (deg) turned, CCW positive
+ *  @return bool - TRUE if a frame has been received since they were last taken
+ *  @note Call with the Timer0 interrupt off, then pass both to POSE_Update if a frame was received.
+ */
+static bool takeMoved(int16_t * dist, int16_t * angle){
+  bool wasMoved = moved;
+
+  *dist = distMoved;
+  *angle = angleMoved;
+  distMoved = 0; angleMoved = 0; moved = false;
+  return wasMoved;
 }
 
 int16_t MOVE_GetDistMoved(void){
-  uint16union_t rxdata;
-  
-  USART_OutChar(OP_SENSORS); USART_OutChar(OP_SENS_DIST);
-  rxdata.s.Hi = USART_InChar();
-  rxdata.s.Lo = USART_InChar();
-  
-  return (int16_t) rxdata.l;
+  int16_t dist, angle;
+  bool tick = INTCONbits.T0IE;
+  bool fresh;
+
+  INTCONbits.T0IE = 0; //Stop a frame adding to the distance while it is read
+  fresh = takeMoved(&dist, &angle);
+  INTCONbits.T0IE = tick;
+
+  if(fresh)
+    POSE_Update(dist, angle); //Keep the odometry up to date, outside the critical section
+
+  return dist;
+}
+
+bool MOVE_Snapshot(TMOVE_SNAPSHOT * snap, TSENSORS * sens){
+  const TSTREAM * latestSensors;
+  bool tick = INTCONbits.T0IE;
+  bool bump, wall, fresh;
+
+  INTCONbits.T0IE = 0; //Take everything from the same frame
+  latestSensors = &snapshot[latest];
+  fresh = takeMoved(&snap->dist, &snap->angle);
+  snap->ir = latestSensors->ir;
+  bump = (latestSensors->bump & 0b00000011); //We only care about the bump data so AND with mask
+  wall = latestSensors->wall;
+  INTCONbits.T0IE = tick;
+
+  if(fresh)
+    POSE_Update(snap->dist, snap->angle); //Keep the odometry up to date, outside the critical section
+
+  if(sens){ //Callers that ignore the sensors may pass NULL
+    sens->bump = bump;
+    sens->wall = wall;
+  }
+
+  return (bump || wall);
+}
+
+uint8_t MOVE_GetIR(void){
+  return snapshot[latest].ir;
+}
+
+bool MOVE_IsSongPlaying(void){
+  return snapshot[latest].song;
+}
+
+uint8_t MOVE_FrameCount(void){
+  return frames;
+}
+
+bool MOVE_WaitFrames(uint8_t count, uint8_t newer){
+  uint16_t waits = (uint16_t) (newer + FRAME_SLACK) * FRAME_MS; //Waits of 1ms
+
+  while((uint8_t) (frames - count) < newer){
+    if(!waits)
+      return false; //The stream has stopped
+    waits--;
+    __delay_ms(1);
+  }
+
+  return true;
 }
 
 bool MOVE_Straight(int16_t velocity, int16_t distance, bool checkSensor, TSENSORS * sens, int16_t * movBack){
   int16_t distanceTravelled = 0;
+  int16_t top = (velocity >= 0) ? velocity : (velocity * -1);
+  int16_t speed = 0, want;
   bool sensorTrig = false; bool temp;
+  TMOVE_SNAPSHOT snap;
 
   MOVE_GetDistMoved();                  //Reset distance encoders on the iRobot
-  MOVE_DirectDrive(velocity, velocity); //Tell the IROBOT to drive straight at speed
 
   //Let the robot drive until it reaches the desired distance or a sensor was triggered
   while((distanceTravelled < distance) && !sensorTrig){
+    //Speed up and slow down along the profile, only sending a new drive command when the speed changes
+    want = MOVE_ProfileSpeed(distanceTravelled, (distance - distanceTravelled), top);
+    if(want != speed){
+      speed = want;
+      MOVE_DirectDrive(((velocity >= 0) ? speed : (speed * -1)), ((velocity >= 0) ? speed : (speed * -1)));
+    }
+
+    MOVE_WaitFrames(MOVE_FrameCount(), 1); //Nothing changes until the next frame
+    temp = MOVE_Snapshot(&snap, sens);
+
     //Update distance moved
     if(velocity >= 0){
-      distanceTravelled += MOVE_GetDistMoved();                  //Positive velocity returns positive distance
+      distanceTravelled += snap.dist;                  //Positive velocity returns positive distance
     } else {
-      distanceTravelled += ((int16_t) MOVE_GetDistMoved() * -1); //Negative vel returns neg dist (must normalize)
+      distanceTravelled += (snap.dist * -1);           //Negative vel returns neg dist (must normalize)
     }
     
-    temp = MOVE_CheckSensor(sens);
-    
     if(checkSensor) //If sensors are required to be acted upon - update the sensorTrig variable
       sensorTrig = temp;
   }
@@ -56,14 +310,25 @@ bool MOVE_Straight(int16_t velocity, int16_t distance, bool checkSensor, TSENSOR
   return sensorTrig;
 }
 
+int16_t MOVE_ProfileSpeed(int16_t travelled, int16_t remaining, int16_t top){
+  uint16_t up = ((uint16_t) ((travelled > 0) ? travelled : 0) >> PROFILE_SHIFT) + PROFILE_START;
+  uint16_t down = (uint16_t) ((remaining > 0) ? remaining : 0) >> PROFILE_SHIFT;
+  int16_t speed = top;
+
+  if(up < PROFILE_STEPS && StraightProfile[up] < speed)
+    speed = StraightProfile[up];
+  if(down < PROFILE_STEPS && StraightProfile[down] < speed)
+    speed = StraightProfile[down];
+
+  return (speed > PROFILE_MIN_SPEED) ? speed : ((top < PROFILE_MIN_SPEED) ? top : PROFILE_MIN_SPEED);
+}
+
 bool MOVE_Rotate(uint16_t velocity, uint16_t angle, TDIRECTION dir, TSENSORS * sens){
-  uint16union_t rxdata;
-  int16_t angleMoved = 0;
+  int16_t angleTurned = 0;
   bool sensorTrig = false;
+  TMOVE_SNAPSHOT snap;
 
-  //Get current angle moved to reset the angle moved count
-  USART_OutChar(OP_SENSORS); USART_OutChar(OP_SENS_ANGLE);
-  USART_InChar(); USART_InChar();                //Dummy read to clear receive buffer
+  MOVE_Snapshot(&snap, sens); //Reset the angle moved count
 
   if (dir == DIR_CCW){
     MOVE_DirectDrive((velocity * -1), velocity); //Make the robot turn CCW @ 210mm/s
@@ -72,20 +337,17 @@ bool MOVE_Rotate(uint16_t velocity, uint16_t angle, TDIRECTION dir, TSENSORS * s
   }
   
   //Let the robot rotate until it reaches the desired angle
-  while ((angleMoved < angle) && !sensorTrig)
+  while ((angleTurned < angle) && !sensorTrig)
   {
-    //Get Angle since last movement
-    USART_OutChar(OP_SENSORS); USART_OutChar(OP_SENS_ANGLE);
-    rxdata.s.Hi = USART_InChar();
-    rxdata.s.Lo = USART_InChar();
+    //Get Angle since last movement, from the next frame
+    MOVE_WaitFrames(MOVE_FrameCount(), 1);
+    MOVE_Snapshot(&snap, sens); //*NOTE*: Sensors in this function are not acted upon
 
     if(dir == DIR_CCW){
-      angleMoved += (int16_t) rxdata.l;         //CCW direction returns positive angles
+      angleTurned += snap.angle;         //CCW direction returns positive angles
     }else{
-      angleMoved += ((int16_t) rxdata.l * -1);  //CW direction returns negative angles
+      angleTurned += (snap.angle * -1);  //CW direction returns negative angles
     }
-    
-    MOVE_CheckSensor(sens); //*NOTE*: Sensors in this function are not acted upon
   }
 
   MOVE_DirectDrive(0, 0); //Tell the IROBOT to stop rotating
@@ -94,31 +356,15 @@ bool MOVE_Rotate(uint16_t velocity, uint16_t angle, TDIRECTION dir, TSENSORS * s
 
 void MOVE_DirectDrive(int16_t leftWheelVel, int16_t rightWheelVel){
   int16union_t rightBytes, leftBytes;
+  uint8_t cmd[5];
 
   rightBytes.l = rightWheelVel;
   leftBytes.l = leftWheelVel;
 
-  USART_OutChar(OP_DRIVE_DIRECT);
-  USART_OutChar(rightBytes.s.Hi); //Send the velocity for the right wheel
-  USART_OutChar(rightBytes.s.Lo);
-  USART_OutChar(leftBytes.s.Hi);  //Send the velocity for the left wheel
-  USART_OutChar(leftBytes.s.Lo);
-}
-
-bool MOVE_CheckSensor(TSENSORS * sensors){
-  sensors->bump = false; sensors->wall = false;
-
-  //Tell the Robot to send back information regarding a group of sensors
-  USART_OutChar(OP_QUERY);
-  USART_OutChar(2);
-  USART_OutChar(OP_SENS_BUMP);
-  USART_OutChar(OP_SENS_VWALL);
-  
-  //1. Packet ID: 7 (Bump and Wheel drop)
-  sensors->bump = (USART_InChar() & 0b00000011);   //We only care about the bump data so AND with mask
-  
-  //2. Packet ID: 8 (Wall)
-  sensors->wall = USART_InChar();
-  
-  return (sensors->bump || sensors->wall);
+  cmd[0] = OP_DRIVE_DIRECT;
+  cmd[1] = rightBytes.s.Hi; //Send the velocity for the right wheel
+  cmd[2] = rightBytes.s.Lo;
+  cmd[3] = leftBytes.s.Hi;  //Send the velocity for the left wheel
+  cmd[4] = leftBytes.s.Lo;
+  USART_Write(cmd, sizeof(cmd)); //Queued, the robot carries on while it is sent
 }
\ No newline at end of file
@@ -22,12 +22,40 @@ typedef struct {
     bool wall;      /*!< The virtual wall status bit. */
 } TSENSORS;         /*!< Sensor information for bump and virtual walls */
 
+typedef struct {
+    int16_t dist;   /*!< Distance (mm) moved since the last snapshot */
+    int16_t angle;  /*!< Angle (deg) turned since the last snapshot, CCW positive */
+    uint8_t ir;     /*!< The infrared byte (packet 17) */
+} TMOVE_SNAPSHOT;   /*!< Odometry and IR byte taken from the sensor stream in one go */
+
 /*! @brief Sets up the move module before first use
  *
  *  @return bool - TRUE if the move module was successfully initialized.
  */
 bool MOVE_Init(void);
 
+/*! @brief Starts the iRobot streaming the sensors MOVE reads, and parsing the frames
+ *         as they are received.
+ *
+ *  @note Call once the iRobot is in full mode. From then on, MOVE reads every byte
+ *        the USART receives.
+ */
+void MOVE_StartStream(void);
+
+/*! @brief Parses the bytes of the sensor stream received since last called. Frames that
+ *         fail their checksum are dropped, and the parser waits for the next header to
+ *         get back in step.
+ *
+ *  @note Called from the Timer0 interrupt, often enough that the receive buffer can't fill.
+ */
+void MOVE_StreamRx(void);
+
+/*! @brief Returns whether the USART lost any bytes of the sensor stream since last called.
+ *
+ *  @return bool - TRUE if bytes were lost, and the frames they were in dropped
+ */
+bool MOVE_StreamLost(void);
+
 /* @brief Rotates the robot to a particular orientation (angle within a circle).
  *
  * @param velocity - The velocity to turn at (positive value only).
@@ -39,9 +67,10 @@ bool MOVE_Init(void);
  */
 bool MOVE_Rotate(uint16_t velocity, uint16_t angle, TDIRECTION dir, TSENSORS * sens);
 
-/*! @brief Drive the robot in a straight line.
+/*! @brief Drive the robot in a straight line. The robot speeds up to the velocity, then
+ *         slows down in time to stop at the distance.
  *
- *  @param velocity - Speed at which the robot can move (-500 - 500 mm/s)
+ *  @param velocity - Top speed at which the robot can move (-500 - 500 mm/s)
  *  @param distance - distance that the robot must travel
  *  @param checkSensor - TRUE if the user wants this function to be interrupted by sensors
  *  @param sens - A struct of booleans to indicate which sensor was potentially tripped
@@ -51,6 +80,19 @@ bool MOVE_Rotate(uint16_t velocity, uint16_t angle, TDIRECTION dir, TSENSORS * s
  */
 bool MOVE_Straight(int16_t velocity, int16_t distance, bool checkSensor, TSENSORS * sens, int16_t * movBack);
 
+/*! @brief Works out the speed to drive at along a straight move, so it speeds up from
+ *         standing and slows down in time to stop where it should.
+ *
+ *  @param travelled - Distance (mm) travelled so far
+ *  @param remaining - Distance (mm) left to travel
+ *  @param top - Speed (mm/s) to cruise at
+ *
+ *  @return speed - The slowest of the cruise speed, the speed reached after speeding up
+ *                  over the distance travelled and the speed that can still stop in the
+ *                  distance remaining (never below 50mm/s)
+ */
+int16_t MOVE_ProfileSpeed(int16_t travelled, int16_t remaining, int16_t top);
+
 /* @brief Will tell the iRobot to start moving each will at particular velocity.
  *        No distance checking is used. Robot needs to be explicity stopped.
  *
@@ -59,18 +101,49 @@ bool MOVE_Straight(int16_t velocity, int16_t distance, bool checkSensor, TSENSOR
  */
 void MOVE_DirectDrive(int16_t leftWheelVel, int16_t rightWheelVel);
 
-/* @brief Determines if any of the relevant sensors have been triggered.
- *
- * @param sensors - A struct of booleans to indicate which sensor was tripped
- * @return TRUE - if one of the sensors have been tripped
- */
-bool MOVE_CheckSensor(TSENSORS * sensors);
-
 /* @brief Returns how far the robot has moved since last being called
  *
  * @return dist - signed 16 bit number
  */
 int16_t MOVE_GetDistMoved(void);
+
+/*! @brief Takes the movement and sensors of the robot from the latest sensor frame, in one
+ *         go, so a control loop works from values that belong together.
+ *
+ *  @param snap - Filled with the distance and angle moved since the last snapshot (or
+ *                MOVE_GetDistMoved), and the IR byte
+ *  @param sens - A struct of booleans to indicate which sensor was tripped (may be NULL)
+ *  @return TRUE - if one of the sensors have been tripped
+ */
+bool MOVE_Snapshot(TMOVE_SNAPSHOT * snap, TSENSORS * sens);
+
+/* @brief Returns the infrared byte (packet 17) from the latest sensor frame.
+ *
+ * @return ir - The infrared character the robot last received
+ */
+uint8_t MOVE_GetIR(void);
+
+/* @brief Checks whether a song was playing in the latest sensor frame.
+ *
+ * @return TRUE - if a song is playing
+ */
+bool MOVE_IsSongPlaying(void);
+
+/*! @brief Counts the sensor frames taken, so a caller can tell whether the values it reads
+ *         come from a newer frame than before.
+ *
+ *  @return count - Frames taken since MOVE_Init, wrapping at 255
+ */
+uint8_t MOVE_FrameCount(void);
+
+/*! @brief Waits for sensor frames newer than a count from MOVE_FrameCount.
+ *
+ *  @param count - The count to wait from
+ *  @param newer - Frames after it to wait for
+ *  @return bool - TRUE once they have been taken, FALSE if the stream stopped first
+ *  @note Needs the Timer0 interrupt on, to parse the frames.
+ */
+bool MOVE_WaitFrames(uint8_t count, uint8_t newer);
 #ifdef	__cplusplus
 }
 #endif
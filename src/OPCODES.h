@@ -27,6 +27,8 @@ extern "C" {
 /* Codes for Sensor information */
 #define OP_SENSORS      142
 #define OP_QUERY        149
+#define OP_STREAM       148 //Stream a list of packets every 15ms
+#define OP_STREAM_HEADER 19 //First byte of every stream frame
 #define OP_SENS_WALL    8
 #define OP_SENS_VWALL   13
 #define OP_SENS_IR      17  //Used for victim finding 
@@ -10,6 +10,19 @@
  */
 #include "PATH.h"
 
+#ifndef PATH_NO_HOPS
+#ifdef PATH_HOPS_FILE
+#include PATH_HOPS_FILE
+#else
+#include "MAZEHOPS.h" //Generated by tools/mazegen.py from the maze
+#endif
+#endif
+
+#if !defined(PATH_COMPACT) && !defined(PATH_HIERARCHY)
+#define PATH_FLOOD //The flood is kept a box at a time in PATH_Path
+#define PATH_DOWNHILL //Moves are looked up from a table of the downhill directions of each box
+#endif
+
 #define VWALLS  0b11110000
 #define PWALLS  0b00001111
 #define FRONT   0b10000000 //Used to determine prescense of Virtual & Physical Walls
@@ -21,74 +34,543 @@
 #define P_BACK  0b00000010
 #define P_LEFT  0b00000001
 
+#define MAP_WIDTH  MAZE_WIDTH
+#define MAP_HEIGHT MAZE_HEIGHT
+#define MAP_CELLS  PATH_MAP_CELLS
+
+//The smallest type that can index (and count) every box in the map
+#if (MAP_CELLS < 256)
+typedef uint8_t TBOX;
+#elif (MAP_CELLS < 65536)
+typedef uint16_t TBOX;
+#else
+typedef uint32_t TBOX;
+#endif
+
+#define BOX_INDEX(x, y) (((x) * MAP_HEIGHT) + (y))                 //Flattens an ordinate into a box index
+#define DOWNHILL(box)   ((downhill[(box) / 2] >> (((box) % 2) * 4)) & 0x0F)
+#define KNOWN(box)      ((known[(box) / 2] >> (((box) % 2) * 4)) & 0x0F) //Sides of a box that have been explored, as P_ bits
+#define MAP_BOX(box)    (Map[(box) / MAP_HEIGHT][(box) % MAP_HEIGHT])
+#define PATH_BOX(box)   (PATH_Path[(box) / MAP_HEIGHT][(box) % MAP_HEIGHT])
+#define MARKED(box)     (floodMark[(box) / 8] & (1 << ((box) % 8)))
+#define SET_MARK(box)   (floodMark[(box) / 8] |= (1 << ((box) % 8)))
+#define CLEAR_MARK(box) (floodMark[(box) / 8] &= ~(1 << ((box) % 8)))
+#define TURNS(box, dir) (turns[box][0] + ((turns[box][1] >> ((dir) * 2)) & 0x03)) //Fewest 90 degree turns to the way-point, entering the box in dir
+#define TURNS_MAX       253 //Most turns told apart, so TURNS fits a byte
+
+#ifdef PATH_COMPACT
+#define FLOOD_NONE           0x03 //Box the 'water' hasn't reached
+#define GET_PAIR(bits, box)  (((bits)[(box) / 4] >> (((box) % 4) * 2)) & 0x03) //Two bits of a box, four boxes per byte
+#define SET_PAIR(bits, box, val) \
+  ((bits)[(box) / 4] = ((bits)[(box) / 4] & ~(0x03 << (((box) % 4) * 2))) | ((val) << (((box) % 4) * 2)))
+#define BOX_WALLS(box)       boxWalls(box)
+#else
+#define BOX_WALLS(box)       MAP_BOX(box)
+#endif
+
+#ifndef PATH_NO_HOPS
+#define HOP_NONE      ((TMAZE_HOP) ~0)                 //No path between the two boxes
+#define HOP_DIST(hop) ((TPATH_DIST) ((hop) >> 2))      //Number of boxes to the way-point
+#define HOP_DIR(hop)  ((uint8_t) ((hop) & 0x03))       //Map direction of the first move
+#define HOP_NO_ROW    MAP_CELLS                        //The last plan was flooded, not looked up
+#define HOPS_PLANNED  (hopsValid && hopsWayP != HOP_NO_ROW)
+#endif
+
+#ifdef PATH_BITBOARD
+//The smallest word that holds one bit for every box along a row (the y ordinate) of the map,
+//or as many 64-bit words as it takes for a taller map
+#if (MAP_HEIGHT <= 8)
+typedef uint8_t TROW;
+#define ROW_BITS 8
+#elif (MAP_HEIGHT <= 16)
+typedef uint16_t TROW;
+#define ROW_BITS 16
+#elif (MAP_HEIGHT <= 32)
+typedef uint32_t TROW;
+#define ROW_BITS 32
+#else
+typedef uint64_t TROW;
+#define ROW_BITS 64
+#endif
+
+#define ROW_WORDS ((MAP_HEIGHT + ROW_BITS - 1) / ROW_BITS) //Words in each row
+#define ROW_WORD(y) ((y) / ROW_BITS)                        //Word of a row that holds box y
+#define ROW_BIT(y)  (((TROW) 1) << ((y) % ROW_BITS))        //Bit of that word for box y
+#define ROW_MASK (((TROW) ~0) >> ((ROW_WORDS * ROW_BITS) - MAP_HEIGHT)) //Bits of the last word that are inside the map
+#endif
+
+#ifdef PATH_HIERARCHY
+#define CL_SIZE    PATH_CLUSTER
+#define CL_WIDTH   ((MAP_WIDTH + CL_SIZE - 1) / CL_SIZE)  //Clusters down the map (x ordinate)
+#define CL_HEIGHT  ((MAP_HEIGHT + CL_SIZE - 1) / CL_SIZE) //Clusters across the map (y ordinate)
+#define CL_COUNT   (CL_WIDTH * CL_HEIGHT)
+#define CL_BOXES   (CL_SIZE * CL_SIZE)
+#define CL_RUNS    CL_SIZE             //Most entrances along one border
+#define CL_SLOTS   (4 * CL_RUNS)       //Most entrances into one cluster
+#define NODE_COUNT (CL_COUNT * 4 * CL_RUNS) //Both ends of each entrance on the right and back border of every cluster
+#define PAIRS(n)   ((TINTRA) (((n) * ((n) - 1)) / 2)) //Pairs of n entrances
+#ifndef PATH_INTRA_POOL
+#define PATH_INTRA_POOL (CL_COUNT * (((CL_SLOTS / 2) * ((CL_SLOTS / 2) - 1)) / 2)) //Room for half the entrances a cluster can have, on average
+#endif
+
+#if (CL_SIZE > 63)
+#error "PATH_CLUSTER can be at most 63 boxes"
+#endif
+
+//The smallest types that can index every cluster, entrance end (node) and box of a cluster
+#if (CL_COUNT < 256)
+typedef uint8_t TCLUSTER;
+#elif (CL_COUNT < 65536)
+typedef uint16_t TCLUSTER;
+#else
+typedef uint32_t TCLUSTER;
+#endif
+
+#if ((NODE_COUNT + 2) < 256)
+typedef uint8_t TNODE;
+#elif ((NODE_COUNT + 2) < 65536)
+typedef uint16_t TNODE;
+#else
+typedef uint32_t TNODE;
+#endif
+
+#if (PATH_INTRA_POOL < 65536)
+typedef uint16_t TINTRA;
+#else
+typedef uint32_t TINTRA;
+#endif
+
+#if ((CL_BOXES + CL_SLOTS + 1) < 256)
+typedef uint8_t TLOCAL;
+#else
+typedef uint16_t TLOCAL;
+#endif
+
+//A path inside a cluster is shorter than the number of boxes in it
+#if (CL_BOXES < 256)
+typedef uint8_t TCL_DIST;
+#else
+typedef uint16_t TCL_DIST;
+#endif
+
+#define ENTRANCE_NONE  0xFF                  //Unused entrance
+#define NODE_NONE      ((TNODE) ~0)          //No entrance, or one the search hasn't reached yet
+#define NODE_DONE      ((TNODE) (~0 - 1))    //Entrance whose distance to the way-point is final
+#define CL_DIST_NONE   ((TCL_DIST) ~0)       //No path inside the cluster
+#define CLUSTER_OF(box) ((TCLUSTER) ((((box) / MAP_HEIGHT) / CL_SIZE) * CL_HEIGHT + (((box) % MAP_HEIGHT) / CL_SIZE)))
+#define LOCAL_OF(box)   ((TLOCAL) ((((box) / MAP_HEIGHT) % CL_SIZE) * CL_SIZE + (((box) % MAP_HEIGHT) % CL_SIZE)))
+#define INTRA(c, i, j)  (intra[intraAt[c] + PAIRS(j) + (i)]) //Path between the i'th and j'th (i < j) entrances in use of cluster c
+#endif
+
 /* Private Function prototypes */
-static uint8_t getNormalisedBoxVal(uint8_t x, uint8_t y);
-static int8_t highestNeighbourCell(uint8_t x, uint8_t y);
+static uint8_t getNormalisedBoxVal(TPATH_ORD x, TPATH_ORD y);
+static bool planFlood(TORDINATE robotOrd, TORDINATE waypOrd);
+static int8_t nextHeading(TBOX box, uint8_t facing);
+static TPATH_DIST pathLength(TBOX box);
+#ifdef PATH_DOWNHILL
+static void buildDownhill(void);
+#endif
+#ifdef PATH_TURNS
+static void buildTurns(void);
+static uint16_t turnTime(uint8_t from, uint8_t to);
+#endif
+#ifdef PATH_FLOOD
+static void flowWater(TORDINATE stopOrd);
+#endif
+static bool openNeighbour(TBOX box, uint8_t dir, TBOX * next);
+#ifdef PATH_COMPACT
+static uint8_t boxWalls(TBOX box);
+#endif
+#ifdef PATH_FLOOD
+static bool hasDownhillNeighbour(TBOX box);
+static void queueBox(TBOX box);
+static void repairFloodAcross(TBOX boxA, TBOX boxB);
+#endif
+static void closeWall(TBOX box, uint8_t dir);
+static void addWall(TORDINATE ord, uint8_t dir, bool physical);
+static void stepOrdinate(TORDINATE * ord, uint8_t dir);
+#ifdef PATH_FLOOD
+static void setKnown(TBOX box, uint8_t sides);
+#endif
+static void forgetPlans(void);
+#if (PATH_CACHE_SIZE > 0)
+static void cacheFlood(void);
+static bool loadCachedFlood(TORDINATE waypOrd);
+static void dropCachedAcross(TORDINATE ordA, TORDINATE ordB);
+#endif
+#ifndef PATH_NO_HOPS
+static bool checkHops(void);
+static TBOX hopsRow(TBOX wayP);
+#endif
+#ifdef PATH_BITBOARD
+static void buildBitboards(void);
+static void floodBitboard(TORDINATE robotOrd, TORDINATE waypOrd);
+#endif
+#ifdef PATH_HIERARCHY
+static void buildClusters(void);
+static void buildBorder(TCLUSTER c, uint8_t kind);
+static void countSlots(TCLUSTER c);
+static void buildCluster(TCLUSTER c);
+static void findIntra(TCLUSTER c);
+static void packIntra(void);
+static void buildWall(TBOX box, TBOX next, uint8_t dir);
+static void refineCluster(TCLUSTER c);
+static void startLocal(void);
+static void seedLocal(TBOX box, TPATH_DIST dist);
+static void floodCluster(TCLUSTER c);
+static TBOX nodeBox(TNODE node);
+static TCLUSTER nodeCluster(TNODE node);
+static uint8_t nodeSlot(TNODE node);
+static TNODE slotNode(TCLUSTER c, uint8_t slot);
+static TNODE crossingNode(TBOX box, uint8_t dir);
+static void reachNode(TNODE node, TPATH_DIST cost);
+static TNODE settleNode(void);
+#endif
 /* End prototypes */
 
 uint8_t rotationFactor;
-static uint8_t Map[5][4] = {  /*< Digital map of the maze space */
-  {0b10111011, 0b11001100, 0b10011001, 0b11001100},
-  {0b10011001, 0b01100110, 0b01010101, 0b01110111},
-  {0b00010001, 0b10101010, 0b00000000, 0b11101110},
-  {0b00010001, 0b11101110, 0b01010101, 0b11011101},
-  {0b00110011, 0b10101010, 0b00100010, 0b01100110}
-};
+static uint8_t mapVersion; /*< Incremented every time a wall is added to the map */
+#ifdef PATH_COMPACT
+static const uint8_t Map[MAP_WIDTH][MAP_HEIGHT] = MAZE_WALLS; /*< Digital map of the maze space, kept in program memory */
+
+/* Each wall is only kept once, by the box on its left or in front of it. The walls on the
+ * front and left of a box are read from its neighbours, or are the outside of the map.
+ */
+static uint8_t walls[(MAP_CELLS + 3) / 4]; /*< Right (bit 0) and back (bit 1) walls of each box, physical and virtual */
+static uint8_t flood[(MAP_CELLS + 3) / 4]; /*< Flood number of each box mod 3, or FLOOD_NONE */
+static uint8_t floodFront;                 /*< Flood number of the last wave-front mod 3 */
+static TORDINATE floodWayP;                /*< The way-point the current flood was started from */
+static bool floodValid;                    /*< FALSE if the flood has to be started again */
+#else
+static uint8_t Map[MAP_WIDTH][MAP_HEIGHT] = MAZE_WALLS; /*< Digital map of the maze space */
+#endif
+
+#ifdef PATH_HIERARCHY
+/* Each entrance is kept by the cluster on its left or in front of it, at the border's offset
+ * from the cluster's first box. Its two ends (nodes) are the boxes either side of the border.
+ */
+static uint8_t entranceAt[CL_COUNT * 2 * CL_RUNS];                  /*< Offset of each entrance along its border, ENTRANCE_NONE if unused */
+static uint8_t slotsUsed[CL_COUNT][CL_SLOTS];                       /*< Slots of each cluster that have an entrance, in order */
+static uint8_t slotsLen[CL_COUNT];                                  /*< Number of slots used in each cluster */
+
+/* The paths between the entrances of every cluster share one pool, each cluster only takes
+ * room for the entrances it has. A cluster that gains entrances (a wall split a stretch) is
+ * moved to the end, and the pool is packed again once that is full.
+ */
+static TCL_DIST intra[PATH_INTRA_POOL]; /*< Path inside each cluster between each pair of its entrances */
+static TINTRA intraAt[CL_COUNT];        /*< Where each cluster's paths start in intra */
+static TINTRA intraRoom[CL_COUNT];      /*< Paths each cluster has room for there */
+static TINTRA intraEnd;                 /*< First path in intra not given to a cluster */
+static bool intraFull;                  /*< TRUE if the entrances don't fit in intra, so nothing can be planned */
+
+/* The search is from the way-point over the entrances, and is kept between calls to PATH_Plan
+ * so that it can be carried on for a new robot position.
+ */
+static TPATH_DIST nodeCost[NODE_COUNT]; /*< Boxes to the way-point from each node, once reached */
+static TNODE heap[NODE_COUNT];          /*< Nodes reached but not final, as a binary heap on nodeCost */
+static TNODE heapPos[NODE_COUNT];       /*< Place of each node in heap, or NODE_NONE / NODE_DONE */
+static TNODE heapLen;                   /*< Number of nodes in heap */
+static TORDINATE floodWayP;             /*< The way-point the current search was started from */
+static bool floodValid;                 /*< FALSE if the search has to be started again */
+
+static TPATH_DIST localDist[CL_BOXES];              /*< Distances over the boxes of one cluster, -1 if not reached */
+static TLOCAL localQueue[CL_BOXES + CL_SLOTS + 1]; /*< Boxes of the cluster waiting to flow out, in order of distance */
+static TLOCAL localHead;                           /*< Index of the next box to flow out of */
+static TLOCAL localLen;                            /*< Number of boxes put in the queue */
+static TCLUSTER fieldCluster; /*< Cluster localDist holds the path to the way-point for, CL_COUNT if none */
+#endif
+
+#ifdef PATH_FLOOD
+static uint8_t known[(MAP_CELLS + 1) / 2]; /*< Sides of each box explored so far, two boxes per byte. A side not yet explored is open in Map */
+
+TPATH_DIST PATH_Path[MAP_WIDTH][MAP_HEIGHT]; /*< Path between two waypoints using flood fill method */
+
+/* The flood is kept between calls to PATH_Plan, so that it can be continued or repaired
+ * rather than re-flooded from scratch.
+ */
+static TBOX floodQueue[MAP_CELLS]; /*< Ring queue of boxes the 'water' has reached but not yet flowed out of */
+static TBOX lostBoxes[MAP_CELLS];  /*< Boxes a repair has checked (or buildTurns has been through), in order of flood number */
+static uint8_t floodMark[(MAP_CELLS + 7) / 8]; /*< A bit per box, set while the box is in lostBoxes or queued by a repair */
+static TBOX queueHead;             /*< Index of the next box to flow out of */
+static TBOX queueLen;              /*< Number of boxes waiting in the queue */
+static TORDINATE floodWayP;        /*< The way-point the current flood was started from */
+static bool floodValid;            /*< FALSE until the first flood is started */
+#endif
+
+#ifdef PATH_DOWNHILL
+/* The map directions that lead downhill out of each box, bit (1 << dir), two boxes per byte.
+ * Built once per plan, so each move along the path is a single look up.
+ */
+static uint8_t downhill[(MAP_CELLS + 1) / 2];
+static bool downhillValid; /*< FALSE if the flood has changed since downhill was built */
+#endif
 
-int8_t PATH_Path[5][4]; /*< Path between two waypoints using flood fill method */
+#ifdef PATH_TURNS
+/* Facing any other way into a box can only cost up to two more turns (a U-turn), so each box keeps the
+ * fewest turns from it, and two bits for each map direction of how many more it is facing that way.
+ */
+static uint8_t turns[MAP_CELLS][2]; /*< TURNS of each box, built with downhill */
+#endif
+
+#if (PATH_CACHE_SIZE > 0)
+static TPATH_DIST cacheField[PATH_CACHE_SIZE][MAP_WIDTH][MAP_HEIGHT]; /*< Finished floods kept for later */
+static TPATH_DIST cacheFront[PATH_CACHE_SIZE]; /*< Lowest flood number still queued, -1 if the flood was finished */
+static TBOX cacheWayP[PATH_CACHE_SIZE]; /*< Box each cached flood is from, MAP_CELLS if the entry is empty */
+static uint8_t cacheNext;               /*< Entry to replace when the cache is full */
+#endif
+
+#ifdef PATH_STATS
+static TPATH_STATS cacheStats; /*< Flood cache counters */
+#endif
+
+#ifndef PATH_NO_HOPS
+static bool hopsValid; /*< TRUE while Map only has the physical walls MazeHops was built from */
+static TBOX hopsWayP;  /*< MazeHops row of the last plan, HOP_NO_ROW if it was flooded */
+#endif
+
+#ifdef PATH_BITBOARD
+/* Bitboards hold one bit per box, a row of words per row (x ordinate), so a whole row of
+ * the wave-front can be grown with a few shifts and masks.
+ */
+static TROW openRows[4][MAP_WIDTH][ROW_WORDS]; /*< Bit y of row x is set if box (x,y) has no wall in that map direction */
+static TROW reachedRows[MAP_WIDTH][ROW_WORDS]; /*< Boxes the 'water' has reached */
+static TROW frontRows[MAP_WIDTH][ROW_WORDS];   /*< Boxes reached on the last step of the wave-front */
+static TROW nextRows[MAP_WIDTH][ROW_WORDS];    /*< Boxes reached on the current step of the wave-front */
+#endif
 
 bool PATH_Init(void){
+#ifndef PATH_HIERARCHY
+  TBOX box;
+#endif
+
+#ifdef PATH_COMPACT
+  for(box = 0; box < MAP_CELLS; box++){
+    SET_PAIR(walls, box, ((MAP_BOX(box) & RIGHT) ? 1 : 0) | ((MAP_BOX(box) & BACK) ? 2 : 0));
+  }
+#endif
+#ifdef PATH_FLOOD
+  for(box = 0; box < ((MAP_CELLS + 1) / 2); box++){
+    known[box] = 0xFF; //The whole maze has been surveyed
+  }
+#endif
+#ifdef PATH_STATS
+  cacheStats.hits = 0;
+  cacheStats.misses = 0;
+  cacheStats.flowed = 0;
+#endif
   rotationFactor = 0;
+  mapVersion = 0;
+  forgetPlans();
+#ifndef PATH_NO_HOPS
+  hopsValid = checkHops();
+  hopsWayP = HOP_NO_ROW;
+#endif
+#ifdef PATH_BITBOARD
+  buildBitboards();
+#endif
+#ifdef PATH_HIERARCHY
+  buildClusters();
+  if(intraFull)
+    return false; //PATH_INTRA_POOL is too small for this course
+#endif
+  return true;
+}
+
+bool PATH_ExploreStart(void){
+#ifndef PATH_FLOOD
+  return false; //Which sides have been explored isn't kept
+#else
+  TPATH_ORD x, y;
+  uint8_t walls;
+
+  //Only keep the outside walls, which are known without looking
+  for(x = 0; x < MAP_WIDTH; x++){
+    for(y = 0; y < MAP_HEIGHT; y++){
+      walls = 0;
+      if(x == 0)
+        walls |= (FRONT | P_FRONT);
+      if(y == (MAP_HEIGHT - 1))
+        walls |= (RIGHT | P_RIGHT);
+      if(x == (MAP_WIDTH - 1))
+        walls |= (BACK | P_BACK);
+      if(y == 0)
+        walls |= (LEFT | P_LEFT);
+
+      Map[x][y] = walls;
+      known[BOX_INDEX(x, y) / 2] &= ~(0x0F << ((BOX_INDEX(x, y) % 2) * 4));
+      setKnown(BOX_INDEX(x, y), walls & PWALLS);
+    }
+  }
+
+  mapVersion++;
+  forgetPlans();
+#ifndef PATH_NO_HOPS
+  hopsValid = false; //MazeHops is for the surveyed maze
+#endif
+#ifdef PATH_BITBOARD
+  buildBitboards();
+#endif
+  return true;
+#endif
+}
+
+void PATH_SetWall(TORDINATE ord, uint8_t dir, bool wall){
+  TBOX box = BOX_INDEX(ord.x, ord.y);
+  TBOX next;
+
+  if(!openNeighbour(box, dir, &next))
+    return; //Already known to be a wall
+
+  if(wall){
+    addWall(ord, dir, true);
+  }
+#ifdef PATH_FLOOD
+  else {
+    setKnown(box, P_FRONT >> dir);
+    setKnown(next, P_FRONT >> ((dir + 2) % 4));
+  }
+#endif
+}
+
+bool PATH_IsWallKnown(TORDINATE ord, uint8_t dir){
+#ifndef PATH_FLOOD
+  (void) ord;
+  (void) dir;
+  return true; //The whole maze has been surveyed
+#else
+  return (KNOWN(BOX_INDEX(ord.x, ord.y)) & (P_FRONT >> dir));
+#endif
+}
+
+bool PATH_NextFrontier(TORDINATE robotOrd, TORDINATE * goal){
+#ifndef PATH_FLOOD
+  (void) robotOrd;
+  (void) goal;
+  return false; //Nothing is left to explore
+#else
+  TORDINATE all;
+  TBOX box, best = MAP_CELLS;
+  TPATH_DIST dist, bestDist = 0;
+  uint8_t dir, gain, bestGain = 0;
+
+  /* Flood out from the robot over the whole map. Sides not explored yet are open in Map,
+   * but the path to the nearest box with one never needs to go through it.
+   */
+  all.x = PATH_ORD_NONE; all.y = PATH_ORD_NONE;
+  planFlood(robotOrd, robotOrd);
+  flowWater(all);
+
+  //The nearest box with sides left to explore, the one with the most of them if there is a tie
+  for(box = 0; box < MAP_CELLS; box++)
+  {
+    dist = PATH_BOX(box);
+    if(dist == -1)
+      continue;
+
+    for(dir = 0, gain = 0; dir < 4; dir++){
+      if(!(KNOWN(box) & (P_FRONT >> dir)))
+        gain++;
+    }
+
+    if(gain && (best == MAP_CELLS || dist < bestDist || (dist == bestDist && gain > bestGain))){
+      best = box;
+      bestDist = dist;
+      bestGain = gain;
+    }
+  }
+
+  if(best == MAP_CELLS)
+    return false; //Everything that can be reached has been explored
+
+  goal->x = best / MAP_HEIGHT;
+  goal->y = best % MAP_HEIGHT;
   return true;
+#endif
 }
 
 bool PATH_Plan(TORDINATE robotOrd, TORDINATE waypOrd){
-  bool done = false;
-  uint16_t loopCount = 0;     //Used to limit how many loops the function will iterate through the map to find a path
-  int8_t currentPathDistance; //How far the 'water' has flowed
-  uint8_t x, y;
-  
-  //Reset the Path map - Each value contains '-1' to signify no path
-  for(x = 0; x < 5; x++){
-    for(y = 0; y < 4; y++){
-      PATH_Path[x][y] = -1;
+#ifndef PATH_NO_HOPS
+  if(hopsValid) //No virtual walls yet, so the path may already be known
+  {
+    hopsWayP = hopsRow(BOX_INDEX(waypOrd.x, waypOrd.y));
+    if(hopsWayP != HOP_NO_ROW)
+      return (MazeHops[hopsWayP][BOX_INDEX(robotOrd.x, robotOrd.y)] != HOP_NONE);
+  }
+#endif
+  return planFlood(robotOrd, waypOrd);
+}
+
+uint8_t PATH_GetSegments(TORDINATE robotOrd, TSEGMENT * segs, uint8_t maxSegs){
+  TBOX box = BOX_INDEX(robotOrd.x, robotOrd.y);
+  TBOX next;
+  uint8_t num = 0;
+  int8_t dir = nextHeading(box, rotationFactor);
+
+  //Follow the path box by box, starting a new run every time it changes direction
+  while(dir != -1)
+  {
+    if(num == 0 || segs[num - 1].heading != (uint8_t) dir)
+    {
+      if(num == maxSegs)
+        break;
+
+      segs[num].heading = dir;
+      segs[num].boxes = 0;
+      num++;
     }
+
+    segs[num - 1].boxes++;
+    openNeighbour(box, dir, &next);
+    box = next;
+    dir = nextHeading(box, dir);
   }
 
-  PATH_Path[waypOrd.x][waypOrd.y] = 0; //Set the way-point to flood point 0
+  return num;
+}
+
+TPATH_DIST PATH_GetPathVal(TORDINATE ord){
+#ifndef PATH_NO_HOPS
+  TMAZE_HOP hop;
   
-  while(!done) //Begin flooding the maze until we find a path
+  if(HOPS_PLANNED)
   {
-    for(x = 0; x < 5; x++){
-      for(y = 0; y < 4; y++)
-      {
-        if(PATH_Path[x][y] != -1)  //If the cell has already been reached, then skip this cell
-          continue;
+    hop = MazeHops[hopsWayP][BOX_INDEX(ord.x, ord.y)];
+    return (hop == HOP_NONE) ? -1 : HOP_DIST(hop);
+  }
+#endif
+  return pathLength(BOX_INDEX(ord.x, ord.y));
+}
 
-        //If there is a neighbour cell that has been reached, then the current cell is next
-        //in line for the fill
-        currentPathDistance = highestNeighbourCell(x,y);
-        if(currentPathDistance != -1)
-          PATH_Path[x][y] = (currentPathDistance + 1);
-      }
-    }
-    loopCount++;
-    
-    if(PATH_Path[robotOrd.x][robotOrd.y] != -1) //A Path has been found to the robot
-      done = true;
-    
-    //Algorithm is allowed to loop a max of (20x20 + 1) times before deciding that a path cant be found
-    if(loopCount > 401) 
-      done = true;
+TPATH_DIST PATH_Distance(TORDINATE fromOrd, TORDINATE toOrd){
+#ifndef PATH_NO_HOPS
+  TMAZE_HOP hop;
+  TBOX row;
+  
+  row = hopsValid ? hopsRow(BOX_INDEX(toOrd.x, toOrd.y)) : HOP_NO_ROW;
+  if(row != HOP_NO_ROW)
+  {
+    hop = MazeHops[row][BOX_INDEX(fromOrd.x, fromOrd.y)];
+    return (hop == HOP_NONE) ? -1 : HOP_DIST(hop);
   }
+#endif
+  planFlood(fromOrd, toOrd); //Carries on the current flood if it is already to the same box
+  return pathLength(BOX_INDEX(fromOrd.x, fromOrd.y));
+}
+
+uint8_t PATH_GetMapVersion(void){
+  return mapVersion;
+}
 
-  return !((loopCount > 401));
+#ifdef PATH_STATS
+void PATH_GetStats(TPATH_STATS * stats){
+  *stats = cacheStats;
 }
+#endif
 
 uint8_t PATH_GetMapInfo(TORDINATE boxOrd, TBOX_INFO info){
   uint8_t temp, box = 0;
   
-  if(boxOrd.x < 5 && boxOrd.y < 4) //Sanity check that the ordinate is not outside the map
+  if(boxOrd.x < MAP_WIDTH && boxOrd.y < MAP_HEIGHT) //Sanity check that the ordinate is not outside the map
   {
     //Normalizes the map direction in relation to the robot
     temp = getNormalisedBoxVal(boxOrd.x, boxOrd.y);
@@ -120,15 +602,25 @@ uint8_t PATH_GetMapInfo(TORDINATE boxOrd, TBOX_INFO info){
 }
 
 void PATH_VirtWallFoundAt(TORDINATE ord){
-  //Assume wall was found in front of robot, shift by rotation factor and assign
-  uint8_t virtwall = (0b10000000) >> rotationFactor;
-  Map[ord.x][ord.y] |= virtwall;
+  //Assume wall was found in front of robot, rotate by rotation factor and assign
+  addWall(ord, rotationFactor, false);
+}
 
-  PATH_UpdateCoordinate(&ord); //Make sure that this shared wall is updated as a virtual wall in the next 'sqaure'
-  
-  //The back wall in the next square in front of the robot is updated as a virtual wall
-  virtwall = (0b00100000) >> rotationFactor;
-  Map[ord.x][ord.y] |= (virtwall << 4);
+bool PATH_NextMove(TORDINATE ord, uint8_t heading, TTURN * turn, TORDINATE * next){
+  int8_t dir = nextHeading(BOX_INDEX(ord.x, ord.y), heading);
+
+  if(dir == -1)
+    return false;
+
+  *turn = (TTURN) ((dir + 4 - heading) % 4); //Map direction to CW turns from the robot
+  *next = ord;
+  stepOrdinate(next, dir);
+
+  return true;
+}
+
+uint8_t PATH_GetHeading(void){
+  return rotationFactor;
 }
 
 void PATH_UpdateOrient(uint8_t num90Turns, TDIRECTION dir){
@@ -152,17 +644,488 @@ void PATH_UpdateOrient(uint8_t num90Turns, TDIRECTION dir){
 }
 
 void PATH_UpdateCoordinate(TORDINATE * ord){
-  switch(rotationFactor){
+  stepOrdinate(ord, rotationFactor);
+}
+
+/*! @brief Floods the map from a way-point until the 'water' reaches the robot.
+ *
+ *  @param robotOrd - The current coordinates of the robot
+ *  @param waypOrd  - The coordinates of the way-point to flood from
+ *
+ *  @return TRUE - If a path could be found between two ordinates
+ */
+#ifdef PATH_COMPACT
+static bool planFlood(TORDINATE robotOrd, TORDINATE waypOrd){
+  TBOX robot = BOX_INDEX(robotOrd.x, robotOrd.y);
+  TBOX box, next;
+  uint8_t dir, grown;
+  bool flowing = true;
+
+  if(!floodValid || floodWayP.x != waypOrd.x || floodWayP.y != waypOrd.y)
+  {
+    for(box = 0; box < sizeof(flood); box++){
+      flood[box] = 0xFF; //Every box is FLOOD_NONE
+    }
+
+    SET_PAIR(flood, BOX_INDEX(waypOrd.x, waypOrd.y), 0); //Set the way-point to flood point 0
+    floodFront = 0;
+    floodWayP = waypOrd;
+    floodValid = true;
+#ifdef PATH_STATS
+    cacheStats.misses++;
+#endif
+  }
+
+  /* There is no queue of the wave-front, so each flood number is found by sweeping the map.
+   * A box the water hasn't reached yet, next to one on the last wave-front, is one further on.
+   * The boxes from three flood numbers back have the same value, but every box next to one
+   * of those was reached long ago.
+   */
+  while(flowing && GET_PAIR(flood, robot) == FLOOD_NONE)
+  {
+    grown = (floodFront + 1) % 3;
+    flowing = false;
+
+    for(box = 0; box < MAP_CELLS; box++)
+    {
+      if(GET_PAIR(flood, box) != FLOOD_NONE)
+        continue;
+
+      for(dir = 0; dir < 4; dir++){
+        if(openNeighbour(box, dir, &next) && GET_PAIR(flood, next) == floodFront){
+          SET_PAIR(flood, box, grown);
+          flowing = true;
+#ifdef PATH_STATS
+          cacheStats.flowed++;
+#endif
+          break;
+        }
+      }
+    }
+
+    if(flowing)
+      floodFront = grown;
+  }
+
+  return (GET_PAIR(flood, robot) != FLOOD_NONE);
+}
+#elif defined(PATH_HIERARCHY)
+static bool planFlood(TORDINATE robotOrd, TORDINATE waypOrd){
+  static TPATH_DIST toSlot[CL_SLOTS]; //Boxes from the robot to each entrance of its cluster
+  TBOX robot = BOX_INDEX(robotOrd.x, robotOrd.y);
+  TBOX goal = BOX_INDEX(waypOrd.x, waypOrd.y);
+  TCLUSTER c = CLUSTER_OF(robot);
+  TPATH_DIST best = -1;
+  TNODE node;
+  uint8_t i, slot;
+
+  if(intraFull)
+    return false; //The paths inside the clusters aren't all known
+
+  if(!floodValid || floodWayP.x != waypOrd.x || floodWayP.y != waypOrd.y)
+  {
+    for(node = 0; node < NODE_COUNT; node++){
+      heapPos[node] = NODE_NONE;
+    }
+    heapLen = 0;
+
+    //Start the search from the entrances of the way-point's cluster
+    startLocal();
+    seedLocal(goal, 0);
+    floodCluster(CLUSTER_OF(goal));
+    for(i = 0; i < slotsLen[CLUSTER_OF(goal)]; i++){
+      node = slotNode(CLUSTER_OF(goal), slotsUsed[CLUSTER_OF(goal)][i]);
+      if(localDist[LOCAL_OF(nodeBox(node))] != -1)
+        reachNode(node, localDist[LOCAL_OF(nodeBox(node))]);
+    }
+
+    floodWayP = waypOrd;
+    floodValid = true;
+#ifdef PATH_STATS
+    cacheStats.misses++;
+#endif
+  }
+
+  //The robot's way out of its cluster, or straight to the way-point if it is in the same one
+  startLocal();
+  seedLocal(robot, 0);
+  floodCluster(c);
+  fieldCluster = CL_COUNT; //localDist no longer holds the path to the way-point
+
+  if(CLUSTER_OF(goal) == c)
+    best = localDist[LOCAL_OF(goal)];
+
+  for(i = 0; i < slotsLen[c]; i++)
+  {
+    slot = slotsUsed[c][i];
+    node = slotNode(c, slot);
+    toSlot[slot] = localDist[LOCAL_OF(nodeBox(node))];
+    if(toSlot[slot] != -1 && heapPos[node] == NODE_DONE && (best == -1 || (toSlot[slot] + nodeCost[node]) < best))
+      best = toSlot[slot] + nodeCost[node];
+  }
+
+  //Settle the nearest entrances to the way-point, until none of the rest can be on a shorter path
+  while(heapLen && (best == -1 || nodeCost[heap[0]] < best))
+  {
+    node = settleNode();
+    if(nodeCluster(node) != c)
+      continue;
+
+    slot = nodeSlot(node);
+    if(toSlot[slot] != -1 && (best == -1 || (toSlot[slot] + nodeCost[node]) < best))
+      best = toSlot[slot] + nodeCost[node];
+  }
+
+  return (best != -1);
+}
+#else
+static bool planFlood(TORDINATE robotOrd, TORDINATE waypOrd){
+  TPATH_ORD x, y;
+
+  //A flood from the same way-point is still valid for any robot position (walls found since
+  //have already been repaired), so only start again if the way-point has changed.
+  if(!floodValid || floodWayP.x != waypOrd.x || floodWayP.y != waypOrd.y)
+  {
+#if (PATH_CACHE_SIZE > 0)
+    if(!loadCachedFlood(waypOrd)) //Swaps this flood into the cache, if there was one
+#endif
+    {
+#if (PATH_CACHE_SIZE > 0)
+      if(floodValid)
+        cacheFlood(); //Keep this flood in case the robot heads back to its way-point
+#endif
+      //Reset the Path map - Each value contains '-1' to signify no path
+      for(x = 0; x < MAP_WIDTH; x++){
+        for(y = 0; y < MAP_HEIGHT; y++){
+          PATH_Path[x][y] = -1;
+        }
+      }
+
+      queueHead = 0; queueLen = 0;
+#ifdef PATH_BITBOARD
+      floodBitboard(robotOrd, waypOrd); //Flood a row at a time, only the last wave-front is left queued
+#else
+      PATH_Path[waypOrd.x][waypOrd.y] = 0; //Set the way-point to flood point 0
+      queueBox(BOX_INDEX(waypOrd.x, waypOrd.y));
+#endif
+#ifdef PATH_STATS
+      cacheStats.misses++;
+#endif
+    }
+
+    floodWayP = waypOrd;
+    floodValid = true;
+  }
+
+  flowWater(robotOrd);
+#ifdef PATH_DOWNHILL
+  downhillValid = false; //Rebuilt the first time the path is followed
+#endif
+
+  return (PATH_Path[robotOrd.x][robotOrd.y] != -1);
+}
+#endif
+
+/*! @brief Finds which way to leave a box to follow the path of the last plan.
+ *
+ *  @param box - The index of the box
+ *  @param facing - The map direction the robot faces in the box, checked first so
+ *                  that it wins any tie
+ *
+ *  @return dir - The map direction to move in (0 - Front, 1 - Right, 2 - Back, 3 - Left),
+ *                or -1 if the box is the way-point or there is no path from it.
+ */
+static int8_t nextHeading(TBOX box, uint8_t facing){
+  static const uint8_t order[4] = {0, 3, 1, 2}; //CW turns in the order to try them: straight, left, right, back
+  uint8_t i, dir;
+#ifdef PATH_COMPACT
+  TBOX next;
+  uint8_t down = GET_PAIR(flood, box);
+
+  if(!floodValid || down == FLOOD_NONE || box == BOX_INDEX(floodWayP.x, floodWayP.y))
+    return -1; //Already there, or not on the path
+
+  /* The flood numbers of two neighbours differ by at most one, so the neighbour one closer
+   * to the way-point is the only one whose value is one less (mod 3).
+   */
+  down = (down + 2) % 3;
+  for(i = 0; i < 4; i++){
+    dir = (facing + order[i]) % 4;
+    if(openNeighbour(box, dir, &next) && GET_PAIR(flood, next) == down)
+      return dir;
+  }
+
+  return -1;
+#elif defined(PATH_HIERARCHY)
+  TBOX next;
+  TNODE node;
+  TPATH_DIST dist, down;
+  TCLUSTER c = CLUSTER_OF(box);
+
+  if(!floodValid)
+    return -1;
+
+  if(c != fieldCluster)
+    refineCluster(c); //Only worked out once the path gets to the cluster
+
+  dist = localDist[LOCAL_OF(box)];
+  if(dist <= 0)
+    return -1; //Already there, or not on the path
+
+  for(i = 0; i < 4; i++)
+  {
+    dir = (facing + order[i]) % 4;
+    if(!openNeighbour(box, dir, &next))
+      continue;
+
+    if(CLUSTER_OF(next) == c){
+      down = localDist[LOCAL_OF(next)];
+    } else {
+      //Leaving the cluster, which can only be done through an entrance
+      node = crossingNode(box, dir);
+      down = (node != NODE_NONE && heapPos[node ^ 1] == NODE_DONE) ? nodeCost[node ^ 1] : -1;
+    }
+
+    if(down != -1 && down == (dist - 1))
+      return dir;
+  }
+
+  return -1;
+#else
+  uint8_t dirs;
+#ifdef PATH_TURNS
+  TBOX down;
+  int8_t best;
+  uint16_t time, bestTime = 0;
+#endif
+#ifndef PATH_NO_HOPS
+  TMAZE_HOP hop;
+  TBOX next;
+
+  if(HOPS_PLANNED)
+  {
+    hop = MazeHops[hopsWayP][box];
+    if(hop == HOP_NONE || HOP_DIST(hop) == 0)
+      return -1; //Already there, or no path
+
+    //The table only holds one way out, so check straight on is not just as short
+    if(openNeighbour(box, facing, &next) && HOP_DIST(MazeHops[hopsWayP][next]) == (HOP_DIST(hop) - 1))
+      return facing;
+
+    return HOP_DIR(hop);
+  }
+#endif
+
+  if(!downhillValid)
+    buildDownhill();
+
+  dirs = DOWNHILL(box);
+#ifdef PATH_TURNS
+  //Of the ways downhill, the one that leaves the least turning to do (straight on wins a tie)
+  for(i = 0, best = -1; i < 4; i++){
+    dir = (facing + order[i]) % 4;
+    if(!(dirs & (1 << dir)))
+      continue;
+
+    openNeighbour(box, dir, &down);
+    time = turnTime(facing, dir) + ((uint16_t) TURNS(down, dir) * PATH_TIME_TURN90);
+    if(best == -1 || time < bestTime){
+      best = dir;
+      bestTime = time;
+    }
+  }
+
+  return best; //-1 if already there, or not on the path
+#else
+  for(i = 0; i < 4; i++){
+    dir = (facing + order[i]) % 4;
+    if(dirs & (1 << dir))
+      return dir;
+  }
+
+  return -1; //Already there, or not on the path
+#endif
+#endif
+}
+
+/*! @brief Finds the number of boxes along the path of the last plan from a box to
+ *         the way-point.
+ *
+ *  @param box - The index of the box
+ *
+ *  @return dist - The number of boxes, or -1 if the 'water' hasn't reached the box
+ */
+static TPATH_DIST pathLength(TBOX box){
+#ifdef PATH_COMPACT
+  TPATH_DIST dist = 0;
+  TBOX next;
+  int8_t dir;
+
+  if(!floodValid || GET_PAIR(flood, box) == FLOOD_NONE)
+    return -1;
+
+  //Only the flood numbers mod 3 are kept, so count the boxes on the way down
+  while((dir = nextHeading(box, 0)) != -1)
+  {
+    openNeighbour(box, dir, &next);
+    box = next;
+    dist++;
+  }
+
+  return dist;
+#elif defined(PATH_HIERARCHY)
+  if(!floodValid)
+    return -1;
+
+  if(CLUSTER_OF(box) != fieldCluster)
+    refineCluster(CLUSTER_OF(box));
+
+  return localDist[LOCAL_OF(box)];
+#else
+  return PATH_BOX(box);
+#endif
+}
+
+#ifdef PATH_DOWNHILL
+/*! @brief Works out which ways lead downhill out of every box the 'water' has reached.
+ */
+static void buildDownhill(void){
+  TBOX box, next;
+  TPATH_DIST dist;
+  uint8_t dir, dirs;
+
+  for(box = 0; box < MAP_CELLS; box++)
+  {
+    dirs = 0;
+    dist = PATH_BOX(box);
+
+    if(dist > 0){
+      for(dir = 0; dir < 4; dir++){
+        if(openNeighbour(box, dir, &next) && PATH_BOX(next) == (dist - 1))
+          dirs |= (1 << dir);
+      }
+    }
+
+    if(box % 2)
+      downhill[box / 2] = (downhill[box / 2] & 0x0F) | (dirs << 4);
+    else
+      downhill[box / 2] = (downhill[box / 2] & 0xF0) | dirs;
+  }
+
+#ifdef PATH_TURNS
+  buildTurns();
+#endif
+  downhillValid = true;
+}
+#endif
+
+#ifdef PATH_TURNS
+/*! @brief Works out the fewest 90 degree turns from every box the 'water' has reached to
+ *         the way-point, along the downhill directions, for each way into the box.
+ *
+ *  The boxes are gone through uphill from the way-point (in lostBoxes, as a repair would),
+ *  so the boxes a box leads downhill to are always done before it.
+ */
+static void buildTurns(void){
+  TBOX head, tail = 1, box, next;
+  uint8_t dir, face, fewest;
+  uint16_t count, best[4];
+
+  lostBoxes[0] = BOX_INDEX(floodWayP.x, floodWayP.y);
+  SET_MARK(lostBoxes[0]);
+
+  for(head = 0; head < tail; head++)
+  {
+    box = lostBoxes[head];
+
+    for(face = 0, fewest = TURNS_MAX; face < 4; face++){
+      best[face] = (PATH_BOX(box) == 0) ? 0 : TURNS_MAX;
+      for(dir = 0; dir < 4; dir++){
+        if(!(DOWNHILL(box) & (1 << dir)))
+          continue;
+
+        openNeighbour(box, dir, &next);
+        count = TURNS(next, dir) + ((dir == face) ? 0 : (dir == ((face + 2) % 4)) ? 2 : 1);
+        if(count < best[face])
+          best[face] = count;
+      }
+
+      if(best[face] < fewest)
+        fewest = best[face];
+    }
+
+    turns[box][0] = fewest;
+    turns[box][1] = 0;
+    for(face = 0; face < 4; face++){
+      turns[box][1] |= ((best[face] - fewest) << (face * 2));
+    }
+
+    for(dir = 0; dir < 4; dir++){
+      if(openNeighbour(box, dir, &next) && PATH_BOX(next) == (PATH_BOX(box) + 1) && !MARKED(next)){
+        SET_MARK(next);
+        lostBoxes[tail++] = next;
+      }
+    }
+  }
+
+  for(head = 0; head < tail; head++){
+    CLEAR_MARK(lostBoxes[head]);
+  }
+}
+
+/*! @brief Finds the time it takes to turn from one map direction to another.
+ *
+ *  @param from - The map direction faced
+ *  @param to - The map direction to face
+ *
+ *  @return time - In units of 10ms
+ */
+static uint16_t turnTime(uint8_t from, uint8_t to){
+  switch((to + 4 - from) % 4){
     case 0:
-      ord->x = ord->x - 1; break;
-    case 1:
-      ord->y = ord->y + 1; break;
+      return 0;
     case 2:
-      ord->x = ord->x + 1; break;
-    case 3:
-      ord->y = ord->y - 1; break;
+      return PATH_TIME_TURN180;
+    default:
+      return PATH_TIME_TURN90;
+  }
+}
+#endif
+
+#ifdef PATH_FLOOD
+/*! @brief Flows the 'water' out of each reached box in order of its flood number (a
+ *         breadth first wave-front).
+ *
+ *  Every box is labelled once, and its label is already the shortest distance to the
+ *  way-point. We can stop as soon as the water has reached the robot; the boxes left in
+ *  the queue let a later call carry on from here.
+ *
+ *  @param stopOrd - Stop once the water reaches this box. If x is PATH_ORD_NONE the
+ *                   whole map is flooded.
+ */
+static void flowWater(TORDINATE stopOrd){
+  TBOX box, next;
+  uint8_t dir;
+
+  while(queueLen && ((stopOrd.x == PATH_ORD_NONE) || (PATH_Path[stopOrd.x][stopOrd.y] == -1)))
+  {
+    box = floodQueue[queueHead];
+    queueHead = (queueHead + 1) % MAP_CELLS;
+    queueLen--;
+#ifdef PATH_STATS
+    cacheStats.flowed++;
+#endif
+
+    //Flow into every neighbour that isn't walled off and hasn't been reached yet
+    for(dir = 0; dir < 4; dir++){
+      if(openNeighbour(box, dir, &next) && PATH_BOX(next) == -1){
+        PATH_BOX(next) = PATH_BOX(box) + 1;
+        queueBox(next);
+      }
+    }
   }
 }
+#endif
 
 /*! @brief Normalizes the wall location in relation to the robot for a
  *  particular square.
@@ -172,7 +1135,7 @@ void PATH_UpdateCoordinate(TORDINATE * ord){
  *
  *  @return 8-bit number - Normalized info about the box.
  */
-static uint8_t getNormalisedBoxVal(uint8_t x, uint8_t y){
+static uint8_t getNormalisedBoxVal(TPATH_ORD x, TPATH_ORD y){
   /* We want to normalize the values in the map boxes that correspond to the
    * 4 walls. To 'normalize' this value, we must bit shift the box values by the
    * amount of times the robot has rotated in the system.
@@ -187,8 +1150,8 @@ static uint8_t getNormalisedBoxVal(uint8_t x, uint8_t y){
    * to illustrate the algorithm.
    */
   uint8_t temp;
-  uint8_t pwalls = (Map[x][y] & PWALLS);      //Eg. pwalls = 0000 1001
-  uint8_t vwalls = (Map[x][y] & VWALLS) >> 4; //Eg. vwalls = 0000 1001
+  uint8_t pwalls = (BOX_WALLS(BOX_INDEX(x, y)) & PWALLS);      //Eg. pwalls = 0000 1001
+  uint8_t vwalls = (BOX_WALLS(BOX_INDEX(x, y)) & VWALLS) >> 4; //Eg. vwalls = 0000 1001
 
   vwalls = vwalls << rotationFactor;  //Eg. vwalls = 0100 1000
   temp = vwalls << 4;                      //Eg. temp = 1000 0000
@@ -202,43 +1165,1030 @@ static uint8_t getNormalisedBoxVal(uint8_t x, uint8_t y){
   return (vwalls | pwalls);               // return = 1100 1100
 }
 
-/*! @brief Finds and returns the highest 'flood' number in an accessible
- *         neighbouring cell.
+/*! @brief Finds the neighbour of a box in a particular direction on the map.
  *
- *  @param x - horizontal ordinate
- *  @param y - vertical ordinate
+ *  @param box - The index of the box to look from
+ *  @param dir - The map direction to look in (0 - Front, 1 - Right, 2 - Back, 3 - Left)
+ *  @param next - A pointer to where the index of the neighbour is stored
  *
- *  @return 8-bit number - The highest 'flood' number found
+ *  @return TRUE - If there is no wall between the box and its neighbour
  */
-static int8_t highestNeighbourCell(uint8_t x, uint8_t y){
-  int8_t highestVal = -1;
-  int8_t valAtNext;
+static bool openNeighbour(TBOX box, uint8_t dir, TBOX * next){
+#ifdef PATH_COMPACT
+  switch(dir){
+    case 0:
+      if(box < MAP_HEIGHT || (GET_PAIR(walls, box - MAP_HEIGHT) & 2))
+        return false;
+      break;
+    case 1:
+      if(GET_PAIR(walls, box) & 1)
+        return false;
+      break;
+    case 2:
+      if(GET_PAIR(walls, box) & 2)
+        return false;
+      break;
+    case 3:
+      if((box % MAP_HEIGHT) == 0 || (GET_PAIR(walls, box - 1) & 1))
+        return false;
+      break;
+  }
+#else
+  if(MAP_BOX(box) & (FRONT >> dir))
+    return false;
+#endif
+
+  switch(dir){
+    case 0:
+      *next = box - MAP_HEIGHT; break;
+    case 1:
+      *next = box + 1;          break;
+    case 2:
+      *next = box + MAP_HEIGHT; break;
+    default:
+      *next = box - 1;          break;
+  }
+
+  return true;
+}
+
+#ifdef PATH_COMPACT
+/*! @brief Puts together the walls of a box in the same form as Map.
+ *
+ *  @param box - The index of the box
+ *  @return 8-bit number - The box's walls. Virtual walls are only kept in RAM, so the
+ *                         physical walls are the ones in the surveyed map.
+ */
+static uint8_t boxWalls(TBOX box){
+  TBOX next;
+  uint8_t dir, val = (MAP_BOX(box) & PWALLS);
+
+  for(dir = 0; dir < 4; dir++){
+    if(!openNeighbour(box, dir, &next))
+      val |= (FRONT >> dir);
+  }
+
+  return val;
+}
+#endif
+
+#ifdef PATH_FLOOD
+/*! @brief Determines if a box can still flow 'downhill' into a neighbour whose
+ *         flood number is one less than its own.
+ *
+ *  @param box - The index of the box to check
+ *  @return TRUE - If the box still has a shortest path to the way-point
+ */
+static bool hasDownhillNeighbour(TBOX box){
+  TBOX next;
+  uint8_t dir;
+
+  for(dir = 0; dir < 4; dir++){
+    if(openNeighbour(box, dir, &next) && PATH_BOX(next) != -1 && PATH_BOX(next) == (PATH_BOX(box) - 1))
+      return true;
+  }
+
+  return false;
+}
+
+/*! @brief Places a reached box in the flood queue, keeping the queue in order
+ *         of flood number.
+ *
+ *  @param box - The index of the box to queue
+ *
+ *  @note While flooding, each new box has the highest number in the queue so this
+ *        is a plain append. Only boxes re-queued by a repair need to be shuffled in.
+ */
+static void queueBox(TBOX box){
+  TBOX slot = (queueHead + queueLen) % MAP_CELLS;
+  TBOX prev;
+
+  /* A box is only ever queued once while it is waiting (it is either unreached when it is
+   * flooded, or marked by repairFloodAcross), so the ring can never overflow.
+   */
+  while(slot != queueHead)
+  {
+    prev = (slot + MAP_CELLS - 1) % MAP_CELLS;
+    if(PATH_BOX(floodQueue[prev]) <= PATH_BOX(box))
+      break;
+
+    floodQueue[slot] = floodQueue[prev]; //Shuffle the higher box back a place
+    slot = prev;
+  }
+
+  floodQueue[slot] = box;
+  queueLen++;
+}
+
+/*! @brief Repairs the current flood after a wall was placed between two boxes.
+ *
+ *  Only the boxes whose every shortest path ran through the new wall lose their
+ *  flood number. The reached boxes bordering them are put back in the flood queue,
+ *  so the next call to PATH_Plan re-floods just that region. The work done is in
+ *  proportion to the region lost and the wave-front, not the map.
+ *
+ *  @param boxA - The index of the box on one side of the wall
+ *  @param boxB - The index of the box on the other side of the wall
+ */
+static void repairFloodAcross(TBOX boxA, TBOX boxB){
+  TBOX numLost = 1;
+  TBOX i, kept, box, next;
+  uint8_t dir;
+  TPATH_DIST dist;
+
+  if(PATH_BOX(boxA) == -1 || PATH_BOX(boxB) == -1)
+    return; //The water never flowed between these two boxes
+
+  //The wall only matters if water flowed 'uphill' through it, from one box to the other
+  if(PATH_BOX(boxB) == (PATH_BOX(boxA) + 1)){
+    lostBoxes[0] = boxB;
+  } else if(PATH_BOX(boxA) == (PATH_BOX(boxB) + 1)){
+    lostBoxes[0] = boxA;
+  } else {
+    return;
+  }
+  SET_MARK(lostBoxes[0]);
+
+  /* Walk uphill from the wall. Boxes are checked in order of flood number, so by the time a
+   * box is checked, every box that could still lead it downhill has already been decided.
+   */
+  for(i = 0; i < numLost; i++)
+  {
+    if(hasDownhillNeighbour(lostBoxes[i]))
+      continue; //Box still has another way to the way-point
+
+    dist = PATH_BOX(lostBoxes[i]);
+    PATH_BOX(lostBoxes[i]) = -1;
+
+    for(dir = 0; dir < 4; dir++){
+      if(openNeighbour(lostBoxes[i], dir, &next) && PATH_BOX(next) == (dist + 1) && !MARKED(next)){
+        SET_MARK(next);
+        lostBoxes[numLost++] = next; //Box may only have been reached through this one
+      }
+    }
+  }
+
+  for(i = 0; i < numLost; i++){
+    CLEAR_MARK(lostBoxes[i]);
+  }
+
+  //Drop the lost boxes from the wave-front still waiting to flow, and mark the rest as queued
+  for(i = 0, kept = 0; i < queueLen; i++){
+    box = floodQueue[(queueHead + i) % MAP_CELLS];
+    if(PATH_BOX(box) != -1){
+      floodQueue[(queueHead + kept) % MAP_CELLS] = box;
+      SET_MARK(box);
+      kept++;
+    }
+  }
+  queueLen = kept;
+
+  //Let the water flow back in from every reached box that borders the lost region
+  for(i = 0; i < numLost; i++)
+  {
+    if(PATH_BOX(lostBoxes[i]) != -1)
+      continue; //Kept its path, so it was never part of the region
+
+    for(dir = 0; dir < 4; dir++){
+      if(openNeighbour(lostBoxes[i], dir, &next) && PATH_BOX(next) != -1 && !MARKED(next)){
+        SET_MARK(next);
+        queueBox(next); //Found in about the order of flood number, so this is close to an append
+      }
+    }
+  }
+
+  for(i = 0; i < queueLen; i++){
+    CLEAR_MARK(floodQueue[(queueHead + i) % MAP_CELLS]);
+  }
+}
+#endif
+
+/*! @brief Places a (virtual) wall on one side of a box.
+ *
+ *  @param box - The index of the box
+ *  @param dir - The map direction of the wall (0 - Front, 1 - Right, 2 - Back, 3 - Left)
+ */
+static void closeWall(TBOX box, uint8_t dir){
+#ifdef PATH_COMPACT
+  //The front and left walls are kept by the neighbour, as its back and right walls
+  if(dir == 0){
+    box -= MAP_HEIGHT; dir = 2;
+  } else if(dir == 3){
+    box -= 1; dir = 1;
+  }
+
+  SET_PAIR(walls, box, GET_PAIR(walls, box) | dir); //The right wall is bit 0, the back wall bit 1
+#else
+  MAP_BOX(box) |= (FRONT >> dir);
+#endif
+#ifdef PATH_BITBOARD
+  openRows[dir][box / MAP_HEIGHT][ROW_WORD(box % MAP_HEIGHT)] &= ~ROW_BIT(box % MAP_HEIGHT);
+#endif
+}
+
+/*! @brief Places a wall between a box and its neighbour, and fixes up the plans
+ *         that went through it.
+ *
+ *  @param ord - The box on one side of the wall
+ *  @param dir - The map direction of the wall from that box
+ *  @param physical - TRUE for a real wall, FALSE for a virtual wall
+ */
+static void addWall(TORDINATE ord, uint8_t dir, bool physical){
+  TORDINATE nextOrd = ord;
+  TBOX box = BOX_INDEX(ord.x, ord.y);
+  TBOX next;
+
+  stepOrdinate(&nextOrd, dir); //The wall is shared with the next 'square'
+  next = BOX_INDEX(nextOrd.x, nextOrd.y);
+
+  closeWall(box, dir);
+  closeWall(next, (dir + 2) % 4);
+#ifdef PATH_COMPACT
+  (void) physical; //Only the open walls are stored, so real and virtual walls are the same
+#else
+  if(physical){
+    MAP_BOX(box) |= (P_FRONT >> dir);
+    MAP_BOX(next) |= (P_FRONT >> ((dir + 2) % 4));
+  }
+#endif
+#ifdef PATH_FLOOD
+  setKnown(box, P_FRONT >> dir);
+  setKnown(next, P_FRONT >> ((dir + 2) % 4));
+#endif
+  mapVersion++;
+#ifndef PATH_NO_HOPS
+  hopsValid = false; //MazeHops no longer matches the map, so paths are flooded from now on
+#endif
+
+#ifdef PATH_COMPACT
+  floodValid = false; //Without a queue the flood can't be repaired, so it is started again
+#elif defined(PATH_HIERARCHY)
+  buildWall(box, next, dir);
+  floodValid = false; //The paths between entrances have changed, so the search is started again
+#else
+  if(floodValid) //Fix up the part of the current flood that flowed through the new wall
+    repairFloodAcross(box, next);
+#endif
+#ifdef PATH_DOWNHILL
+  downhillValid = false;
+#endif
+#if (PATH_CACHE_SIZE > 0)
+  dropCachedAcross(ord, nextOrd);
+#endif
+}
+
+/*! @brief Advances an ordinate into the next box in a map direction.
+ *
+ *  @param ord - A pointer to the coordinate to update
+ *  @param dir - The map direction to move in (0 - Front, 1 - Right, 2 - Back, 3 - Left)
+ */
+static void stepOrdinate(TORDINATE * ord, uint8_t dir){
+  switch(dir){
+    case 0:
+      ord->x = ord->x - 1; break;
+    case 1:
+      ord->y = ord->y + 1; break;
+    case 2:
+      ord->x = ord->x + 1; break;
+    case 3:
+      ord->y = ord->y - 1; break;
+  }
+}
+
+#ifdef PATH_FLOOD
+/*! @brief Marks sides of a box as explored.
+ *
+ *  @param box - The index of the box
+ *  @param sides - The sides explored, as P_ bits
+ */
+static void setKnown(TBOX box, uint8_t sides){
+  known[box / 2] |= (sides << ((box % 2) * 4));
+}
+#endif
+
+/*! @brief Throws away every flood and timed plan, e.g. when the map is replaced.
+ */
+static void forgetPlans(void){
+#if (PATH_CACHE_SIZE > 0)
+  uint8_t i;
+
+  for(i = 0; i < PATH_CACHE_SIZE; i++){
+    cacheWayP[i] = MAP_CELLS;
+  }
+  cacheNext = 0;
+#endif
+  floodValid = false;
+#ifdef PATH_DOWNHILL
+  downhillValid = false;
+#endif
+}
+
+#if (PATH_CACHE_SIZE > 0)
+/*! @brief Keeps a copy of the current flood in the cache.
+ *
+ *  The flood queue is not copied. As the queue is in order of flood number, every box
+ *  below the number at its head has already flowed out, so the queue can be rebuilt
+ *  from the boxes at or above it (flowing out of a box twice does nothing).
+ */
+static void cacheFlood(void){
+  TPATH_ORD x, y;
+  TBOX wayP = BOX_INDEX(floodWayP.x, floodWayP.y);
+  uint8_t i;
+
+  //Replace an older flood from the same way-point, or an empty entry, otherwise the oldest entry
+  for(i = 0; (i < PATH_CACHE_SIZE) && (cacheWayP[i] != wayP); i++);
+  if(i == PATH_CACHE_SIZE)
+    for(i = 0; (i < PATH_CACHE_SIZE) && (cacheWayP[i] != MAP_CELLS); i++);
+  if(i == PATH_CACHE_SIZE){
+    i = cacheNext;
+    cacheNext = (cacheNext + 1) % PATH_CACHE_SIZE;
+  }
+
+  cacheWayP[i] = wayP;
+  cacheFront[i] = queueLen ? PATH_BOX(floodQueue[queueHead]) : -1;
+  for(x = 0; x < MAP_WIDTH; x++){
+    for(y = 0; y < MAP_HEIGHT; y++){
+      cacheField[i][x][y] = PATH_Path[x][y];
+    }
+  }
+}
+
+/*! @brief Starts a flood by copying a cached flood from the same way-point.
+ *
+ *  The current flood (if any) is swapped into the entry it was copied from, so going
+ *  back and forth between way-points never pushes out the flood about to be used.
+ *
+ *  @param waypOrd - The way-point to flood from
+ *
+ *  @return TRUE - If a cached flood was found, it is left in PATH_Path with its
+ *                 wave-front queued.
+ */
+static bool loadCachedFlood(TORDINATE waypOrd){
+  TPATH_ORD x, y;
+  TBOX wayP = BOX_INDEX(waypOrd.x, waypOrd.y);
+  TPATH_DIST front, dist;
+  uint8_t i;
+
+  for(i = 0; (i < PATH_CACHE_SIZE) && (cacheWayP[i] != wayP); i++);
+  if(i == PATH_CACHE_SIZE)
+    return false;
+
+  front = cacheFront[i];
+  if(floodValid){
+    cacheWayP[i] = BOX_INDEX(floodWayP.x, floodWayP.y);
+    cacheFront[i] = queueLen ? PATH_BOX(floodQueue[queueHead]) : -1;
+  } else {
+    cacheWayP[i] = MAP_CELLS;
+  }
+
+  queueHead = 0; queueLen = 0;
+  for(x = 0; x < MAP_WIDTH; x++){
+    for(y = 0; y < MAP_HEIGHT; y++){
+      dist = cacheField[i][x][y];
+      cacheField[i][x][y] = PATH_Path[x][y];
+      PATH_Path[x][y] = dist;
+      if(front != -1 && dist >= front)
+        queueBox(BOX_INDEX(x, y)); //Box may not have flowed out yet
+    }
+  }
+#ifdef PATH_STATS
+  cacheStats.hits++;
+#endif
+
+  return true;
+}
+
+/*! @brief Empties the cache entries whose paths ran through a new wall between two boxes.
+ *
+ *  Water only flowed through the wall if the flood numbers either side differ by one,
+ *  any other flood (or the part not flooded yet) is unchanged by it.
+ *
+ *  @param ordA - The box on one side of the wall
+ *  @param ordB - The box on the other side of the wall
+ */
+static void dropCachedAcross(TORDINATE ordA, TORDINATE ordB){
+  TPATH_DIST distA, distB;
+  uint8_t i;
+
+  for(i = 0; i < PATH_CACHE_SIZE; i++)
+  {
+    if(cacheWayP[i] == MAP_CELLS)
+      continue;
+
+    distA = cacheField[i][ordA.x][ordA.y];
+    distB = cacheField[i][ordB.x][ordB.y];
+    if(distA != -1 && distB != -1 && (distA == (distB + 1) || distB == (distA + 1)))
+      cacheWayP[i] = MAP_CELLS;
+  }
+}
+#endif
+
+#ifndef PATH_NO_HOPS
+/*! @brief Checks that MazeHops was generated from the map, and that the map has no
+ *         virtual walls, so paths can be looked up from it.
+ *
+ *  @return bool - TRUE if MazeHops can be used.
+ */
+static bool checkHops(void){
+  uint16_t check = 0;
+  TBOX box;
+
+  for(box = 0; box < MAP_CELLS; box++){
+    if((MAP_BOX(box) >> 4) != (MAP_BOX(box) & PWALLS))
+      return false; //A virtual wall is already on the map
+
+    check += (uint16_t) ((box + 1) * (MAP_BOX(box) & PWALLS)); //Same sum as tools/mazegen.py
+  }
+
+  return (check == MAZE_HOPS_CHECK);
+}
+
+/*! @brief Finds the row of MazeHops that holds paths to a box.
+ *
+ *  @param wayP Box index of the way-point.
+ *  @return TBOX - Row of MazeHops, or HOP_NO_ROW if the table has no row for the box.
+ */
+static TBOX hopsRow(TBOX wayP){
+#ifdef MAZE_HOPS_ROWS
+  TBOX i;
+
+  //The table was only built for the way-points of the course
+  for(i = 0; i < MAZE_HOPS_ROWS; i++){
+    if(MazeHopRows[i] == wayP)
+      return i;
+  }
+
+  return HOP_NO_ROW;
+#else
+  return wayP;
+#endif
+}
+#endif
+
+#ifdef PATH_BITBOARD
+/*! @brief Builds the open wall bitboards from the map.
+ */
+static void buildBitboards(void){
+  TPATH_ORD x, y;
+  uint8_t dir, w;
+
+  for(dir = 0; dir < 4; dir++){
+    for(x = 0; x < MAP_WIDTH; x++){
+      for(w = 0; w < ROW_WORDS; w++){
+        openRows[dir][x][w] = 0;
+      }
+      for(y = 0; y < MAP_HEIGHT; y++){
+        if(!(Map[x][y] & (FRONT >> dir)))
+          openRows[dir][x][ROW_WORD(y)] |= ROW_BIT(y);
+      }
+    }
+  }
+}
+
+/*! @brief Floods the map from a way-point, growing a whole row of the wave-front
+ *         at a time, until the water reaches the robot.
+ *
+ *  @param robotOrd - The current coordinates of the robot
+ *  @param waypOrd  - The coordinates of the way-point to flood from
+ *
+ *  @note Assumes PATH_Path has been reset and the flood queue is empty. The last
+ *        wave-front is left in the queue so the flood can be carried on later.
+ */
+static void floodBitboard(TORDINATE robotOrd, TORDINATE waypOrd){
+  TPATH_DIST dist = 0;
+  TPATH_ORD x, y;
+  TROW grown, row;
+  uint8_t w;
+  bool flowing = true;
+
+  for(x = 0; x < MAP_WIDTH; x++){
+    for(w = 0; w < ROW_WORDS; w++){
+      reachedRows[x][w] = 0;
+      frontRows[x][w] = 0;
+    }
+  }
+
+  PATH_Path[waypOrd.x][waypOrd.y] = 0; //Set the way-point to flood point 0
+  reachedRows[waypOrd.x][ROW_WORD(waypOrd.y)] = frontRows[waypOrd.x][ROW_WORD(waypOrd.y)] = ROW_BIT(waypOrd.y);
+
+  //Grow the wave-front one flood number at a time, until it reaches the robot or dries up
+  while(flowing && !(reachedRows[robotOrd.x][ROW_WORD(robotOrd.y)] & ROW_BIT(robotOrd.y)))
+  {
+    dist++;
+    flowing = false;
+
+    for(x = 0; x < MAP_WIDTH; x++){
+      for(w = 0; w < ROW_WORDS; w++){
+        //Water flows along the row (right and left), carrying over from the words either side
+        grown = ((frontRows[x][w] & openRows[1][x][w]) << 1) | ((frontRows[x][w] & openRows[3][x][w]) >> 1);
+        if(w > 0)
+          grown |= (frontRows[x][w-1] & openRows[1][x][w-1]) >> (ROW_BITS - 1);
+        if(w < (ROW_WORDS - 1))
+          grown |= (frontRows[x][w+1] & openRows[3][x][w+1]) << (ROW_BITS - 1);
+
+        //And in from the rows behind and in front
+        if(x > 0)
+          grown |= (frontRows[x-1][w] & openRows[2][x-1][w]);
+        if(x < (MAP_WIDTH - 1))
+          grown |= (frontRows[x+1][w] & openRows[0][x+1][w]);
 
-  if(!(Map[x][y] & FRONT)){ //If there is not a wall in front of us on map
-    valAtNext = PATH_Path[(x-1)][y];
-    //If the value of that next box to the front of us has a value thats
-    //greater than the biggest seen so far, then set it.
-    if(valAtNext > highestVal)
-      highestVal = valAtNext;
+        nextRows[x][w] = grown & ~reachedRows[x][w];
+      }
+      nextRows[x][ROW_WORDS - 1] &= ROW_MASK;
+    }
+
+    for(x = 0; x < MAP_WIDTH; x++){
+      for(w = 0; w < ROW_WORDS; w++){
+        frontRows[x][w] = nextRows[x][w];
+        reachedRows[x][w] |= nextRows[x][w];
+
+        //Label the boxes that were just reached, skipping over empty bytes of the word
+        for(y = w * ROW_BITS, row = nextRows[x][w]; row; y++, row >>= 1){
+          while(!(row & 0xFF)){
+            row >>= 8; y += 8;
+          }
+          if(row & 1)
+            PATH_Path[x][y] = dist;
+        }
+
+        if(nextRows[x][w])
+          flowing = true;
+      }
+    }
+  }
+
+  //The water hasn't flowed out of the last wave-front yet
+  for(x = 0; x < MAP_WIDTH; x++){
+    for(w = 0; w < ROW_WORDS; w++){
+      for(y = w * ROW_BITS, row = frontRows[x][w]; row; y++, row >>= 1){
+        if(row & 1)
+          queueBox(BOX_INDEX(x, y));
+      }
+    }
+  }
+}
+#endif
+
+#ifdef PATH_HIERARCHY
+/*! @brief Places the entrances on every border, then works out the paths between the
+ *         entrances of every cluster.
+ */
+static void buildClusters(void){
+  TCLUSTER c;
+
+  for(c = 0; c < CL_COUNT; c++){
+    buildBorder(c, 0);
+    buildBorder(c, 1);
+  }
+
+  for(c = 0; c < CL_COUNT; c++){
+    countSlots(c);
+  }
+  intraFull = false;
+  packIntra();
+}
+
+/*! @brief Places an entrance in the middle of each open stretch of a cluster's border.
+ *
+ *  A stretch is also ended by a wall along the border on either side, so every box of
+ *  a stretch can get to its entrance without leaving the cluster. Otherwise a path
+ *  through the stretch could be missed.
+ *
+ *  @param c - The cluster
+ *  @param kind - 0 for its right border, 1 for its back border
+ */
+static void buildBorder(TCLUSTER c, uint8_t kind){
+  TNODE first = ((c * 2) + kind) * CL_RUNS;
+  TPATH_ORD x = (c / CL_HEIGHT) * CL_SIZE, y = (c % CL_HEIGHT) * CL_SIZE;
+  TBOX box, next, prev;
+  uint8_t at, len, start = 0, e = 0;
+  bool open, joined, inRun = false;
+
+  for(at = 0; at < CL_RUNS; at++){
+    entranceAt[first + at] = ENTRANCE_NONE;
+  }
+
+  if(kind == 0){
+    if((c % CL_HEIGHT) == (CL_HEIGHT - 1))
+      return; //Outside of the map
+    len = ((MAP_WIDTH - x) < CL_SIZE) ? (MAP_WIDTH - x) : CL_SIZE;
+  } else {
+    if((c / CL_HEIGHT) == (CL_WIDTH - 1))
+      return;
+    len = ((MAP_HEIGHT - y) < CL_SIZE) ? (MAP_HEIGHT - y) : CL_SIZE;
   }
 
-  if(!(Map[x][y] & LEFT)){
-    valAtNext = PATH_Path[x][(y-1)];
-    if(valAtNext > highestVal)
-      highestVal = valAtNext;
+  for(at = 0; at <= len; at++)
+  {
+    open = false;
+    joined = false;
+    if(at < len){
+      box = (kind == 0) ? BOX_INDEX(x + at, y + CL_SIZE - 1) : BOX_INDEX(x + CL_SIZE - 1, y + at);
+      open = openNeighbour(box, (kind == 0) ? 1 : 2, &next);
+      //Joined to the box before it along the border, on both sides
+      joined = inRun && open && openNeighbour(box, (kind == 0) ? 0 : 3, &prev) && openNeighbour(next, (kind == 0) ? 0 : 3, &prev);
+    }
+
+    if(inRun && !joined){
+      entranceAt[first + e++] = (start + at - 1) / 2;
+      inRun = false;
+    }
+    if(open && !inRun){
+      start = at;
+      inRun = true;
+    }
   }
+}
+
+/*! @brief Finds the slots of a cluster that have an entrance.
+ *
+ *  @param c - The cluster
+ */
+static void countSlots(TCLUSTER c){
+  uint8_t slot, len = 0;
 
-  if(!(Map[x][y] & RIGHT)){
-    valAtNext = PATH_Path[x][(y+1)];
-    if(valAtNext > highestVal)
-      highestVal = valAtNext;
+  for(slot = 0; slot < CL_SLOTS; slot++){
+    if(slotNode(c, slot) != NODE_NONE)
+      slotsUsed[c][len++] = slot;
   }
+  slotsLen[c] = len;
+}
+
+/*! @brief Finds the entrances of a cluster again, and the paths between them.
+ *
+ *  @param c - The cluster
+ */
+static void buildCluster(TCLUSTER c){
+  countSlots(c);
+  if(intraFull)
+    return;
+
+  if(PAIRS(slotsLen[c]) > intraRoom[c])
+  {
+    if((PATH_INTRA_POOL - intraEnd) < PAIRS(slotsLen[c])){
+      packIntra(); //Also works out the paths of every cluster
+      return;
+    }
 
-  if(!(Map[x][y] & BACK)){
-    valAtNext = PATH_Path[(x+1)][y];
-    if(valAtNext > highestVal)
-      highestVal = valAtNext;
+    //Move to the end of the pool, the room it had is only taken back when the pool is packed
+    intraAt[c] = intraEnd;
+    intraRoom[c] = PAIRS(slotsLen[c]);
+    intraEnd += intraRoom[c];
   }
 
-  return highestVal;
-}
\ No newline at end of file
+  findIntra(c);
+}
+
+/*! @brief Works out the shortest path inside a cluster between each pair of its entrances.
+ *
+ *  @param c - The cluster
+ */
+static void findIntra(TCLUSTER c){
+  TPATH_DIST dist;
+  uint8_t i, j;
+
+  for(j = 1; j < slotsLen[c]; j++)
+  {
+    startLocal();
+    seedLocal(nodeBox(slotNode(c, slotsUsed[c][j])), 0);
+    floodCluster(c);
+
+    for(i = 0; i < j; i++){
+      dist = localDist[LOCAL_OF(nodeBox(slotNode(c, slotsUsed[c][i])))];
+      INTRA(c, i, j) = (dist == -1) ? CL_DIST_NONE : dist;
+    }
+  }
+
+  fieldCluster = CL_COUNT;
+}
+
+/*! @brief Gives every cluster just the room it needs in the pool, one after another, then
+ *         works out the paths of every cluster.
+ */
+static void packIntra(void){
+  TCLUSTER c;
+
+  intraEnd = 0;
+  for(c = 0; c < CL_COUNT; c++){
+    if((PATH_INTRA_POOL - intraEnd) < PAIRS(slotsLen[c])){
+      intraFull = true; //Even packed there isn't room
+      return;
+    }
+
+    intraAt[c] = intraEnd;
+    intraRoom[c] = PAIRS(slotsLen[c]);
+    intraEnd += intraRoom[c];
+  }
+
+  for(c = 0; c < CL_COUNT; c++){
+    findIntra(c);
+  }
+}
+
+/*! @brief Works out the entrances and the paths between them again, around a new wall.
+ *
+ *  @param box - The index of the box on one side of the wall
+ *  @param next - The index of the box on the other side
+ *  @param dir - The map direction of the wall from box
+ */
+static void buildWall(TBOX box, TBOX next, uint8_t dir){
+  TCLUSTER c = CLUSTER_OF(box);
+  TPATH_ORD x = (box / MAP_HEIGHT) % CL_SIZE, y = (box % MAP_HEIGHT) % CL_SIZE;
+
+  if(CLUSTER_OF(next) != c){
+    //Across a border, the right border of the cluster on the left or the back border of the one in front
+    if(dir % 2)
+      buildBorder(CLUSTER_OF((dir == 1) ? box : next), 0);
+    else
+      buildBorder(CLUSTER_OF((dir == 2) ? box : next), 1);
+    buildCluster(CLUSTER_OF(next));
+  } else if(dir % 2){
+    //A wall along the back or front border can split one of its stretches
+    if(x == (CL_SIZE - 1) && (c / CL_HEIGHT) != (CL_WIDTH - 1)){
+      buildBorder(c, 1);
+      buildCluster(c + CL_HEIGHT);
+    } else if(x == 0 && c >= CL_HEIGHT){
+      buildBorder(c - CL_HEIGHT, 1);
+      buildCluster(c - CL_HEIGHT);
+    }
+  } else {
+    //Or along the right or left border
+    if(y == (CL_SIZE - 1) && (c % CL_HEIGHT) != (CL_HEIGHT - 1)){
+      buildBorder(c, 0);
+      buildCluster(c + 1);
+    } else if(y == 0 && (c % CL_HEIGHT) != 0){
+      buildBorder(c - 1, 0);
+      buildCluster(c - 1);
+    }
+  }
+
+  buildCluster(c);
+}
+
+/*! @brief Works out the path to the way-point from every box of a cluster, leaving
+ *         through the entrances the search has settled.
+ *
+ *  @param c - The cluster
+ */
+static void refineCluster(TCLUSTER c){
+  TNODE node;
+  uint8_t i;
+
+  startLocal();
+  if(CLUSTER_OF(BOX_INDEX(floodWayP.x, floodWayP.y)) == c)
+    seedLocal(BOX_INDEX(floodWayP.x, floodWayP.y), 0);
+
+  for(i = 0; i < slotsLen[c]; i++){
+    node = slotNode(c, slotsUsed[c][i]);
+    if(heapPos[node] == NODE_DONE)
+      seedLocal(nodeBox(node), nodeCost[node]);
+  }
+
+  floodCluster(c);
+  fieldCluster = c;
+}
+
+/*! @brief Empties localDist and its queue, ready for a flood over one cluster.
+ */
+static void startLocal(void){
+  TLOCAL at;
+
+  for(at = 0; at < CL_BOXES; at++){
+    localDist[at] = -1;
+  }
+  localHead = 0;
+  localLen = 0;
+}
+
+/*! @brief Starts the water of a cluster's flood from a box.
+ *
+ *  @param box - The index of the box
+ *  @param dist - Its distance, the boxes with the lowest distance flow out first
+ */
+static void seedLocal(TBOX box, TPATH_DIST dist){
+  TLOCAL at = LOCAL_OF(box), slot;
+
+  if(localDist[at] != -1 && localDist[at] <= dist)
+    return;
+
+  localDist[at] = dist;
+
+  //Keep the queue in order of distance, as in queueBox
+  for(slot = localLen; slot > localHead && localDist[localQueue[slot - 1]] > dist; slot--){
+    localQueue[slot] = localQueue[slot - 1];
+  }
+  localQueue[slot] = at;
+  localLen++;
+}
+
+/*! @brief Flows the water out of the seeded boxes, without leaving the cluster.
+ *
+ *  @param c - The cluster
+ */
+static void floodCluster(TCLUSTER c){
+  TPATH_ORD x = (c / CL_HEIGHT) * CL_SIZE, y = (c % CL_HEIGHT) * CL_SIZE;
+  TBOX box, next;
+  TLOCAL at;
+  uint8_t dir;
+
+  while(localHead < localLen)
+  {
+    at = localQueue[localHead++];
+    box = BOX_INDEX(x + (at / CL_SIZE), y + (at % CL_SIZE));
+#ifdef PATH_STATS
+    cacheStats.flowed++;
+#endif
+
+    for(dir = 0; dir < 4; dir++){
+      if(openNeighbour(box, dir, &next) && CLUSTER_OF(next) == c)
+        seedLocal(next, localDist[at] + 1);
+    }
+  }
+}
+
+/*! @brief Finds the box at one end of an entrance.
+ *
+ *  @param node - The entrance end
+ *  @return box - The index of the box
+ */
+static TBOX nodeBox(TNODE node){
+  TNODE border = node / (2 * CL_RUNS);
+  TCLUSTER c = border / 2;
+  TPATH_ORD x = (c / CL_HEIGHT) * CL_SIZE, y = (c % CL_HEIGHT) * CL_SIZE;
+
+  if((border % 2) == 0){
+    x += entranceAt[node / 2];
+    y += CL_SIZE - 1 + (node % 2);
+  } else {
+    x += CL_SIZE - 1 + (node % 2);
+    y += entranceAt[node / 2];
+  }
+
+  return BOX_INDEX(x, y);
+}
+
+/*! @brief Finds the cluster one end of an entrance is in.
+ *
+ *  @param node - The entrance end
+ *  @return c - The cluster
+ */
+static TCLUSTER nodeCluster(TNODE node){
+  TNODE border = node / (2 * CL_RUNS);
+
+  if((node % 2) == 0)
+    return border / 2;
+
+  return (border / 2) + (((border % 2) == 0) ? 1 : CL_HEIGHT); //The cluster on the right or behind
+}
+
+/*! @brief Finds the slot an entrance end has in its cluster.
+ *
+ *  Slots are grouped by border: right, back, left and front.
+ *
+ *  @param node - The entrance end
+ *  @return slot - The slot
+ */
+static uint8_t nodeSlot(TNODE node){
+  return (((node / (2 * CL_RUNS)) % 2) + ((node % 2) * 2)) * CL_RUNS + ((node / 2) % CL_RUNS);
+}
+
+/*! @brief Finds the entrance end in a slot of a cluster.
+ *
+ *  @param c - The cluster
+ *  @param slot - The slot
+ *  @return node - The entrance end, or NODE_NONE if the slot is unused
+ */
+static TNODE slotNode(TCLUSTER c, uint8_t slot){
+  uint8_t e = slot % CL_RUNS;
+  TNODE node;
+
+  switch(slot / CL_RUNS){
+    case 0:
+      node = (((c * 2) * CL_RUNS) + e) * 2; break;
+    case 1:
+      node = ((((c * 2) + 1) * CL_RUNS) + e) * 2; break;
+    case 2:
+      if((c % CL_HEIGHT) == 0)
+        return NODE_NONE; //Left edge of the map
+      node = ((((c - 1) * 2) * CL_RUNS) + e) * 2 + 1; break;
+    default:
+      if(c < CL_HEIGHT)
+        return NODE_NONE; //Front edge of the map
+      node = (((((c - CL_HEIGHT) * 2) + 1) * CL_RUNS) + e) * 2 + 1; break;
+  }
+
+  return (entranceAt[node / 2] == ENTRANCE_NONE) ? NODE_NONE : node;
+}
+
+/*! @brief Finds the entrance end a box leaves its cluster through.
+ *
+ *  @param box - The index of the box, on the border of its cluster
+ *  @param dir - The map direction across the border
+ *  @return node - The entrance end in the box, or NODE_NONE if there is no entrance there
+ */
+static TNODE crossingNode(TBOX box, uint8_t dir){
+  TCLUSTER c = CLUSTER_OF(box);
+  TNODE first;
+  uint8_t at, end, e;
+
+  switch(dir){
+    case 0:
+      first = (((c - CL_HEIGHT) * 2) + 1) * CL_RUNS; at = (box % MAP_HEIGHT) % CL_SIZE; end = 1; break;
+    case 1:
+      first = (c * 2) * CL_RUNS;                     at = (box / MAP_HEIGHT) % CL_SIZE; end = 0; break;
+    case 2:
+      first = ((c * 2) + 1) * CL_RUNS;               at = (box % MAP_HEIGHT) % CL_SIZE; end = 0; break;
+    default:
+      first = ((c - 1) * 2) * CL_RUNS;               at = (box / MAP_HEIGHT) % CL_SIZE; end = 1; break;
+  }
+
+  for(e = 0; e < CL_RUNS; e++){
+    if(entranceAt[first + e] == at)
+      return ((first + e) * 2) + end;
+  }
+
+  return NODE_NONE;
+}
+
+/*! @brief Lowers the distance to the way-point from an entrance end, if a shorter way
+ *         was found, and moves it up the heap.
+ *
+ *  @param node - The entrance end
+ *  @param cost - Boxes to the way-point through the newly settled node
+ */
+static void reachNode(TNODE node, TPATH_DIST cost){
+  TNODE i;
+
+  if(heapPos[node] == NODE_DONE)
+    return;
+
+  if(heapPos[node] == NODE_NONE){
+    heapPos[node] = heapLen++;
+  } else if(cost >= nodeCost[node]){
+    return;
+  }
+
+  nodeCost[node] = cost;
+  for(i = heapPos[node]; i > 0 && nodeCost[heap[(i - 1) / 2]] > cost; i = (i - 1) / 2){
+    heap[i] = heap[(i - 1) / 2]; //Move the parent down a place
+    heapPos[heap[i]] = i;
+  }
+
+  heap[i] = node;
+  heapPos[node] = i;
+}
+
+/*! @brief Takes the entrance end nearest the way-point off the heap, and reaches out
+ *         from it to the rest of its cluster and across its entrance.
+ *
+ *  @return node - The entrance end, its distance in nodeCost is now final
+ */
+static TNODE settleNode(void){
+  TNODE node = heap[0], last = heap[--heapLen], other, i = 0, child;
+  TCLUSTER c;
+  TCL_DIST dist;
+  uint8_t from, f, j;
+
+  heapPos[node] = NODE_DONE;
+#ifdef PATH_STATS
+  cacheStats.flowed++;
+#endif
+
+  //Move the last node down from the top of the heap, to where it belongs
+  if(heapLen)
+  {
+    while((child = (i * 2) + 1) < heapLen)
+    {
+      if((child + 1) < heapLen && nodeCost[heap[child + 1]] < nodeCost[heap[child]])
+        child++;
+      if(nodeCost[heap[child]] >= nodeCost[last])
+        break;
+
+      heap[i] = heap[child];
+      heapPos[heap[i]] = i;
+      i = child;
+    }
+
+    heap[i] = last;
+    heapPos[last] = i;
+  }
+
+  reachNode(node ^ 1, nodeCost[node] + 1); //The other end of the entrance
+
+  c = nodeCluster(node);
+  from = nodeSlot(node);
+  for(f = 0; f < slotsLen[c] && slotsUsed[c][f] != from; f++); //Its place among the cluster's entrances
+  for(j = 0; j < slotsLen[c]; j++)
+  {
+    if(j == f)
+      continue;
+
+    other = slotNode(c, slotsUsed[c][j]);
+    dist = (j < f) ? INTRA(c, j, f) : INTRA(c, f, j);
+    if(dist != CL_DIST_NONE)
+      reachNode(other, nodeCost[node] + dist);
+  }
+
+  return node;
+}
+#endif
\ No newline at end of file
@@ -17,6 +17,144 @@ extern "C" {
 
 #include "types.h"
 
+#ifdef PATH_MAZE_FILE
+#include PATH_MAZE_FILE /* A different course, e.g. build with -DPATH_MAZE_FILE=\"BIGMAZE.h\" */
+#else
+#include "MAZE.h"
+#endif
+
+#define PATH_MAP_CELLS (MAZE_WIDTH * MAZE_HEIGHT)
+
+/* Define PATH_BITBOARD to flood the maze with the bit-parallel planner, which grows a whole
+ * row of the wave-front per step instead of one box at a time. Suits open mazes.
+ *
+ * Each row of boxes is held in the smallest integer that fits it. Rows above 32 boxes
+ * (MAZE_HEIGHT) use 64-bit integers, as many as the row needs, which is slow on an 8-bit
+ * part. Use the default planner there.
+ */
+//#define PATH_BITBOARD
+
+/* Define PATH_TURNS to follow, of all the shortest routes to a way-point, the one that spends
+ * the least time turning. Every change of direction stops the robot and rotates it on the spot,
+ * so this is the quickest of them. Routes are never made longer to save a turn.
+ *
+ * Each box keeps the fewest 90 degree turns from it to the way-point for each way the robot
+ * could face, 2 bytes a box (up to 253 turns are told apart). The times below weigh a 90 and a
+ * 180 degree turn against each other where the robot starts, in units of 10ms. The path table
+ * only holds one way out of each box, so it isn't used.
+ */
+//#define PATH_TURNS
+#ifdef PATH_TURNS
+#ifndef PATH_NO_HOPS
+#define PATH_NO_HOPS
+#endif
+#endif
+#ifndef PATH_TIME_TURN90
+#define PATH_TIME_TURN90   100 /* Stop and rotate 90 degrees */
+#endif
+#ifndef PATH_TIME_TURN180
+#define PATH_TIME_TURN180  200 /* Stop and rotate 180 degrees */
+#endif
+
+/* While the map only has the physical walls it was built with, paths are looked up from the
+ * table tools/mazegen.py generates from the maze (MAZEHOPS.h) rather than flooded. After the
+ * first virtual wall is found the map is flooded as normal. A table generated with
+ * --waypoints-only only holds paths to the way-points, and paths to any other box are flooded.
+ * Define PATH_NO_HOPS to always flood, e.g. for a maze too big for even that table to fit in
+ * program memory.
+ */
+//#define PATH_NO_HOPS
+#if defined(PATH_MAZE_FILE) && !defined(PATH_HOPS_FILE)
+#define PATH_NO_HOPS /* A different course needs its own table, e.g. -DPATH_HOPS_FILE=\"BIGHOPS.h\" */
+#endif
+
+/* Define PATH_COMPACT for mazes too big to keep a byte per box in RAM (e.g. 16x16). The walls
+ * are packed two bits per box (each box holds its right and back walls), and the flood only
+ * keeps each box's distance mod 3 in two bits. That is enough to follow the path, as the
+ * neighbour one box closer to the way-point is the only one with the value one lower (mod 3).
+ * There is no flood queue either, the flood is grown a layer at a time by sweeping the map,
+ * which is slower.
+ *
+ * The physical walls are read from the maze definition in program memory. The flood cache,
+ * the precomputed path table and exploring are not available, nor are PATH_BITBOARD or PATH_TURNS.
+ */
+//#define PATH_COMPACT
+#ifdef PATH_COMPACT
+#if defined(PATH_BITBOARD) || defined(PATH_TURNS)
+#error "PATH_COMPACT can not be used with PATH_BITBOARD or PATH_TURNS"
+#endif
+#ifndef PATH_NO_HOPS
+#define PATH_NO_HOPS
+#endif
+#undef PATH_CACHE_SIZE
+#define PATH_CACHE_SIZE 0
+#endif
+
+/* Define PATH_HIERARCHY for large courses made up of many rooms. The map is split into square
+ * clusters of PATH_CLUSTER boxes a side, with an entrance in the middle of each open stretch
+ * of the border between two clusters (a stretch is also ended by a wall along the border).
+ * The shortest paths between the entrances of each cluster are worked out once (and again
+ * for a cluster when a wall is found in it), so a plan only searches the entrances, then the
+ * boxes of each cluster as the robot gets to it.
+ *
+ * Paths can be a little longer than the shortest, as they go through the middle of each
+ * entrance. The flood cache, the precomputed path table and exploring are not available, nor
+ * are PATH_BITBOARD, PATH_TURNS or PATH_COMPACT.
+ *
+ * The paths between entrances are kept in a pool of PATH_INTRA_POOL paths, each cluster only
+ * taking room for the entrances it really has. By default it holds half the entrances each
+ * cluster could have, more than random walls over a quarter of the map need; courses of
+ * rooms need far fewer. A wall found later can add an entrance to two clusters. If the
+ * entrances don't fit, PATH_Init fails (or every plan does, after the wall).
+ */
+//#define PATH_HIERARCHY
+#ifdef PATH_HIERARCHY
+#if defined(PATH_BITBOARD) || defined(PATH_TURNS) || defined(PATH_COMPACT)
+#error "PATH_HIERARCHY can not be used with PATH_BITBOARD, PATH_TURNS or PATH_COMPACT"
+#endif
+#ifndef PATH_CLUSTER
+#define PATH_CLUSTER 16
+#endif
+#ifndef PATH_NO_HOPS
+#define PATH_NO_HOPS
+#endif
+#undef PATH_CACHE_SIZE
+#define PATH_CACHE_SIZE 0
+#endif
+
+/* Finished floods are kept for this many way-points, so planning to one of them again costs
+ * nothing. Each costs one byte per box (two for mazes over 128 boxes). A flood is only thrown
+ * away when a virtual wall is found across one of its paths. Off by default, as the PIC16F877A
+ * has no RAM to spare for it (e.g. build with -DPATH_CACHE_SIZE=2 on a bigger part).
+ */
+#ifndef PATH_CACHE_SIZE
+#define PATH_CACHE_SIZE 0
+#endif
+
+/* Define PATH_STATS to count how well the cache is doing (see PATH_GetStats).
+ */
+//#define PATH_STATS
+
+/* The smallest types that can hold an ordinate and a flood number for the size of the maze.
+ * An ordinate must also be able to count one past the edge of the map, and leave PATH_ORD_NONE
+ * spare. A flood number can be as large as the number of boxes (less one), with -1 meaning no path.
+ */
+#if (MAZE_WIDTH < 255) && (MAZE_HEIGHT < 255)
+typedef uint8_t TPATH_ORD;
+#else
+typedef uint16_t TPATH_ORD;
+#endif
+
+#if (PATH_MAP_CELLS <= 128)
+typedef int8_t TPATH_DIST;
+#elif (PATH_MAP_CELLS <= 32768)
+typedef int16_t TPATH_DIST;
+#else
+typedef int32_t TPATH_DIST;
+#endif
+
+#define PATH_ORD_NONE ((TPATH_ORD) -1) /* An ordinate that can never be inside the maze */
+
 typedef enum {
   BOX_Front,
   BOX_Right,
@@ -31,11 +169,35 @@ typedef enum {
 
 typedef struct
 {
-  uint8_t x;
-  uint8_t y;
+  TPATH_ORD x;
+  TPATH_ORD y;
 } TORDINATE; /*< Specifies an x and y coordinate for a position on the grid */
 
-extern int8_t PATH_Path[5][4];      /*< Specifies the path between the robot and a waypoint */
+typedef enum {
+  TURN_None,  /*< Carry straight on */
+  TURN_Right,
+  TURN_Back,
+  TURN_Left
+} TTURN; /*< Turn the robot has to make, in 90 degree CW steps from the way it faces */
+
+typedef struct
+{
+  uint8_t heading;  /*< Map direction to drive in (0 - Front, 1 - Right, 2 - Back, 3 - Left) */
+  TPATH_ORD boxes;  /*< Number of boxes to drive through in a straight line */
+} TSEGMENT; /*< A straight run of the path, the robot only has to stop at the end of it */
+
+#ifdef PATH_STATS
+typedef struct
+{
+  uint16_t hits;    /*< Floods started by copying a cached flood */
+  uint16_t misses;  /*< Floods started from scratch */
+  uint16_t flowed;  /*< Boxes the water has flowed out of, a measure of the time spent flooding */
+} TPATH_STATS;
+#endif
+
+#if !defined(PATH_COMPACT) && !defined(PATH_HIERARCHY)
+extern TPATH_DIST PATH_Path[MAZE_WIDTH][MAZE_HEIGHT]; /*< Specifies the path between the robot and a waypoint (when flooded, see PATH_GetPathVal) */
+#endif
 
 /*! @brief Sets up the PATH module before first use.
  *
@@ -43,6 +205,44 @@ extern int8_t PATH_Path[5][4];      /*< Specifies the path between the robot and
  */    
 bool PATH_Init(void);
 
+/*! @brief Forgets every wall inside the maze, so that it can be explored rather
+ *         than following the surveyed map.
+ *
+ *  Only the outside walls are kept. Every other side of a box is unexplored until
+ *  PATH_SetWall is called for it, and is taken to be open when planning.
+ *
+ *  @return TRUE - If the maze can be explored (it can't with PATH_COMPACT or PATH_HIERARCHY)
+ */
+bool PATH_ExploreStart(void);
+
+/*! @brief Records what was found on one side of a box when it was explored.
+ *
+ *  @param ord - The box explored
+ *  @param dir - The map direction of the side (0 - Front, 1 - Right, 2 - Back, 3 - Left)
+ *  @param wall - TRUE if there is a wall on that side
+ */
+void PATH_SetWall(TORDINATE ord, uint8_t dir, bool wall);
+
+/*! @brief Checks if one side of a box has been explored.
+ *
+ *  @param ord - The box
+ *  @param dir - The map direction of the side (0 - Front, 1 - Right, 2 - Back, 3 - Left)
+ *
+ *  @return TRUE - If it is known whether there is a wall on that side
+ */
+bool PATH_IsWallKnown(TORDINATE ord, uint8_t dir);
+
+/*! @brief Picks the next box to explore from: the nearest box with sides not yet
+ *         explored, and of those the one with the most.
+ *
+ *  @param robotOrd - The current coordinates of the robot
+ *  @param goal - Set to the box to explore from
+ *
+ *  @return TRUE - If there is anything left to explore that the robot can reach
+ *  @note This uses (and replaces) the flood in PATH_Path.
+ */
+bool PATH_NextFrontier(TORDINATE robotOrd, TORDINATE * goal);
+
 /*! @brief Returns the information about a box within the maze.
  *
  *  @param boxOrd - The coordinates of the box to obtain information about
@@ -67,7 +267,9 @@ void PATH_UpdateOrient(uint8_t num90Turns, TDIRECTION dir);
 /*! @brief Calculates a path between the robot and a way-point within the maze.
  *
  *  This function MUST be called every time the layout of the maze changes (e.g.
- *  a virtual wall is detected).
+ *  a virtual wall is detected). If the way-point is the same as the last call, the
+ *  previous flood (repaired for any new walls) is carried on rather than restarted.
+ *  Otherwise a cached flood from the way-point is used if there is one.
  *
  *  @param robotOrd - The current coordinates of the robot
  *  @param waypOrd  - The coordinates of the way-point to get too.
@@ -76,12 +278,83 @@ void PATH_UpdateOrient(uint8_t num90Turns, TDIRECTION dir);
  */
 bool PATH_Plan(TORDINATE robotOrd, TORDINATE waypOrd);
 
+/*! @brief Returns the flood number of a box for the last planned path.
+ *
+ *  While the map has no virtual walls this is looked up from the precomputed table,
+ *  otherwise it is read from PATH_Path. With PATH_COMPACT the path is followed from
+ *  the box to count its length, and with PATH_HIERARCHY it is read from the box's cluster.
+ *
+ *  @param ord - The box to get the flood number of
+ *
+ *  @return distance - Number of boxes to the way-point, or -1 if there is no path.
+ */
+TPATH_DIST PATH_GetPathVal(TORDINATE ord);
+
+/*! @brief Returns the number of boxes on the shortest path between two boxes.
+ *
+ *  @param fromOrd - The box to start from
+ *  @param toOrd - The box to get too
+ *
+ *  @return distance - Number of boxes moved through, or -1 if there is no path.
+ *  @note If the map has virtual walls this uses (and replaces) the flood in PATH_Path.
+ */
+TPATH_DIST PATH_Distance(TORDINATE fromOrd, TORDINATE toOrd);
+
+/*! @brief Returns a number that changes every time a wall is added to the map.
+ *
+ *  @return version - Compare against an earlier version to check if paths may have changed.
+ */
+uint8_t PATH_GetMapVersion(void);
+
+/*! @brief Breaks the path of the last plan into straight runs, starting from a box.
+ *
+ *  Where the path could go more than one way, it carries on in the same direction, so
+ *  the runs are as long as they can be.
+ *
+ *  @param robotOrd - The box the robot is in (facing the current map orientation)
+ *  @param segs - Filled in with the runs, in the order they are driven
+ *  @param maxSegs - Number of runs that segs can hold
+ *
+ *  @return num - Number of runs filled in. 0 if the box is the way-point, or there is no path.
+ *  @note Assumes PATH_Plan has been called since the robot last found a virtual wall.
+ */
+uint8_t PATH_GetSegments(TORDINATE robotOrd, TSEGMENT * segs, uint8_t maxSegs);
+
+#ifdef PATH_STATS
+/*! @brief Gets the flood cache counters since PATH_Init.
+ *
+ *  @param stats - Filled in with the counters
+ */
+void PATH_GetStats(TPATH_STATS * stats);
+#endif
+
+/*! @brief Finds the next move along the path of the last plan.
+ *
+ *  Carrying straight on is preferred whenever it is as good as turning.
+ *
+ *  @param ord - The box the robot is in
+ *  @param heading - The map direction the robot faces (see PATH_GetHeading)
+ *  @param turn - Set to the turn to make before moving
+ *  @param next - Set to the box to move into
+ *
+ *  @return TRUE - If there is a move, FALSE if the box is the way-point or there is no path.
+ *  @note Assumes PATH_Plan has been called since the robot last found a virtual wall.
+ */
+bool PATH_NextMove(TORDINATE ord, uint8_t heading, TTURN * turn, TORDINATE * next);
+
+/*! @brief Returns the map direction the robot faces.
+ *
+ *  @return heading - 0 - Front, 1 - Right, 2 - Back, 3 - Left
+ */
+uint8_t PATH_GetHeading(void);
+
 /*! @brief Used to indicate that a virtual wall was found in the maze space. Will
  *         update Map accordingly.
  *
  *  @param ord - The coordinate where the virtual wall was found.
  *  @note This function assumes the virtual wall was found in front of the robot
- *  in the maze.
+ *  in the maze. Only the part of the current path that ran through the wall is
+ *  invalidated, PATH_Plan must then be called to re-flood it.
  */
 void PATH_VirtWallFoundAt(TORDINATE ord);
 
@@ -0,0 +1,110 @@
+/*! @file POSE.c
+ *
+ *  @brief Odometry of the robot within the maze.
+ *
+ *  This module adds up the distance and angle the iRobot reports into the robot's
+ *  position (mm) and heading within the maze, in fixed point. Map direction 0 (Front)
+ *  runs down the x axis and direction 1 (Right) up the y axis, as PATH steps through
+ *  the boxes.
+ *
+ *  @author A.Pope
+ *  @date 22-09-2016
+ */
+#include "POSE.h"
+
+#define TRIG_BITS 14 //Fractional bits of the sine table, 1.0 is 16384
+#define BOX_FIXED ((int32_t) POSE_BOX_LENGTH << POSE_FRAC_BITS) //A box length as a position
+
+/* sin(deg) << TRIG_BITS, for each whole degree of the first quadrant */
+static const int16_t SinTable[91] = {
+      0,   286,   572,   857,  1143,  1428,  1713,  1997,  2280,  2563,  2845,  3126,
+   3406,  3686,  3964,  4240,  4516,  4790,  5063,  5334,  5604,  5872,  6138,  6402,
+   6664,  6924,  7182,  7438,  7692,  7943,  8192,  8438,  8682,  8923,  9162,  9397,
+   9630,  9860, 10087, 10311, 10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982,
+  12176, 12365, 12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+  14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296, 15396, 15491,
+  15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083, 16135, 16182, 16225, 16262,
+  16294, 16322, 16344, 16362, 16374, 16382, 16384
+};
+
+static TPOSE robot; /*< Where the robot is */
+
+/* Private function prototypes */
+static int16_t wrapAngle(int16_t deg);
+static int16_t sinDeg(int16_t deg);
+/* End Private function prototypes */
+
+bool POSE_Init(void){
+  TORDINATE ord = {0, 0};
+
+  POSE_Set(ord, 0);
+  return true;
+}
+
+void POSE_Set(TORDINATE ord, uint8_t heading){
+  robot.x = (int32_t) ord.x * BOX_FIXED;
+  robot.y = (int32_t) ord.y * BOX_FIXED;
+  robot.heading = (int16_t) heading * 90;
+}
+
+void POSE_Update(int16_t dist, int16_t angle){
+  int16_t mid;
+
+  if(dist){
+    //Drive along the heading half-way through the turn (the Create's angle is CCW, the map's CW)
+    mid = wrapAngle(robot.heading - (angle / 2));
+
+    //Front is down the x axis, Right up the y axis
+    robot.x -= ((int32_t) dist * sinDeg(mid + 90)) >> (TRIG_BITS - POSE_FRAC_BITS);
+    robot.y += ((int32_t) dist * sinDeg(mid)) >> (TRIG_BITS - POSE_FRAC_BITS);
+  }
+
+  robot.heading = wrapAngle(robot.heading - angle);
+}
+
+void POSE_Get(TPOSE * pose){
+  *pose = robot;
+}
+
+bool POSE_GetCell(TORDINATE * ord){
+  int32_t x = robot.x + (BOX_FIXED / 2); //The box edges are half a box from its centre
+  int32_t y = robot.y + (BOX_FIXED / 2);
+
+  if(x < 0 || y < 0 || x >= (BOX_FIXED * MAZE_WIDTH) || y >= (BOX_FIXED * MAZE_HEIGHT))
+    return false; //Outside the maze
+
+  ord->x = (TPATH_ORD) (x / BOX_FIXED);
+  ord->y = (TPATH_ORD) (y / BOX_FIXED);
+  return true;
+}
+
+/*! @brief Brings an angle into the circle.
+ *
+ *  @param deg - Angle (deg)
+ *  @return deg - The same angle, 0 - 359
+ */
+static int16_t wrapAngle(int16_t deg){
+  deg %= 360;
+  if(deg < 0)
+    deg += 360;
+
+  return deg;
+}
+
+/*! @brief Looks up the sine of an angle.
+ *
+ *  @param deg - Angle (deg), 0 - 449
+ *  @return sin - sin(deg) << TRIG_BITS
+ */
+static int16_t sinDeg(int16_t deg){
+  if(deg >= 360)
+    deg -= 360;
+
+  if(deg <= 90)
+    return SinTable[deg];
+  if(deg <= 180)
+    return SinTable[180 - deg];
+  if(deg <= 270)
+    return -SinTable[deg - 180];
+  return -SinTable[360 - deg];
+}
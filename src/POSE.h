@@ -0,0 +1,73 @@
+/*! @file POSE.h
+ *
+ *  @brief Odometry of the robot within the maze.
+ *
+ *  This module adds up the distance and angle the iRobot reports into the robot's
+ *  position (mm) and heading within the maze, so the box it is in can be worked out
+ *  at any time, not just once a move has finished.
+ *
+ *  @author A.Pope
+ *  @date 22-09-2016
+ */
+#ifndef POSE_H
+#define	POSE_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "types.h"
+#include "PATH.h"
+
+#define POSE_BOX_LENGTH 1000 /* Distance between the centres of two boxes (mm) */
+#define POSE_FRAC_BITS  8    /* Fractional bits of a position, so mm are counted in 1/256ths */
+
+typedef struct
+{
+  int32_t x;        /*!< Along the map's x axis from the centre of box (0, 0), mm << POSE_FRAC_BITS */
+  int32_t y;        /*!< Along the map's y axis from the centre of box (0, 0), mm << POSE_FRAC_BITS */
+  int16_t heading;  /*!< Degrees CW from the map's Front (0 - 359), the way the robot faces */
+} TPOSE; /*!< Where the robot is, and the way it faces */
+
+/*! @brief Sets up the pose module before first use.
+ *
+ *  @return bool - TRUE if the pose module was successfully initialized.
+ */
+bool POSE_Init(void);
+
+/*! @brief Places the robot in the centre of a box, facing along the map.
+ *
+ *  @param ord - The box the robot is in
+ *  @param heading - Map direction the robot faces (0 - Front, 1 - Right, 2 - Back, 3 - Left)
+ *  @note Also used to correct the drift of the odometry, whenever the robot is known to be
+ *        lined up in a box.
+ */
+void POSE_Set(TORDINATE ord, uint8_t heading);
+
+/*! @brief Moves the robot on by the distance and angle it reported.
+ *
+ *  @param dist - Distance (mm) driven, forwards positive
+ *  @param angle - Angle (deg) turned, CCW positive
+ *  @note The robot is taken to have driven the whole distance half-way through the turn, so
+ *        this should be called often while it is moving.
+ */
+void POSE_Update(int16_t dist, int16_t angle);
+
+/*! @brief Gets where the robot is.
+ *
+ *  @param pose - Filled with the robot's position and heading
+ */
+void POSE_Get(TPOSE * pose);
+
+/*! @brief Gets the box the robot is in, that is the box whose centre is closest.
+ *
+ *  @param ord - Set to the box the robot is in
+ *  @return bool - TRUE if the robot is inside the maze
+ */
+bool POSE_GetCell(TORDINATE * ord);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* POSE_H */
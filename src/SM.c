@@ -2,7 +2,9 @@
  *
  *  @brief Stepper Motor routines.
  *
- *  This contains the functions for operating the Stepper Motor.
+ *  This contains the functions for operating the Stepper Motor. Moves are queued
+ *  and stepped out in the background by Timer2, speeding up and slowing down
+ *  along a ramp. Orientations and moves are counted in half-steps.
  *
  *  @author Andrew.P 
  *  @date 02-08-2016
@@ -16,10 +18,67 @@
 #define H_STEP_MASK  0b00000100 //Half-step
 #define F_STEP_MASK  0b00000000 //Full-step
 
-const uint8_t SM_F_STEPS_FOR_180 = 100;  //100 Full steps for 180 deg movement
-const double SM_F_STEP_RESOLUTION = 1.8; //1.8 degrees per full step
+/* Timer2 counts at Fosc/4 with 1:16 pre- and post-scalers, so every count of PR2 is 51.2us */
+#define SM_T2CON      0b01111010 //Post-scaler 1:16, pre-scaler 1:16, timer off
+#define SM_RAMP_STEPS 54         //Half-steps it takes to reach top speed
+#define SM_QUEUE_SIZE 4          //Moves that can be waiting to start
+#define SM_SPI_WAIT   0          //PR2 for the tick after a control byte, plenty for the SPI to shift it out
+#define SM_WAIT_US    100        //Time between checks while waiting on Timer2
+
+const uint8_t SM_STEPS_FOR_180 = 200;   //200 Half steps for 180 deg movement
+
+/* Timer2 counts to wait after each half-step of a move, from standing still to top speed.
+ * The first is as slow as the start-up torque requires (3.5ms a half-step, 7ms a full-step),
+ * then the SM speeds up at a constant 10000 deg/s^2 to 1030 deg/s: for the n'th half-step,
+ * speed = sqrt(257^2 + (2 * 10000 * 0.9n)) deg/s. A move slows down through the same
+ * table backwards, and full-steps take every second entry, waiting twice as long.
+ * Only the start-up speed has been measured on the SM; test_sm checks the table against
+ * this profile, so shorten the table if the SM is found to skip steps nearer the top.
+ */
+static const uint8_t SmRamp[SM_RAMP_STEPS] = {
+  68, 61, 55, 51, 47, 44, 42, 40, 38, 37, 35, 34, 33, 32, 31, 30, 30, 29,
+  28, 28, 27, 26, 26, 25, 25, 24, 24, 24, 23, 23, 23, 22, 22, 22, 21, 21,
+  21, 21, 20, 20, 20, 20, 19, 19, 19, 19, 19, 18, 18, 18, 18, 18, 18, 17
+};
+
+typedef struct
+{
+  uint16_t steps;  /* Half-steps to move */
+  uint8_t stepSize; /* Half-steps per pulse, 1 for half-steps and 2 for full-steps */
+  TDIRECTION dir;
+} TSM_MOVE; /* A move waiting to be stepped out */
+
+static volatile TSM_MOVE queue[SM_QUEUE_SIZE]; /*< Moves waiting to start, oldest first */
+static volatile uint8_t queueHead;             /*< Oldest move in the queue */
+static volatile uint8_t queueLen;              /*< Moves in the queue */
+static volatile bool running;                  /*< TRUE while Timer2 is stepping out moves */
+static uint16_t stepsLeft;                     /*< Half-steps left in the move being stepped out */
+static uint16_t stepsDone;                     /*< Half-steps done in the move being stepped out */
+static uint8_t stepSize;                       /*< Half-steps per pulse in the move being stepped out, 0 once the SM is disabled */
+static bool halfStep;                          /*< TRUE to always move in half-steps */
+static uint16_t orientation;                   /*< Orientation (half-steps) once every queued move is done */
+
+/* Private function prototypes */
+static uint16_t calcOrientation(int a);
+static void queueMove(uint16_t steps, TDIRECTION dir);
+/* End Private function prototypes */
 
 bool SM_Init(void) {
+  //We assume the position of the stepper motor at startup is position 0 (step 0)
+  orientation = 0;
+  queueHead = 0;
+  queueLen = 0;
+  running = false;
+  stepsLeft = 0;
+  stepSize = 0;
+  halfStep = false;
+
+  //Timer2 times the steps, and only runs while there is something to step out
+  T2CON = SM_T2CON;
+  PIR1bits.TMR2IF = 0;
+  PIE1bits.TMR2IE = 1;
+  INTCONbits.PEIE = 1;
+  
   return SPI_Init(); //Return initialization of the SPI module
 }
 
@@ -30,7 +89,7 @@ bool SM_Init(void) {
  */
 static uint16_t calcOrientation(int a)
 {
-  int b = (SM_F_STEPS_FOR_180 * 2); //Get the amount of steps for 360 degs
+  int b = (SM_STEPS_FOR_180 * 2); //Get the amount of steps for 360 degs
 
   int step = a % b;
   if (step < 0){
@@ -40,33 +99,118 @@ static uint16_t calcOrientation(int a)
   return step;
 }
 
-uint16_t SM_Move(uint16_t steps, TDIRECTION dir) {
-  //We assume the position of the stepper motor at startup is position 0 (step 0)
-  static uint16_t orientation = 0; 
-  uint8_t controlByte = 0;
+/*! @brief Adds a move to the queue for Timer2 to step out, waiting for room if the
+ *         queue is full.
+ *
+ *  @param steps - Number of half-steps to move
+ *  @param dir - The direction to move in (CW || CCW)
+ */
+static void queueMove(uint16_t steps, TDIRECTION dir) {
+  volatile TSM_MOVE * move;
+
+  if (steps == 0)
+    return;
+
+  while (queueLen == SM_QUEUE_SIZE)
+    __delay_us(SM_WAIT_US); //Wait for the oldest move to start
 
-  //Select the stepper motor module via SPI
-  SPI_SelectMode(SPI_SM);
+  PIE1bits.TMR2IE = 0; //Don't let Timer2 take a move while it is being added
+  move = &queue[(queueHead + queueLen) % SM_QUEUE_SIZE];
+  move->steps = steps;
+  move->stepSize = (halfStep || (steps % 2)) ? 1 : 2; //An odd number of half-steps can't be full-stepped
+  move->dir = dir;
+  queueLen++;
 
-  //Enable and Construct the control byte for the SPI module and send
-  controlByte = (ENABLE_MASK | CLK_PIC_MASK | F_STEP_MASK | dir);
-  SPI_SendData(controlByte);
+  if (!running) {
+    running = true;
+    PR2 = 0;                 //Start the move on the next count
+    TMR2 = 0;
+    T2CONbits.TMR2ON = 1;
+  }
+  PIE1bits.TMR2IE = 1;
 
   //Update the step orientation
   if (dir == DIR_CW) {
-    orientation = calcOrientation((orientation += steps)); //Increment orientation for CW rotation
+    orientation = calcOrientation((int) orientation + steps); //Increment orientation for CW rotation
   } else {
-    orientation = calcOrientation((orientation -= steps));
+    orientation = calcOrientation((int) orientation - steps);
   }
-  
-  for (; steps != 0; --steps){
-    //Pulse the Stepper motor the desired amount of steps
-    RC2 = 1; NOP(); RC2 = 0;
-    __delay_ms(7);
+}
+
+void SM_Tick(void) {
+  uint16_t ramp;
+
+  if (stepsLeft == 0) {
+    if (queueLen == 0) {
+      if (stepSize != 0) {
+        SPI_LoadData(0);        //Disable the SM module
+        stepSize = 0;
+        PR2 = SM_SPI_WAIT;      //Deselect it once the byte has been shifted out
+        return;
+      }
+      SPI_SelectMode(SPI_NONE); //Set SPI to reference no module
+      T2CONbits.TMR2ON = 0;     //Nothing left to step out
+      running = false;
+      return;
+    }
+
+    //Start the next move: select the stepper motor module via SPI, then enable and
+    //construct the control byte for the SPI module and send. The ISR doesn't wait
+    //for the SPI, the first pulse comes on the next tick instead.
+    stepsLeft = queue[queueHead].steps;
+    stepSize = queue[queueHead].stepSize;
+    SPI_SelectMode(SPI_SM);
+    SPI_LoadData(ENABLE_MASK | CLK_PIC_MASK | ((stepSize == 1) ? H_STEP_MASK : F_STEP_MASK) | queue[queueHead].dir);
+    queueHead = (queueHead + 1) % SM_QUEUE_SIZE;
+    queueLen--;
+    stepsDone = 0;
+    PR2 = SM_SPI_WAIT;
+    return;
   }
-  
-  SPI_SendData(0);          //Disable the SM module
-  SPI_SelectMode(SPI_NONE); //Set SPI to reference no module
+
+  //Pulse the Stepper motor once
+  RC2 = 1; NOP(); RC2 = 0;
+  stepsLeft -= stepSize;
+
+  //Speed up from the start of the move and slow down towards its end, so wait for
+  //whichever is closer, counting to the end from the next pulse so the slowing down
+  //mirrors the speeding up (the last pulse waits the longest, for the SM to settle)
+  ramp = (stepsLeft == 0) ? 0 : (stepsLeft - stepSize);
+  if (stepsDone < ramp)
+    ramp = stepsDone;
+  if (ramp >= SM_RAMP_STEPS)
+    ramp = SM_RAMP_STEPS - 1;
+  PR2 = (SmRamp[ramp] * stepSize) - 1;
+  stepsDone += stepSize;
+}
+
+void SM_SetHalfStep(bool on) {
+  halfStep = on;
+}
+
+void SM_MoveTo(uint16_t target) {
+  uint16_t delta = calcOrientation((int) target - orientation); //Steps to get there turning CW
+
+  //Turn whichever way is shorter
+  if (delta > SM_STEPS_FOR_180) {
+    queueMove((SM_STEPS_FOR_180 * 2) - delta, DIR_CCW);
+  } else {
+    queueMove(delta, DIR_CW);
+  }
+}
+
+uint16_t SM_GetOrientation(void) {
+  return orientation;
+}
+
+bool SM_IsDone(void) {
+  return !running;
+}
+
+uint16_t SM_Move(uint16_t steps, TDIRECTION dir) {
+  queueMove(steps, dir);
+  while (!SM_IsDone())
+    __delay_us(SM_WAIT_US); //Wait for Timer2 to step the move out
 
   return orientation;
-}
\ No newline at end of file
+}
@@ -2,7 +2,9 @@
  *
  *  @brief Stepper Motor routines.
  *
- *  This contains the functions for operating the Stepper Motor.
+ *  This contains the functions for operating the Stepper Motor. Moves are queued
+ *  and stepped out in the background by Timer2. Orientations and moves are counted
+ *  in half-steps.
  *
  *  @author Andrew. P
  *  @date 02-08-2016
@@ -16,8 +18,7 @@ extern "C" {
 
 #include "types.h"
     
-extern const uint8_t SM_F_STEPS_FOR_180;    /* Half Steps required to move stepper motor 180 degs */
-extern const double SM_F_STEP_RESOLUTION;   /* Resolution per half-step (degs) */
+extern const uint8_t SM_STEPS_FOR_180;      /* Half Steps required to move stepper motor 180 degs */
     
 /*! @brief Sets up the stepper motor before first use
  *
@@ -25,16 +26,55 @@ extern const double SM_F_STEP_RESOLUTION;   /* Resolution per half-step (degs) *
  */
 bool SM_Init(void);
 
-/*! @brief Rotates the stepper motor in the desired amount of steps in certain direction.
+/*! @brief Rotates the stepper motor in the desired amount of steps in certain direction,
+ *         returning once it is there.
  *
  *  @param steps - Number of half-steps to move
  *  @param dir - The direction to move in (CW || CCW)
  *  @return orientation - returns the orientation step (within the 360 deg circle) that SM is at
  * 
- *  @note Assumes that SM_Init has been called.
+ *  @note Assumes that SM_Init has been called, and that interrupts are enabled.
  */
 uint16_t SM_Move(uint16_t steps, TDIRECTION dir);
 
+/*! @brief Starts the stepper motor turning to an orientation, whichever way is shorter,
+ *         and returns straight away.
+ *
+ *  @param target - The orientation half-step (within the 360 deg circle) to turn to, from
+ *                  wherever the moves already started will leave the SM
+ *  @note Waits if too many moves are already waiting to start. Use SM_IsDone to find
+ *        when the SM is there.
+ */
+void SM_MoveTo(uint16_t target);
+
+/*! @brief Returns the orientation the stepper motor will be at once every move it was
+ *         given is done.
+ *
+ *  @return orientation - The orientation half-step (within the 360 deg circle)
+ */
+uint16_t SM_GetOrientation(void);
+
+/*! @brief Checks whether the stepper motor has finished every move it was given.
+ *
+ *  @return bool - TRUE if the SM is standing still at its last orientation.
+ */
+bool SM_IsDone(void);
+
+/*! @brief Chooses whether moves are stepped out in half-steps or full-steps.
+ *
+ *  @param on - TRUE for half-steps (smoother), FALSE for full-steps (more torque). Moves of
+ *              an odd number of half-steps are always half-stepped.
+ *  @note Applies to moves given from now on.
+ */
+void SM_SetHalfStep(bool on);
+
+/*! @brief Steps out the next step of the moves the stepper motor was given.
+ *
+ *  @note Called from the Timer2 interrupt, which SM times to speed the motor up and
+ *        slow it down.
+ */
+void SM_Tick(void);
+
 #ifdef	__cplusplus
 }
 #endif
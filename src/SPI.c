@@ -55,4 +55,9 @@ uint8_t SPI_SendData(uint8_t txData){
   SSPIF = 0;
 
   return rxData;
+}
+
+void SPI_LoadData(uint8_t txData){
+  SSPIF = 0;          //Clear the SSPIF flag to initiate data transmit
+  SSPBUF = txData;    //Load data to the SSPBUF buffer, the SSP shifts it out by itself
 }
\ No newline at end of file
@@ -43,6 +43,14 @@ void SPI_SelectMode(TSPI_MODE mode);
  */
 uint8_t SPI_SendData(uint8_t txData);
 
+/*!@brief Starts sending data to the currently selected SPI module, without waiting for it
+ *        to be shifted out (8 SPI clocks, 1.6us at Fosc/4).
+ *
+ * @param txData - The data to transmit
+ * @note For use from an ISR. Don't select another module until the byte has gone.
+ */
+void SPI_LoadData(uint8_t txData);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -0,0 +1,262 @@
+/*! @file TOUR.c
+ *
+ *  @brief Ordering of way-points into a tour of the maze.
+ *
+ *  This module decides which order the robot should visit its way-points in,
+ *  so that it reaches them (and any victims near them) as early as possible.
+ *
+ *  @author A.Pope
+ *  @date 22-09-2016
+ */
+#include "TOUR.h"
+
+#define NUM_POINTS (TOUR_MAX_POINTS + 1)        //Way-points plus the box the tour starts from
+#define NUM_PAIRS  ((NUM_POINTS * (NUM_POINTS - 1)) / 2) //Pairs of different points
+#define UNREACHABLE ((TTOUR_DIST) PATH_MAP_CELLS) //Longer than any path through the maze
+#define PAIR(a, b) ((((b) * ((b) - 1)) / 2) + (a)) //Index of the pair of points a < b in dist
+
+//The smallest type that can hold a path length, or UNREACHABLE
+#if (PATH_MAP_CELLS < 255)
+typedef uint8_t TTOUR_DIST;
+#else
+typedef uint16_t TTOUR_DIST;
+#endif
+
+//The smallest type that can hold the total of every way-point's arrival time
+#if ((PATH_MAP_CELLS * NUM_POINTS * NUM_POINTS) < 65535)
+typedef uint16_t TTOUR_COST;
+#else
+typedef uint32_t TTOUR_COST;
+#endif
+
+/* Private function prototypes */
+static void buildDistances(TORDINATE startOrd, TORDINATE * wayList, uint8_t num);
+static TTOUR_DIST pointDist(uint8_t a, uint8_t b);
+static TTOUR_COST tourCost(uint8_t * order, uint8_t num);
+static void orderExact(uint8_t num);
+static void orderHeuristic(uint8_t num);
+/* End private function prototypes */
+
+/* Distances between every pair of different points, paths are the same length either way so
+ * each pair is only kept once (see PAIR). Point 0 is the start, point i is way-point (i - 1).
+ */
+static TTOUR_DIST dist[NUM_PAIRS];
+static uint8_t bestOrder[TOUR_MAX_POINTS]; /*< Best order of way-points found so far */
+
+bool TOUR_Init(void){
+  return true; //No initialization needed for the tour module
+}
+
+void TOUR_Order(TORDINATE startOrd, TORDINATE * wayList, uint8_t num){
+  TORDINATE ordered[TOUR_MAX_POINTS];
+  uint8_t i;
+
+  if(num < 2 || num > TOUR_MAX_POINTS)
+    return; //Nothing to order (or too many to order)
+
+  buildDistances(startOrd, wayList, num);
+
+  //The heuristic's order is good enough for long lists, and a tight bound for the exact search on short ones
+  orderHeuristic(num);
+  if(num <= TOUR_EXACT_MAX)
+    orderExact(num);
+
+  for(i = 0; i < num; i++)
+    ordered[i] = wayList[bestOrder[i]];
+  for(i = 0; i < num; i++)
+    wayList[i] = ordered[i];
+}
+
+/*! @brief Finds the distance between every pair of points in the tour.
+ *
+ *  @param startOrd - The box the tour starts from
+ *  @param wayList - The list of way-points
+ *  @param num - Number of way-points in the list
+ */
+static void buildDistances(TORDINATE startOrd, TORDINATE * wayList, uint8_t num){
+  TORDINATE toOrd, fromOrd;
+  TPATH_DIST boxes;
+  uint8_t i, j;
+
+  /* Paths are the same length either way, so only half the pairs are needed. All of the
+   * distances to one point come from the same flood, which PATH carries on between calls.
+   */
+  for(j = 1; j <= num; j++){
+    toOrd = wayList[j - 1];
+
+    for(i = 0; i < j; i++){
+      fromOrd = (i == 0) ? startOrd : wayList[i - 1];
+      boxes = PATH_Distance(fromOrd, toOrd);
+
+      dist[PAIR(i, j)] = (boxes == -1) ? UNREACHABLE : (TTOUR_DIST) boxes;
+    }
+  }
+}
+
+/*! @brief Looks up the distance between two points of the tour.
+ *
+ *  @param a - A point (0 is the start, i is way-point (i - 1))
+ *  @param b - The other point
+ *  @return dist - Boxes between the points
+ */
+static TTOUR_DIST pointDist(uint8_t a, uint8_t b){
+  if(a == b)
+    return 0;
+
+  return (a < b) ? dist[PAIR(a, b)] : dist[PAIR(b, a)];
+}
+
+/*! @brief Calculates the total time (in boxes) at which each way-point is reached.
+ *
+ *  @param order - The order to visit the way-points in
+ *  @param num - Number of way-points in the order
+ *  @return cost - The sum of every way-point's arrival time
+ */
+static TTOUR_COST tourCost(uint8_t * order, uint8_t num){
+  TTOUR_COST arrival = 0, total = 0;
+  uint8_t i, at = 0;
+
+  for(i = 0; i < num; i++){
+    arrival += pointDist(at, order[i] + 1);
+    total += arrival;
+    at = order[i] + 1;
+  }
+
+  return total;
+}
+
+/*! @brief Finds the best order of way-points with a branch and bound search.
+ *
+ *  @param num - Number of way-points to order
+ *  @note Starts from the order in bestOrder, which must hold every way-point.
+ */
+static void orderExact(uint8_t num){
+  uint8_t order[TOUR_MAX_POINTS];         //Way-points chosen so far, in order
+  uint8_t next[TOUR_MAX_POINTS];          //The next way-point to try at each depth
+  TTOUR_COST arrival[TOUR_MAX_POINTS + 1]; //Arrival time at the last way-point chosen at each depth
+  TTOUR_COST total[TOUR_MAX_POINTS + 1];   //Sum of arrival times of the way-points chosen at each depth
+  TTOUR_COST best, time;
+  uint16_t used = 0;                      //Set bits are way-points already in the order
+  uint8_t depth = 0, i, at;
+
+  //Start from the order already found, so the search has a bound to beat straight away
+  best = tourCost(bestOrder, num);
+
+  arrival[0] = 0; total[0] = 0; next[0] = 0;
+
+  /* Depth first search, without recursion. A partial order is abandoned as soon as it can't
+   * beat the best so far: every way-point left will be reached no earlier than the last one.
+   */
+  for(;;)
+  {
+    if(next[depth] == num){ //Tried every way-point at this depth, go back up
+      if(depth == 0)
+        break;
+      depth--;
+      used &= ~(1 << order[depth]);
+      next[depth]++;
+      continue;
+    }
+
+    i = next[depth];
+    at = (depth == 0) ? 0 : (order[depth - 1] + 1);
+    time = arrival[depth] + pointDist(at, i + 1);
+
+    if((used & (1 << i)) || ((total[depth] + (time * (num - depth))) >= best)){
+      next[depth]++;
+      continue;
+    }
+
+    order[depth] = i;
+    arrival[depth + 1] = time;
+    total[depth + 1] = total[depth] + time;
+
+    if((depth + 1) == num){ //A complete order that is better than the best so far
+      best = total[depth + 1];
+      for(i = 0; i < num; i++)
+        bestOrder[i] = order[i];
+      next[depth]++;
+    } else {
+      used |= (1 << i);
+      depth++;
+      next[depth] = 0;
+    }
+  }
+}
+
+/*! @brief Finds a good order of way-points by starting from the nearest
+ *         neighbour tour and improving it with 2-opt and Or-opt moves.
+ *
+ *  @param num - Number of way-points to order
+ */
+static void orderHeuristic(uint8_t num){
+  uint8_t trial[TOUR_MAX_POINTS];
+  TTOUR_COST best, cost;
+  uint8_t i, j, k, len, at = 0, nearest = 0, tmp;
+  bool improved = true;
+
+  //Nearest neighbour - always go to the closest way-point not yet visited
+  for(i = 0; i < num; i++)
+    trial[i] = i;
+  for(i = 0; i < num; i++){
+    for(j = i; j < num; j++){
+      if(j == i || pointDist(at, trial[j] + 1) < pointDist(at, trial[nearest] + 1))
+        nearest = j;
+    }
+    tmp = trial[i]; trial[i] = trial[nearest]; trial[nearest] = tmp;
+    at = trial[i] + 1;
+  }
+
+  for(i = 0; i < num; i++)
+    bestOrder[i] = trial[i];
+  best = tourCost(bestOrder, num);
+
+  while(improved)
+  {
+    improved = false;
+
+    //2-opt: reverse the way-points between i and j
+    for(i = 0; i < (num - 1); i++){
+      for(j = i + 1; j < num; j++){
+        for(k = 0; k < num; k++)
+          trial[k] = ((k >= i) && (k <= j)) ? bestOrder[i + j - k] : bestOrder[k];
+
+        cost = tourCost(trial, num);
+        if(cost < best){
+          best = cost;
+          for(k = 0; k < num; k++)
+            bestOrder[k] = trial[k];
+          improved = true;
+        }
+      }
+    }
+
+    //Or-opt: move a run of 1 to 3 way-points from i to in front of j
+    for(len = 1; len <= 3; len++){
+      for(i = 0; (i + len) <= num; i++){
+        for(j = 0; j <= (num - len); j++){
+          if(j == i)
+            continue;
+
+          //Take the run out, then put it back in at j
+          for(k = 0, at = 0; k < num; k++){
+            if(k < i || k >= (i + len))
+              trial[at++] = bestOrder[k];
+          }
+          for(k = (num - len); k > j; k--)
+            trial[k + len - 1] = trial[k - 1];
+          for(k = 0; k < len; k++)
+            trial[j + k] = bestOrder[i + k];
+
+          cost = tourCost(trial, num);
+          if(cost < best){
+            best = cost;
+            for(k = 0; k < num; k++)
+              bestOrder[k] = trial[k];
+            improved = true;
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,52 @@
+/*! @file TOUR.h
+ *
+ *  @brief Ordering of way-points into a tour of the maze.
+ *
+ *  This module decides which order the robot should visit its way-points in,
+ *  so that it reaches them (and any victims near them) as early as possible.
+ *
+ *  @author A.Pope
+ *  @date 22-09-2016
+ */
+#ifndef TOUR_H
+#define	TOUR_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "types.h"
+#include "PATH.h"
+
+#ifndef TOUR_MAX_POINTS
+#define TOUR_MAX_POINTS 7 /* Most way-points that can be ordered at once */
+#endif
+#ifndef TOUR_EXACT_MAX
+#define TOUR_EXACT_MAX  7 /* Most way-points ordered by an exact search, more only use the 2-opt/Or-opt heuristic */
+#endif
+
+/*! @brief Sets up the tour module before first use.
+ *
+ *  @return bool - TRUE if the tour module was successfully initialized.
+ */
+bool TOUR_Init(void);
+
+/*! @brief Re-orders a list of way-points into the quickest tour from a box.
+ *
+ *  The tour minimises the average number of boxes moved through before each
+ *  way-point is reached, so a victim at any one of them is expected to be found
+ *  as soon as possible. Way-points that can't be reached are left until last.
+ *
+ *  @param startOrd - The box the tour starts from (where the robot is)
+ *  @param wayList - The list of way-points, re-ordered in place
+ *  @param num - Number of way-points in the list (up to TOUR_MAX_POINTS)
+ *
+ *  @note Uses PATH_Distance, so any flood in PATH_Path is replaced.
+ */
+void TOUR_Order(TORDINATE startOrd, TORDINATE * wayList, uint8_t num);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* TOUR_H */
@@ -3,7 +3,8 @@
  *  @brief Serial Communication via USART.
  *
  *  This contains the functions for serial communication via the Universal
- *  Synchronous Asynchronous Receiver Transmitter.
+ *  Synchronous Asynchronous Receiver Transmitter. Bytes are sent and received
+ *  in the background by the USART interrupts, through a ring buffer each way.
  *
  *  @author Andrew.P 
  *  @date 02-08-2016
@@ -11,6 +12,20 @@
 #include "USART.h"
 #define BAUD_57600 20
 
+/* Ring buffer sizes must be powers of two, the indexes count up and wrap with the mask */
+#define RX_SIZE 16  //Read every 1ms tick, in which at most 6 bytes arrive at 57600 baud
+#define RX_MASK (RX_SIZE - 1)
+#define TX_SIZE 16  //The longest command the robot sends in one go is 8 bytes
+#define TX_MASK (TX_SIZE - 1)
+
+static volatile uint8_t rxBuf[RX_SIZE]; /*< Received bytes waiting to be read */
+static volatile uint8_t rxHead;         /*< Next byte to receive into, only changed by USART_RxTick */
+static volatile uint8_t rxTail;         /*< Next byte to read, only changed by the reader */
+static volatile uint8_t txBuf[TX_SIZE]; /*< Bytes waiting to be transmitted */
+static volatile uint8_t txHead;         /*< Next byte to queue into, only changed by the writer */
+static volatile uint8_t txTail;         /*< Next byte to transmit, only changed by USART_TxTick */
+static volatile TUSART_OVERRUNS lost;   /*< Received bytes lost */
+
 bool USART_Init(void)
 {
   //Setup TRISC Register
@@ -22,9 +37,6 @@ bool USART_Init(void)
   RCSTAbits.SPEN = 1; //Serial port enabled
   RCSTAbits.CREN = 1; //Enable continous receive
   RCSTAbits.SREN = 0; //No effect
-	
-  PIE1bits.TXIE = 0; //Disable Interrupts
-  PIE1bits.RCIE = 0;
   
   TXSTAbits.TX9 = 0; //8 bit transmission
   RCSTAbits.RX9 = 0; //8 bit receive
@@ -34,28 +46,95 @@ bool USART_Init(void)
   TXSTAbits.TXEN = 1; 
   
   SPBRG = BAUD_57600; //Baud rate 57600
+
+  rxHead = 0; rxTail = 0; txHead = 0; txTail = 0;
+  lost.hardware = 0; lost.buffer = 0;
+
+  PIE1bits.TXIE = 0;   //Transmit interrupt is only on while there is something to send
+  PIE1bits.RCIE = 1;   //Receive in the background
+  INTCONbits.PEIE = 1;
   
   return true;
 }
 
-uint8_t USART_InChar(void)
+bool USART_ReadChar(uint8_t * data)
 {
-  uint8_t data;
-  
-  while(!(PIR1bits.RCIF));  //Wait for data to become available
-  data = RCREG;
-  
+  if(rxHead == rxTail)
+    return false; //Nothing received
+
+  *data = rxBuf[rxTail & RX_MASK];
+  rxTail++;
+  return true;
+}
+
+bool USART_InChar(uint8_t * data, uint16_t timeout)
+{
+  uint32_t waits = (uint32_t) timeout * 10; //Waits of 100us in the timeout, too many for 16 bits past 6553ms
+
+  while(!USART_ReadChar(data)){
+    if(!waits)
+      return false;
+    waits--;
+    __delay_us(100);
+  }
+
+  return true;
+}
+
+void USART_OutChar(const uint8_t data)
+{
+  //While buffer is full, wait. With interrupts off nothing empties it, so send the
+  //oldest byte by hand as soon as TXREG is free
+  while((uint8_t)(txHead - txTail) == TX_SIZE){
+    if(!INTCONbits.GIE && PIR1bits.TXIF)
+      USART_TxTick();
+  }
+  txBuf[txHead & TX_MASK] = data;
+  txHead++;
+  PIE1bits.TXIE = 1; //Transmit as soon as TXREG is empty
+}
+
+void USART_Write(const uint8_t * buf, uint8_t len)
+{
+  while(len--)
+    USART_OutChar(*buf++);
+}
+
+void USART_GetOverruns(TUSART_OVERRUNS * overruns)
+{
+  overruns->hardware = lost.hardware;
+  overruns->buffer = lost.buffer;
+}
+
+void USART_RxTick(void)
+{
+  uint8_t data = RCREG;
+
   //If error during transmission, make sure to clear in software
   if(RCSTAbits.OERR){
     CREN = 0;
     CREN = 1;
+    if(lost.hardware != 255)
+      lost.hardware++;
   }
-  
-  return data;
+
+  if((uint8_t)(rxHead - rxTail) == RX_SIZE){
+    if(lost.buffer != 255) //Buffer full, drop the byte
+      lost.buffer++;
+    return;
+  }
+
+  rxBuf[rxHead & RX_MASK] = data;
+  rxHead++;
 }
 
-void USART_OutChar(const uint8_t data)
+void USART_TxTick(void)
 {
-  while(!(TXSTAbits.TRMT)); //While buffer is not empty, wait
-  TXREG=data;               //load register with data to be transmitted
-}
\ No newline at end of file
+  if(txHead == txTail){
+    PIE1bits.TXIE = 0; //Nothing left to send
+    return;
+  }
+
+  TXREG = txBuf[txTail & TX_MASK];
+  txTail++;
+}
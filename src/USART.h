@@ -3,7 +3,8 @@
  *  @brief Serial Communication via USART.
  *
  *  This contains the functions for serial communication via the Universal
- *  Synchronous Asynchronous Receiver Transmitter.
+ *  Synchronous Asynchronous Receiver Transmitter. Bytes are sent and received
+ *  in the background by the USART interrupts, through a ring buffer each way.
  *
  *  @author Andrew.P 
  *  @date 02-08-2016
@@ -17,26 +18,69 @@ extern "C" {
 
 #include "types.h"
 
+typedef struct {
+  uint8_t hardware; /*!< Times bytes were lost because RCREG wasn't read in time */
+  uint8_t buffer;   /*!< Bytes lost because the receive buffer was full */
+} TUSART_OVERRUNS;  /*!< Received bytes lost, each count stops at 255 */
+
 /*! @brief Sets up the USART interface before first use.
  *
  *  @return BOOL - true if the USART was successfully initialized.
  */
 bool USART_Init(void);
  
-/*! @brief Get a character from the RCREG.
+/*! @brief Takes the next received byte, if there is one, without waiting.
+ *
+ *  @param data - Set to the byte received
+ *  @return bool - TRUE if a byte was waiting
+ */
+bool USART_ReadChar(uint8_t * data);
+
+/*! @brief Waits for the next received byte, giving up after a time.
  *
- *  @return data - Byte from the RCREG
+ *  @param data - Set to the byte received
+ *  @param timeout - The least time to wait (ms)
+ *  @return bool - TRUE if a byte was received in time
  */
-uint8_t USART_InChar(void);
+bool USART_InChar(uint8_t * data, uint16_t timeout);
  
-/*! @brief Attempt to transmit a character through TXREG.
+/*! @brief Queues a character to be transmitted through TXREG.
  *
  *  @param data The byte to be transmitted.
+ *  @note Only waits while the transmit buffer is full. With interrupts disabled, bytes
+ *        are moved from the buffer into TXREG by hand to make room.
  */
 void USART_OutChar(const uint8_t data);
 
+/*! @brief Queues a number of bytes to be transmitted, in order.
+ *
+ *  @param buf - The bytes to be transmitted
+ *  @param len - Number of bytes in buf
+ *  @note Only waits while the transmit buffer is full, as USART_OutChar does.
+ */
+void USART_Write(const uint8_t * buf, uint8_t len);
+
+/*! @brief Gets how many received bytes have been lost since USART_Init.
+ *
+ *  @param overruns - Filled with the counts
+ */
+void USART_GetOverruns(TUSART_OVERRUNS * overruns);
+
+/*! @brief Moves the byte in RCREG into the receive buffer.
+ *
+ *  @note Called from the USART receive interrupt.
+ */
+void USART_RxTick(void);
+
+/*! @brief Moves the next byte of the transmit buffer into TXREG, turning the transmit
+ *         interrupt off once the buffer is empty.
+ *
+ *  @note Called from the USART transmit interrupt.
+ */
+void USART_TxTick(void);
+
 #ifdef	__cplusplus
 }
 #endif
 
-#endif	/* USART_H */
\ No newline at end of file
+#endif	/* USART_H */
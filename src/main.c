@@ -13,6 +13,10 @@
 #include "LED.h"
 #include "LCD.h"
 #include "BNT.h"
+#include "ADC.h"
+#include "SM.h"
+#include "USART.h"
+#include "MOVE.h"
 #include "IROBOT.h"
 #include "types.h"
 
@@ -27,6 +31,7 @@
  */
 button_t buttonList[] = {
   {false, false, BNT_DEB_COUNT, 0},
+  {false, false, BNT_DEB_COUNT, 0},
 };
 
 /*! @brief Interrupt Service Routine for the PIC
@@ -42,10 +47,14 @@ void interrupt isr(void) {
     TMR0 = TMR0_VAL;     // Reset timer 0
     debCnt++; hbCnt++;
 
+    ADC_Sample();   //Keep the IR readings up to date in the background
+    MOVE_StreamRx(); //Parse the sensor frames received in the last 1ms
+
     //Check to flash 'heartbeat' LED
     if (!(hbCnt % HEARTBEAT_DELAY)) {
       hbCnt = 0;
       LED_0 = !LED_0;
+      LED_1 = MOVE_StreamLost(); //Lit for a heartbeat after sensor stream bytes were lost
     }
 
     //Check if button require debouncing
@@ -57,8 +66,27 @@ void interrupt isr(void) {
       } else {
         BNT_ResetDebounce(&buttonList[0]); //If released, reset the debounce count
       }
+
+      if (BNT_PB2) { //Button 2
+        BNT_Debounce(&buttonList[1]);
+      } else {
+        BNT_ResetDebounce(&buttonList[1]);
+      }
     }
   }
+
+  if (PIR1bits.TMR2IF && PIE1bits.TMR2IE) {
+    PIR1bits.TMR2IF = 0; // Clear Flag for Timer2 Interrupt
+    SM_Tick();           // Step the IR stepper motor in the background
+  }
+
+  if (PIR1bits.RCIF && PIE1bits.RCIE) {
+    USART_RxTick(); // Reading the byte clears the flag
+  }
+
+  if (PIR1bits.TXIF && PIE1bits.TXIE) {
+    USART_TxTick(); // Writing the next byte clears the flag
+  }
 }
 
 /*! @brief Initializes Timer0 appropriately.
@@ -117,6 +145,11 @@ void main(void) {
         buttonList[0].bntPressed = false;
         IROBOT_MazeRun(); //The robot will initiate the maze-run routine
       }
+      else if(buttonList[1].bntPressed)
+      {
+        buttonList[1].bntPressed = false;
+        IROBOT_Explore(); //The robot will explore a maze it has not been shown
+      }
     }
   }
 
@@ -0,0 +1,22 @@
+/*! @file bench_maze.h
+ *
+ *  @brief A square course BENCH_SIZE boxes a side, for bench_path.
+ *
+ *  The course is built without walls; bench_path puts them in at run time.
+ *
+ *  @author A.Pope
+ *  @date 17-10-2016
+ */
+#ifndef BENCH_MAZE_H
+#define	BENCH_MAZE_H
+
+#define MAZE_WIDTH  BENCH_SIZE
+#define MAZE_HEIGHT BENCH_SIZE
+
+#define MAZE_WALLS {{0}}
+
+#define MAZE_HOME          {0, 0}
+#define MAZE_NUM_WAYPOINTS 1
+#define MAZE_WAYPOINTS     {{BENCH_SIZE - 1, BENCH_SIZE - 1}}
+
+#endif	/* BENCH_MAZE_H */
@@ -0,0 +1,472 @@
+/*! @file bench_path.c
+ *
+ *  @brief Times PATH_Plan, and the sweep it replaced, on the course and on larger ones.
+ *
+ *  Built without BENCH_SIZE, the shipped course (MAZE.h) is planned between every pair
+ *  of boxes. Built with BENCH_SIZE, a square course that many boxes a side is given
+ *  random walls (a quarter of the inside walls), or rooms with BENCH_ROOMS, and planned
+ *  between random boxes. Each route is planned and then driven a move at a time with
+ *  PATH_NextMove, as IROBOT does. The RAM the walls and flood take is printed first, to
+ *  compare PATH_COMPACT, and under PATH_HIERARCHY the routes are compared with the
+ *  shortest.
+ *
+ *  The sweep is the flood PATH_Plan used before the breadth-first wave-front: every
+ *  box not reached yet is given one more than its highest reached neighbour, over and
+ *  over until the robot's box is reached. It is only timed where it finishes in
+ *  reasonable time.
+ *
+ *  Walls are then put in one at a time between the far corners of the course, as the
+ *  robot finds them, and the path re-planned after each: once repairing the flood, and
+ *  once flooding again from scratch.
+ *
+ *  Each move of the routes is also decided over and over on its own, by PATH_NextMove and
+ *  by the probe findNextSquare used before it (turning the robot virtually to each open
+ *  side, and reading the path value of the box there), to time a single decision.
+ *
+ *  Each route driven is also timed as the robot would drive it, BENCH_TIME_BOX for each
+ *  box and PATH_TIME_TURN90/180 for each turn, to compare PATH_TURNS with the default.
+ *
+ *  @author A.Pope
+ *  @date 17-10-2016
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "PATH.c"
+
+#ifdef BENCH_SIZE
+#define BENCH_ROUTES 20 /* Random routes planned */
+#define WALL_ODDS    4  /* One in this many inside walls is there */
+#define BENCH_ROOM   16 /* Boxes a side of each room, with BENCH_ROOMS */
+#endif
+#define SWEEP_MAX_CELLS 65536 /* Largest course the sweep is timed on */
+#define BENCH_WALLS     20    /* Walls put in one at a time */
+#define BENCH_TIME_BOX  250   /* Drive from one box into the next, in units of 10ms */
+#define BENCH_DECISIONS 100000 /* Fewest decisions timed for each route */
+
+#ifdef BENCH_SIZE
+#ifdef PATH_COMPACT
+/*! @brief Puts a wall on one side of a box, kept by the box on its left or in front of it. */
+static void putWall(TBOX box, uint8_t dir){
+  switch(dir){
+    case 0:
+      if(box >= MAP_HEIGHT) //The front of the map is always walled
+        SET_PAIR(walls, box - MAP_HEIGHT, GET_PAIR(walls, box - MAP_HEIGHT) | 2);
+      break;
+    case 1:
+      SET_PAIR(walls, box, GET_PAIR(walls, box) | 1);
+      break;
+    case 2:
+      SET_PAIR(walls, box, GET_PAIR(walls, box) | 2);
+      break;
+    default:
+      if((box % MAP_HEIGHT) != 0) //As is the left
+        SET_PAIR(walls, box - 1, GET_PAIR(walls, box - 1) | 1);
+      break;
+  }
+}
+#else
+/*! @brief Puts a wall on one side of a box, and the matching side of its neighbour. */
+static void putWall(TBOX box, uint8_t dir){
+  TORDINATE ord;
+
+  ord.x = box / MAP_HEIGHT; ord.y = box % MAP_HEIGHT;
+  MAP_BOX(box) |= (FRONT | P_FRONT) >> dir;
+  stepOrdinate(&ord, dir);
+  if(ord.x < MAP_WIDTH && ord.y < MAP_HEIGHT) //Outside walls have no other side
+    MAP_BOX(BOX_INDEX(ord.x, ord.y)) |= (FRONT | P_FRONT) >> ((dir + 2) % 4);
+}
+#endif
+
+/*! @brief Walls the outside of the course, and a random share of the inside. With
+ *         BENCH_ROOMS, the inside is rooms instead, with a door in the middle of each wall.
+ */
+static void buildCourse(void){
+  TBOX box;
+
+  srand(1);
+  for(box = 0; box < MAP_CELLS; box++){
+    if(box < MAP_HEIGHT)
+      putWall(box, 0);
+    if((box % MAP_HEIGHT) == (MAP_HEIGHT - 1))
+      putWall(box, 1);
+    if(box >= (MAP_CELLS - MAP_HEIGHT))
+      putWall(box, 2);
+    if((box % MAP_HEIGHT) == 0)
+      putWall(box, 3);
+#ifdef BENCH_ROOMS
+    if(((box % MAP_HEIGHT) % BENCH_ROOM) == (BENCH_ROOM - 1) && ((box / MAP_HEIGHT) % BENCH_ROOM) != (BENCH_ROOM / 2))
+      putWall(box, 1);
+    if(((box / MAP_HEIGHT) % BENCH_ROOM) == (BENCH_ROOM - 1) && ((box % MAP_HEIGHT) % BENCH_ROOM) != (BENCH_ROOM / 2))
+      putWall(box, 2);
+#else
+    if(rand() % WALL_ODDS == 0)
+      putWall(box, 1);
+    if(rand() % WALL_ODDS == 0)
+      putWall(box, 2);
+#endif
+  }
+}
+#endif
+
+#if defined(PATH_FLOOD) && (MAP_CELLS <= SWEEP_MAX_CELLS)
+/*! @brief The sweep flood, into PATH_Path.
+ *
+ *  @return bool - TRUE if the robot's box was reached
+ */
+static bool sweepPlan(TORDINATE robotOrd, TORDINATE waypOrd){
+  TBOX box, next, robot = BOX_INDEX(robotOrd.x, robotOrd.y);
+  TPATH_DIST highest;
+  uint32_t passes = 0;
+  uint8_t dir;
+
+  for(box = 0; box < MAP_CELLS; box++)
+    PATH_BOX(box) = -1;
+  PATH_BOX(BOX_INDEX(waypOrd.x, waypOrd.y)) = 0;
+
+  while(PATH_BOX(robot) == -1){
+    if(++passes > (MAP_CELLS + 1))
+      return false; //As many passes as boxes, so it can't be reached
+
+    for(box = 0; box < MAP_CELLS; box++){
+      if(PATH_BOX(box) != -1)
+        continue;
+
+      highest = -1;
+      for(dir = 0; dir < 4; dir++){
+        if(openNeighbour(box, dir, &next) && PATH_BOX(next) > highest)
+          highest = PATH_BOX(next);
+      }
+      if(highest != -1)
+        PATH_BOX(box) = highest + 1;
+    }
+  }
+
+  return true;
+}
+#define SWEEP
+#endif
+
+static double driveTime; /*< Time to drive the routes walked, in seconds */
+
+/*! @brief Drives the last plan from a box a move at a time, adding up the time it takes.
+ *
+ *  @return moves - Moves made
+ */
+static long walk(TORDINATE ord){
+  TTURN turn; TORDINATE next;
+  uint8_t heading = rotationFactor;
+  long moves = 0, time = 0;
+
+  while(PATH_NextMove(ord, heading, &turn, &next)){
+    time += BENCH_TIME_BOX + ((turn == 0) ? 0 : (turn == 2) ? PATH_TIME_TURN180 : PATH_TIME_TURN90);
+    heading = (heading + turn) % 4;
+    ord = next;
+    moves++;
+  }
+
+  driveTime += time / 100.0;
+  return moves;
+}
+
+#ifdef PATH_HIERARCHY
+/*! @brief Breadth-first search over Map, for the shortest route between two boxes.
+ *
+ *  @return boxes - Length of the shortest route, -1 if there is none
+ */
+static long shortest(TORDINATE fromOrd, TORDINATE toOrd){
+  static long dist[MAP_CELLS];
+  static TBOX queue[MAP_CELLS];
+  TBOX box, next, from = BOX_INDEX(fromOrd.x, fromOrd.y);
+  long head = 0, tail = 0;
+  uint8_t dir;
+
+  for(box = 0; box < MAP_CELLS; box++)
+    dist[box] = -1;
+  dist[BOX_INDEX(toOrd.x, toOrd.y)] = 0;
+  queue[tail++] = BOX_INDEX(toOrd.x, toOrd.y);
+
+  while(head < tail && dist[from] == -1){
+    box = queue[head++];
+    for(dir = 0; dir < 4; dir++){
+      if(openNeighbour(box, dir, &next) && dist[next] == -1){
+        dist[next] = dist[box] + 1;
+        queue[tail++] = next;
+      }
+    }
+  }
+
+  return dist[from];
+}
+#endif
+
+static double elapsed(clock_t start){
+  return ((double) (clock() - start) * 1000.0) / CLOCKS_PER_SEC;
+}
+
+#if defined(PATH_FLOOD) && !defined(PATH_TURNS)
+/*! @brief Finds the next box as findNextSquare did before PATH_NextMove, from the robot's
+ *         box and rotationFactor.
+ *
+ *  @return dir - Map direction of the lowest box around, -1 if none is lower
+ */
+static int8_t probeNext(TORDINATE ord){
+  TPATH_DIST lowestSoFar = PATH_GetPathVal(ord), temp;
+  TORDINATE next;
+  int8_t lowest = -1;
+
+  if(!PATH_GetMapInfo(ord, BOX_Front)){
+    next = ord; PATH_UpdateCoordinate(&next);
+    temp = PATH_GetPathVal(next);
+    if(temp < lowestSoFar && temp != -1){
+      lowest = rotationFactor;
+      lowestSoFar = temp;
+    }
+  }
+
+  if(!PATH_GetMapInfo(ord, BOX_Left)){
+    PATH_UpdateOrient(1, DIR_CCW); //Virtually turn the robot
+    next = ord; PATH_UpdateCoordinate(&next);
+    temp = PATH_GetPathVal(next);
+    if(temp < lowestSoFar && temp != -1){
+      lowest = rotationFactor;
+      lowestSoFar = temp;
+    }
+    PATH_UpdateOrient(1, DIR_CW); //Virtually reset the robot
+  }
+
+  if(!PATH_GetMapInfo(ord, BOX_Right)){
+    PATH_UpdateOrient(1, DIR_CW);
+    next = ord; PATH_UpdateCoordinate(&next);
+    temp = PATH_GetPathVal(next);
+    if(temp < lowestSoFar && temp != -1){
+      lowest = rotationFactor;
+      lowestSoFar = temp;
+    }
+    PATH_UpdateOrient(1, DIR_CCW);
+  }
+
+  if(!PATH_GetMapInfo(ord, BOX_Back)){
+    PATH_UpdateOrient(2, DIR_CCW);
+    next = ord; PATH_UpdateCoordinate(&next);
+    temp = PATH_GetPathVal(next);
+    if(temp < lowestSoFar && temp != -1){
+      lowest = rotationFactor;
+      lowestSoFar = temp;
+    }
+    PATH_UpdateOrient(2, DIR_CW);
+  }
+
+  return lowest;
+}
+
+/*! @brief Times single move decisions along every route, by PATH_NextMove and by the probe.
+ *
+ *  @param nextNs, probeNs - Where the time of a decision is added up (ns)
+ *  @param same - Where the decisions both make the same are counted
+ *
+ *  @return decisions - Decisions along the routes
+ */
+static long stepRun(TORDINATE * from, TORDINATE * to, long routes, double * nextNs, double * probeNs, long * same){
+  static TORDINATE ords[MAP_CELLS];
+  static uint8_t headings[MAP_CELLS];
+  TTURN turn; TORDINATE ord, next;
+  long i, decisions = 0, reps, r, timed, sink = 0;
+  uint8_t heading;
+  TBOX n, k;
+  clock_t start;
+
+  *nextNs = 0; *probeNs = 0; *same = 0;
+  for(i = 0; i < routes; i++){
+    if(!PATH_Plan(from[i], to[i]))
+      continue;
+
+    //Drive the route once, which also builds the downhill table, and keep each decision
+    for(n = 0, ord = from[i], heading = 0; PATH_NextMove(ord, heading, &turn, &next); n++){
+      ords[n] = ord; headings[n] = heading;
+      rotationFactor = heading;
+      heading = (heading + turn) % 4;
+      if(probeNext(ord) == heading)
+        (*same)++;
+      ord = next;
+    }
+    if(n == 0)
+      continue;
+    decisions += n;
+    reps = 1 + (BENCH_DECISIONS / n);
+    timed = reps * n;
+
+    start = clock();
+    for(r = 0; r < reps; r++){
+      for(k = 0; k < n; k++)
+        sink += PATH_NextMove(ords[k], headings[k], &turn, &next) ? turn : 0;
+    }
+    *nextNs += (elapsed(start) * 1e6 / timed) * n;
+
+    start = clock();
+    for(r = 0; r < reps; r++){
+      for(k = 0; k < n; k++){
+        rotationFactor = headings[k];
+        sink += probeNext(ords[k]);
+      }
+    }
+    *probeNs += (elapsed(start) * 1e6 / timed) * n;
+  }
+
+  if(sink == 42)
+    printf(" "); //Keeps the decisions from being optimised away
+  rotationFactor = 0;
+  return decisions;
+}
+#endif
+
+#ifdef PATH_FLOOD
+/*! @brief Puts BENCH_WALLS random walls in one at a time, re-planning after each.
+ *
+ *  @param repair - TRUE to repair the flood after each wall, FALSE to flood again
+ *  @param lengths - Where the length of the path is added up after each wall
+ *
+ *  @return ms - Time spent planning after each wall
+ */
+static double wallRun(bool repair, long * lengths){
+  static uint8_t savedMap[MAP_WIDTH][MAP_HEIGHT], savedKnown[sizeof(known)];
+  TORDINATE robot = {0, 0}, wayP = {MAP_WIDTH - 1, MAP_HEIGHT - 1}, ord;
+  TBOX next;
+  uint8_t dir;
+  double ms = 0;
+  clock_t start;
+  int i;
+
+  memcpy(savedMap, Map, sizeof(Map)); memcpy(savedKnown, known, sizeof(known));
+  forgetPlans();
+  PATH_Plan(robot, wayP);
+
+  srand(3);
+  for(i = 0, *lengths = 0; i < BENCH_WALLS; i++){
+    do {
+      ord.x = rand() % MAP_WIDTH; ord.y = rand() % MAP_HEIGHT;
+      dir = 1 + (rand() % 2);
+    } while(!openNeighbour(BOX_INDEX(ord.x, ord.y), dir, &next));
+
+    start = clock();
+    addWall(ord, dir, true); //The repair is done here
+    if(!repair)
+      forgetPlans();
+    PATH_Plan(robot, wayP);
+    ms += elapsed(start);
+    *lengths += PATH_GetPathVal(robot);
+  }
+
+  memcpy(Map, savedMap, sizeof(Map)); memcpy(known, savedKnown, sizeof(known));
+#ifdef PATH_BITBOARD
+  buildBitboards();
+#endif
+  forgetPlans();
+
+  return ms;
+}
+#endif
+
+int main(void){
+  static TORDINATE from[MAP_CELLS < 1000 ? (MAP_CELLS * MAP_CELLS) : 1000], to[sizeof(from) / sizeof(from[0])];
+  long routes = 0, i, moves = 0, found = 0;
+  clock_t start;
+  double planMs;
+
+#if defined(BENCH_SIZE) && !defined(PATH_COMPACT)
+  buildCourse();
+#endif
+#ifdef BENCH_SIZE
+  srand(2);
+  for(routes = 0; routes < BENCH_ROUTES; routes++){
+    from[routes].x = rand() % MAP_WIDTH; from[routes].y = rand() % MAP_HEIGHT;
+    to[routes].x = rand() % MAP_WIDTH; to[routes].y = rand() % MAP_HEIGHT;
+  }
+#else
+  for(i = 0; i < (long) (MAP_CELLS * MAP_CELLS); i++, routes++){
+    from[routes].x = (i / MAP_CELLS) / MAP_HEIGHT; from[routes].y = (i / MAP_CELLS) % MAP_HEIGHT;
+    to[routes].x = (i % MAP_CELLS) / MAP_HEIGHT; to[routes].y = (i % MAP_CELLS) % MAP_HEIGHT;
+  }
+#endif
+
+  start = clock();
+  PATH_Init();
+  printf("%ux%u: PATH_Init %.2f ms\n", (unsigned) MAP_WIDTH, (unsigned) MAP_HEIGHT, elapsed(start));
+#if defined(BENCH_SIZE) && defined(PATH_COMPACT)
+  buildCourse(); //The walls are kept in RAM, which PATH_Init fills from the maze definition
+#endif
+#ifdef PATH_COMPACT
+  printf("  walls and flood: %lu bytes of RAM\n", (unsigned long) (sizeof(walls) + sizeof(flood)));
+#elif defined(PATH_FLOOD)
+  printf("  walls and flood: %lu bytes of RAM, and %lu for the flood queue and repairs\n",
+         (unsigned long) (sizeof(Map) + sizeof(PATH_Path)),
+         (unsigned long) (sizeof(floodQueue) + sizeof(lostBoxes) + sizeof(floodMark) + sizeof(known)));
+#endif
+#ifdef PATH_HIERARCHY
+  printf("  entrance paths: %lu of %lu bytes used\n", (unsigned long) (intraEnd * sizeof(intra[0])),
+         (unsigned long) sizeof(intra));
+#endif
+
+  start = clock();
+  for(i = 0; i < routes; i++){
+    if(PATH_Plan(from[i], to[i])){
+      found++;
+      moves += walk(from[i]);
+    }
+  }
+  planMs = elapsed(start) / routes;
+  printf("  PATH_Plan: %ld routes (%ld found, %ld moves), %.4f ms a route, %.1f s driving them\n", routes, found, moves,
+         planMs, driveTime);
+
+#ifdef PATH_HIERARCHY
+  {
+    long walked, best, extra = 0, total = 0;
+    double worst = 0;
+
+    for(i = 0; i < routes; i++){
+      if(!PATH_Plan(from[i], to[i]))
+        continue;
+      walked = walk(from[i]);
+      best = shortest(from[i], to[i]);
+      total += best; extra += walked - best;
+      if(best > 0 && (walked - best) * 100.0 / best > worst)
+        worst = (walked - best) * 100.0 / best;
+    }
+    printf("  routes:    %.1f%% longer than the shortest, the worst %.1f%%\n", total ? (extra * 100.0 / total) : 0, worst);
+  }
+#endif
+
+#ifdef SWEEP
+  start = clock();
+  for(i = 0, found = 0; i < routes; i++){
+    if(sweepPlan(from[i], to[i]))
+      found++;
+  }
+  printf("  sweep:     %ld routes (%ld found), %.4f ms a route\n", routes, found, elapsed(start) / routes);
+#else
+  printf("  sweep:     not timed on a course this big\n");
+#endif
+
+#if defined(PATH_FLOOD) && !defined(PATH_TURNS)
+  {
+    double nextNs, probeNs;
+    long same, decisions = stepRun(from, to, routes, &nextNs, &probeNs, &same);
+
+    printf("  next move: PATH_NextMove %.1f ns a decision, the old probe %.1f ns (%ld of %ld the same)\n",
+           nextNs / decisions, probeNs / decisions, same, decisions);
+  }
+#endif
+
+#ifdef PATH_FLOOD
+  {
+    long repaired, flooded;
+    double repairMs = wallRun(true, &repaired), floodMs = wallRun(false, &flooded);
+
+    printf("  %d walls:  repaired %.4f ms a wall, flooded again %.4f ms a wall (%s paths)\n", BENCH_WALLS,
+           repairMs / BENCH_WALLS, floodMs / BENCH_WALLS, (repaired == flooded) ? "same" : "DIFFERENT");
+  }
+#endif
+
+  return 0;
+}
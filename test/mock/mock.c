@@ -0,0 +1,22 @@
+/*! @file mock.c
+ *
+ *  @brief Defines the registers and built-ins stubbed out by the host pic.h.
+ *
+ *  @author A.Pope
+ *  @date 17-10-2016
+ */
+#define MOCK_REG
+#include "pic.h"
+
+void (*mock_delay_hook)(unsigned long us);
+unsigned long mock_delayed_us;
+
+void mock_delay_us(unsigned long us){
+  mock_delayed_us += us;
+  if(mock_delay_hook)
+    mock_delay_hook(us);
+}
+
+unsigned char eeprom_read(unsigned char addr){
+  return addr;
+}
@@ -0,0 +1,65 @@
+/*! @file pic.h
+ *
+ *  @brief Host stand-in for the XC8 <pic.h>, for the tests in test/.
+ *
+ *  The PIC16F877A registers the modules use are plain variables here, so a test can
+ *  play the part of the hardware by setting and reading them (e.g. put a byte in RCREG
+ *  and call USART_RxTick). The delays call mock_delay_us, which a test can hook to move
+ *  its simulated world on. Registers are defined once, in mock.c.
+ *
+ *  @author A.Pope
+ *  @date 17-10-2016
+ */
+#ifndef MOCK_PIC_H
+#define MOCK_PIC_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef MOCK_REG
+#define MOCK_REG extern /* mock.c defines the registers by making this empty */
+#endif
+
+/* Compiler built-ins */
+#define interrupt
+#define NOP()
+#define di()
+#define ei()
+#define __EEPROM_DATA(a, b, c, d, e, f, g, h)
+#define __delay_us(x) mock_delay_us(x)
+#define __delay_ms(x) mock_delay_us((unsigned long) (x) * 1000)
+
+extern void (*mock_delay_hook)(unsigned long us); /* Called with the length of every delay, if set */
+extern unsigned long mock_delayed_us;               /* Total time spent in delays */
+void mock_delay_us(unsigned long us);
+unsigned char eeprom_read(unsigned char addr);      /* Returns the address */
+
+/* Byte registers and single bits */
+MOCK_REG volatile unsigned char PORTA, PORTB, PORTC, PORTD, PORTE, TRISC, TRISD, TRISE;
+MOCK_REG volatile unsigned char TMR0, TMR2, PR2, T2CON, ADRESH, ADRESL;
+MOCK_REG volatile unsigned char RCREG, TXREG, SPBRG, SSPBUF;
+MOCK_REG volatile unsigned char RB0, RB1, RB2, RB3, RB4, RB5, RC2, GO, CREN, SSPIF;
+
+/* Bit-field registers */
+MOCK_REG volatile struct MOCK_TRISAbits { unsigned TRISA0:1, TRISA1:1, TRISA3:1; } TRISAbits;
+MOCK_REG volatile struct MOCK_TRISBbits { unsigned TRISB0:1, TRISB1:1, TRISB2:1, TRISB3:1, TRISB4:1, TRISB5:1; } TRISBbits;
+MOCK_REG volatile struct MOCK_TRISCbits { unsigned TRISC0:1, TRISC1:1, TRISC2:1, TRISC3:1, TRISC4:1, TRISC5:1, TRISC6:1, TRISC7:1; } TRISCbits;
+MOCK_REG volatile struct MOCK_PORTEbits { unsigned RE0:1, RE1:1, RE2:1; } PORTEbits;
+MOCK_REG volatile struct MOCK_ADCON0bits { unsigned ADCS1:1, ADCS0:1, CHS2:1, CHS1:1, CHS0:1, ADON:1; } ADCON0bits;
+MOCK_REG volatile struct MOCK_ADCON1bits { unsigned ADCS2:1, ADFM:1, PCFG3:1, PCFG2:1, PCFG1:1, PCFG0:1; } ADCON1bits;
+MOCK_REG volatile struct MOCK_TXSTAbits { unsigned BRGH:1, SYNC:1, TX9:1, TXEN:1, TRMT:1; } TXSTAbits;
+MOCK_REG volatile struct MOCK_RCSTAbits { unsigned SPEN:1, CREN:1, SREN:1, RX9:1, OERR:1, FERR:1; } RCSTAbits;
+MOCK_REG volatile struct MOCK_SSPSTATbits { unsigned SMP:1, CKE:1; } SSPSTATbits;
+MOCK_REG volatile struct MOCK_SSPCONbits { unsigned WCOL:1, SSPOV:1, SSPEN:1, CKP:1, SSPM3:1, SSPM2:1, SSPM1:1, SSPM0:1; } SSPCONbits;
+MOCK_REG volatile struct MOCK_PIE1bits { unsigned TXIE:1, RCIE:1, TMR2IE:1; } PIE1bits;
+MOCK_REG volatile struct MOCK_PIR1bits { unsigned TXIF:1, RCIF:1, TMR2IF:1; } PIR1bits;
+MOCK_REG volatile struct MOCK_INTCONbits { unsigned T0IF:1, T0IE:1, PEIE:1, GIE:1; } INTCONbits;
+MOCK_REG volatile struct MOCK_OPTION_REGbits { unsigned T0CS:1, PSA:1, PS2:1, PS1:1, PS0:1; } OPTION_REGbits;
+MOCK_REG volatile struct MOCK_T2CONbits { unsigned TMR2ON:1; } T2CONbits;
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* MOCK_PIC_H */
@@ -0,0 +1,13 @@
+/*! @file xc.h
+ *
+ *  @brief Host stand-in for the XC8 <xc.h>, for the tests in test/.
+ *
+ *  @author A.Pope
+ *  @date 17-10-2016
+ */
+#ifndef MOCK_XC_H
+#define MOCK_XC_H
+
+#include "pic.h"
+
+#endif	/* MOCK_XC_H */
@@ -0,0 +1,329 @@
+/*! @file sim_run.c
+ *
+ *  @brief Times IROBOT's straight runs on a simulated iRobot.
+ *
+ *  IROBOT, MOVE, POSE, PATH and TOUR are built as they are on the PIC, in place of the
+ *  USART the simulated Create takes the drive commands and streams its sensors back as
+ *  15ms frames. Commands take effect at the Create's next 15ms cycle, and the wheels
+ *  change speed at no more than SIM_ACCEL, the braking MOVE's profile allows for. Time
+ *  passes 1ms for every pass of a driving loop, and through every delay.
+ *
+ *  Runs of each length are driven, then every straight run of a lap of the course's
+ *  way-points (in the order TOUR gives), then runs with the odometry drifted along and
+ *  across them (across a box border), then a run past two victims. Each must stop
+ *  within SIM_STOP_ERR of the centre of the box IROBOT thinks it is in.
+ *
+ *  Last, the robot approaches a wall in front from a few boxes away, the IR a running
+ *  average over ADC_WINDOW_MS as ADC's is. It must stop within SIM_APPROACH_ERR of
+ *  APPROACH_STOP_DIST, never more than SIM_LATE over the speed it could brake from in
+ *  time. Build with IROBOT_SRC set to another IROBOT.c to compare.
+ *
+ *  @author A.Pope
+ *  @date 17-10-2016
+ */
+#include <math.h>
+#include "test.h"
+#include "ADC.h"
+#include "PATH.c"
+#include "TOUR.c"
+#include "POSE.c"
+#include "MOVE.c"
+
+#ifndef SIM_ACCEL
+#define SIM_ACCEL 500 /* Fastest the wheels speed up or slow down (mm/s^2) */
+#endif
+#define SIM_CYCLE_MS 15  /* The Create acts on commands and streams a frame this often */
+#define SIM_STOP_ERR 100 /* Furthest a run may stop from the centre of its box (mm) */
+#define SIM_DRIFT    60  /* Odometry drift along a run, still within the box (mm) */
+#define SIM_SIDEWAYS 600 /* Odometry drift across a run, over the border of the box beside it (mm) */
+#define SIM_APPROACH_ERR 50 /* Furthest a front wall approach may stop from APPROACH_STOP_DIST (mm) */
+#define SIM_NO_IR    255 /* IR byte with no beacon in sight */
+#define SIM_VICTIM   250 /* IR byte with a red buoy and force field in sight */
+#define SIM_RX_SIZE  256
+#define SIM_IR_READS 8   /* Readings in the IR's running average */
+#define SIM_IR_EVERY 4   /* Time (ms) between readings of the IR, with the other channel read in between */
+#define SIM_IR_FAR   2000 /* IR distance (mm) with no wall in sight */
+#define SIM_LATE     10  /* Most the wheels may be over the speed they could stop from in time (mm/s) */
+
+#if ((SIM_IR_READS * SIM_IR_EVERY) != ADC_WINDOW_MS)
+#error "sim_run's IR average must span what ADC's does"
+#endif
+
+static bool simSnapshot(TMOVE_SNAPSHOT * snap, TSENSORS * sens);
+#define MOVE_Snapshot simSnapshot /* Each pass of a driving loop moves the simulation on */
+#ifdef IROBOT_SRC
+#include IROBOT_SRC
+#else
+#include "IROBOT.c"
+#endif
+#undef MOVE_Snapshot
+
+static long nowMs;                 /*< Simulated time */
+static double posX, posY;          /*< Where the Create really is (mm, map axes) */
+static double speed;               /*< Its wheel speed (mm/s), both wheels turn together on a run */
+static double target, pending;     /*< Speed it is driving at, and the latest it has been sent */
+static double unreported;          /*< Distance not yet reported in a frame */
+static TORDINATE victims[2];       /*< Boxes the victims are in */
+static uint8_t numVictims;
+static uint8_t rx[SIM_RX_SIZE];    /*< Bytes streamed and not read yet */
+static uint8_t rxHead, rxTail;
+static uint8_t cmd[5], cmdLen;     /*< Command being sent to the Create */
+static double wallX;               /*< Where a wall ahead of the robot is along the x axis (mm), if there is one */
+static bool wallAhead;
+static double lateBy;              /*< Most the wheels have been over the speed they could stop from in time for the wall (mm/s) */
+static double irReads[SIM_IR_READS]; /*< The IR's latest readings (mm), as ADC averages them */
+static uint8_t irNext;
+
+bool USART_Init(void){ return true; }
+void USART_GetOverruns(TUSART_OVERRUNS * overruns){ overruns->hardware = 0; overruns->buffer = 0; }
+bool IR_Init(void){ return true; }
+/*! @brief What the IR reads straight ahead (mm), as the robot faces down the x axis. */
+static double irTrue(void){
+  return (wallAhead && (posX - wallX) < SIM_IR_FAR) ? (posX - wallX) : SIM_IR_FAR;
+}
+
+/*! @brief The running average of the IR's latest readings. */
+uint16_t IR_Measure(void){
+  double sum = 0;
+  uint8_t i;
+
+  for(i = 0; i < SIM_IR_READS; i++)
+    sum += irReads[i];
+  return (uint16_t) lround(sum / SIM_IR_READS);
+}
+
+void IR_Restart(void){
+  uint8_t i;
+
+  for(i = 0; i < SIM_IR_READS; i++)
+    irReads[i] = irTrue(); //As if the window had filled standing still
+}
+
+const uint8_t SM_STEPS_FOR_180 = 200;
+bool SM_Init(void){ return true; }
+void SM_MoveTo(uint16_t target){ (void) target; }
+uint16_t SM_GetOrientation(void){ return 0; }
+bool SM_IsDone(void){ return true; }
+
+bool USART_ReadChar(uint8_t * data){
+  if(rxHead == rxTail)
+    return false;
+  *data = rx[rxTail++];
+  return true;
+}
+
+/*! @brief The Create receives a byte, only drive commands matter here. */
+void USART_OutChar(const uint8_t data){
+  if(cmdLen == 0 && data != OP_DRIVE_DIRECT)
+    return;
+  cmd[cmdLen++] = data;
+  if(cmdLen == sizeof(cmd)){
+    pending = (int16_t) ((cmd[1] << 8) | cmd[2]);
+    cmdLen = 0;
+  }
+}
+
+void USART_Write(const uint8_t * buf, uint8_t len){
+  while(len--)
+    USART_OutChar(*buf++);
+}
+
+/*! @brief The Create's IR byte, a victim's beacon is seen from anywhere in its box. */
+static uint8_t irByte(void){
+  long x = lround(posX / POSE_BOX_LENGTH), y = lround(posY / POSE_BOX_LENGTH);
+  uint8_t i;
+
+  for(i = 0; i < numVictims; i++)
+    if(victims[i].x == x && victims[i].y == y)
+      return SIM_VICTIM;
+  return SIM_NO_IR;
+}
+
+static void streamFrame(void){
+  uint8_t body[] = {OP_STREAM_HEADER, FRAME_BYTES, OP_SENS_BUMP, 0, OP_SENS_VWALL, 0, OP_SENS_IR, irByte(),
+                    OP_SENS_DIST, 0, 0, OP_SENS_ANGLE, 0, 0, OP_SONG_PLAYING, 0};
+  int16_t dist = (int16_t) lround(unreported);
+  uint8_t i, sum = 0;
+
+  unreported -= dist; //The Create carries what it hasn't reported over to the next frame
+  body[9] = (uint8_t) (dist >> 8); body[10] = (uint8_t) dist;
+  for(i = 0; i < sizeof(body); i++){
+    rx[rxHead++] = body[i];
+    sum += body[i];
+  }
+  rx[rxHead++] = (uint8_t) -sum;
+}
+
+/*! @brief Moves the simulation on 1ms, along the map direction the robot faces. */
+static void simStep(void){
+  double step = SIM_ACCEL / 1000.0, moved, safe;
+
+  nowMs++;
+  if((nowMs % SIM_CYCLE_MS) == 0){
+    target = pending;
+    streamFrame();
+  }
+
+  if(speed < target)
+    speed = (target - speed < step) ? target : speed + step;
+  else if(speed > target)
+    speed = (speed - target < step) ? target : speed - step;
+
+  moved = speed / 1000.0;
+  unreported += moved;
+  switch(rotationFactor){
+    case 0: posX -= moved; break;
+    case 1: posY += moved; break;
+    case 2: posX += moved; break;
+    default: posY -= moved; break;
+  }
+
+  if(wallAhead){
+    //Braking at SIM_ACCEL after 30ms, as MOVE's profile does, to where the IR should stop (crawling in at the end)
+    safe = sqrt(pow(SIM_ACCEL * 0.03, 2) + (2 * SIM_ACCEL * fmax(posX - wallX - APPROACH_STOP_DIST, 0))) - (SIM_ACCEL * 0.03);
+    if(speed - fmax(safe, PROFILE_MIN_SPEED) > lateBy)
+      lateBy = speed - fmax(safe, PROFILE_MIN_SPEED);
+  }
+  if((nowMs % SIM_IR_EVERY) == 0){
+    irReads[irNext] = irTrue();
+    irNext = (irNext + 1) % SIM_IR_READS;
+  }
+  MOVE_StreamRx(); //The 1ms tick
+}
+
+static void simDelay(unsigned long us){
+  unsigned long ms;
+
+  for(ms = 0; ms < (us / 1000); ms++)
+    simStep();
+}
+
+static bool simSnapshot(TMOVE_SNAPSHOT * snap, TSENSORS * sens){
+  simStep();
+  return MOVE_Snapshot(snap, sens);
+}
+
+/*! @brief Places the robot lined up in a box, stopped. */
+static void place(TORDINATE ord, uint8_t heading){
+  rotationFactor = heading;
+  POSE_Set(ord, heading);
+  posX = ord.x * (double) POSE_BOX_LENGTH; posY = ord.y * (double) POSE_BOX_LENGTH;
+  speed = target = pending = 0; unreported = 0;
+  while(rxHead != rxTail || (nowMs % SIM_CYCLE_MS) != 0)
+    simStep();
+}
+
+/*! @brief Drives a run, until the robot has stopped.
+ *
+ *  @return ms - Time taken
+ */
+static long run(TORDINATE * ord, TPATH_ORD boxes, bool * vicsFound){
+  TSENSORS sens; int16_t movBack = 0;
+  long start = nowMs;
+  double err;
+
+  CHECK(!driveRun(ord, boxes, &sens, &movBack, vicsFound));
+  while(speed != 0 || target != 0 || pending != 0)
+    simStep();
+
+  err = hypot(posX - (ord->x * (double) POSE_BOX_LENGTH), posY - (ord->y * (double) POSE_BOX_LENGTH));
+  CHECK(err < SIM_STOP_ERR);
+  return nowMs - start;
+}
+
+int main(void){
+  static const TORDINATE waypoints[MAZE_NUM_WAYPOINTS] = MAZE_WAYPOINTS;
+  TORDINATE list[RUN_POINTS], ord, start, home = MAZE_HOME;
+  TSEGMENT segs[MAP_CELLS];
+  TPOSE pose;
+  TPATH_ORD boxes;
+  uint8_t i, n, s;
+  long ms, total = 0, runBoxes = 0, runs = 0;
+  bool vicsFound = false;
+
+  mock_delay_hook = simDelay;
+  PATH_Init(); POSE_Init(); MOVE_Init();
+  MOVE_StartStream();
+  printf("Straight runs, wheels braking at %d mm/s^2:\n", SIM_ACCEL);
+
+  //Runs of each length down the x axis
+  for(boxes = 2; boxes < MAZE_WIDTH; boxes++){
+    start.x = boxes; start.y = 0;
+    ord = start;
+    place(ord, 0);
+    ms = run(&ord, boxes, &vicsFound);
+    CHECK(ord.x == 0 && ord.y == 0);
+    printf("  %u boxes: %ld ms, stopped %.0f mm past the centre\n", (unsigned) boxes, ms, -posX);
+  }
+
+  //Every straight run of a lap of the way-points
+  for(i = 0; i < MAZE_NUM_WAYPOINTS; i++)
+    list[i] = waypoints[i];
+  list[MAZE_NUM_WAYPOINTS] = home;
+  TOUR_Order(home, list, RUN_POINTS);
+  ord = home;
+  for(i = 0; i < RUN_POINTS; i++){
+    PATH_Plan(ord, list[i]);
+    n = PATH_GetSegments(ord, segs, sizeof(segs) / sizeof(segs[0]));
+    for(s = 0; s < n; s++){
+      if(segs[s].boxes > 1){
+        place(ord, segs[s].heading);
+        total += run(&ord, segs[s].boxes, &vicsFound);
+        runBoxes += segs[s].boxes; runs++;
+      } else {
+        rotationFactor = segs[s].heading;
+        PATH_UpdateCoordinate(&ord);
+      }
+    }
+    CHECK(ord.x == list[i].x && ord.y == list[i].y);
+  }
+  printf("  A lap of the way-points: %ld runs of %ld boxes, %ld ms\n", runs, runBoxes, total);
+
+  //Odometry ahead of the robot, it stops short but in the box counted to, and the pose is put on its centre
+  ord.x = 3; ord.y = 0;
+  place(ord, 0);
+  robot.x -= (int32_t) SIM_DRIFT << POSE_FRAC_BITS;
+  run(&ord, 3, &vicsFound);
+  POSE_Get(&pose);
+  CHECK(ord.x == 0 && ord.y == 0 && pose.x == 0 && pose.y == 0);
+  printf("  Odometry %d mm ahead: stopped %.0f mm short of the centre, pose put back on it\n", SIM_DRIFT, posX);
+
+  //Odometry in the box beside the run, the box counted to is kept and the pose left alone
+  ord.x = 3; ord.y = 0;
+  place(ord, 0);
+  robot.y += (int32_t) SIM_SIDEWAYS << POSE_FRAC_BITS;
+  run(&ord, 3, &vicsFound);
+  POSE_Get(&pose);
+  CHECK(ord.x == 0 && ord.y == 0 && (pose.y >> POSE_FRAC_BITS) == SIM_SIDEWAYS);
+  printf("  Odometry %d mm to the side: stopped in (%u, %u), the box counted to\n", SIM_SIDEWAYS, (unsigned) ord.x, (unsigned) ord.y);
+
+  //Past two victims, the robot must stop in the centre of the box after the second
+  victims[0].x = 3; victims[0].y = 0; victims[1].x = 2; victims[1].y = 0;
+  numVictims = 2;
+  ord.x = 4; ord.y = 0;
+  place(ord, 0);
+  ms = run(&ord, 4, &vicsFound);
+  CHECK(vicsFound && ord.x == 1 && ord.y == 0);
+  printf("  Victims in the 2nd and 3rd of 4 boxes: stopped in (%u, %u) %.0f mm from its centre, %ld ms\n",
+         (unsigned) ord.x, (unsigned) ord.y, fabs(posX - (ord.x * (double) POSE_BOX_LENGTH)), ms);
+
+  //Up to a wall in front from a few boxes away, the IR's averaging lagging behind
+  numVictims = 0;
+  for(boxes = 2; boxes < MAZE_WIDTH; boxes++){
+    TSENSORS sens; int dist = 0;
+    ord.x = boxes; ord.y = 0;
+    place(ord, 0);
+    wallX = -(POSE_BOX_LENGTH / 2.0); wallAhead = true; //On the far side of box (0, 0)
+    IR_Restart();
+    lateBy = 0;
+    CHECK(!approachFrontWall(&sens, &dist));
+    while(speed != 0 || target != 0 || pending != 0)
+      simStep();
+    CHECK((posX - wallX) >= (APPROACH_STOP_DIST - SIM_APPROACH_ERR) && (posX - wallX) <= (APPROACH_STOP_DIST + SIM_APPROACH_ERR));
+    CHECK(lateBy <= SIM_LATE);
+    printf("  Front wall %u boxes away: stopped %.0f mm from it, at most %.0f mm/s too fast to stop in time\n", (unsigned) boxes, posX - wallX, lateBy);
+  }
+  wallAhead = false;
+
+  return TEST_DONE("sim_run");
+}
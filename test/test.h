@@ -0,0 +1,30 @@
+/*! @file test.h
+ *
+ *  @brief Checks shared by the host tests.
+ *
+ *  Each test is one program that #includes the module it tests (so it can see its
+ *  private state), counts its checks, and exits non-zero if any failed.
+ *
+ *  @author A.Pope
+ *  @date 17-10-2016
+ */
+#ifndef TEST_H
+#define	TEST_H
+
+#include <stdio.h>
+
+static long testChecks;   /*< Checks made */
+static long testFailures; /*< Checks that failed */
+
+/* Counts a check, printing the first few that fail */
+#define CHECK(cond) do {                                          \
+    testChecks++;                                                 \
+    if(!(cond) && (++testFailures <= 10))                         \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+  } while(0)
+
+/* Prints the totals, and gives the exit code for main */
+#define TEST_DONE(name) \
+  (printf("%s: %ld checks, %ld failed\n", (name), testChecks, testFailures), (testFailures != 0))
+
+#endif	/* TEST_H */
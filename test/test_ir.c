@@ -0,0 +1,252 @@
+/*! @file test_ir.c
+ *
+ *  @brief Checks IR's distance tables and blending, and ADC's running averages, with the
+ *         ADC played by the test.
+ *
+ *  The test stands in for the converter: whenever ADC_Sample has started a conversion,
+ *  the next timer tick finds it done, with the level set for the selected channel in
+ *  ADRESH:ADRESL. Each measurement first ticks long enough for both running averages to
+ *  fill with that level.
+ *
+ *  Every short range ADC code must convert to within 1mm of the calcDistance IR used
+ *  before the table (kept here as it was). Built with IR_LONG_RANGE, between 1000 and
+ *  1500mm the two sensors must blend as IR.h describes; without it, the long range
+ *  sensor must be ignored. The table look up is then timed against calcDistance.
+ *
+ *  The running averages are checked as they fill (only once full, and within the time
+ *  ADC.h gives), after ADC_Restart, and with the two channels reading different levels.
+ *  Delays made while waiting for a window run the tick, unless the tick is stopped.
+ *
+ *  @author A.Pope
+ *  @date 17-10-2016
+ */
+#include <math.h>
+#include <time.h>
+#include "test.h"
+#include "ADC.c"
+#include "IR.c"
+
+#define ADC_CODES   1024 /* 10-bit ADC */
+#define FILL_TICKS  (2 * ADC_CHANNELS * ADC_WINDOW) /* Ticks until every window is full */
+#define BENCH_LOOPS 2000 /* Times every code is converted in the benchmark */
+
+static uint16_t level[ADC_CHANNELS]; /*< What each channel reads */
+static uint8_t lastChannel;          /*< Channel of the last conversion */
+static long alternated;              /*< Conversions of a different channel than the one before */
+static bool ticking;                 /*< FALSE to stop the tick, as if the interrupt never came */
+static unsigned long tickUs;         /*< Time delayed not yet made up into a tick */
+
+/*! @brief The converter, then the timer tick. */
+static void tick(void){
+  if(GO){
+    if(ADCON0bits.CHS0 != lastChannel)
+      alternated++;
+    lastChannel = ADCON0bits.CHS0;
+    ADRESH = (uint8_t) (level[ADCON0bits.CHS0] >> 8);
+    ADRESL = (uint8_t) level[ADCON0bits.CHS0];
+    GO = 0;
+  }
+  ADC_Sample();
+}
+
+/*! @brief A delay, the tick is run for each 1ms of it. */
+static void delayTicks(unsigned long us){
+  for(tickUs += us; tickUs >= 1000; tickUs -= 1000){
+    if(ticking)
+      tick();
+  }
+}
+
+/*! @brief Checks the running averages fill, restart, and keep the channels apart. */
+static void checkWindows(void){
+  unsigned long before;
+  long conversions;
+  int i;
+
+  //With the tick off nothing can fill the windows, so there is no wait for them
+  level[ADC_SHORT_IR] = 300; level[ADC_LONG_IR] = 700;
+  IR_Restart();
+  INTCONbits.T0IE = 0;
+  before = mock_delayed_us;
+  CHECK(ADC_GetAverage(ADC_SHORT_IR) == ADC_NOT_READY && ADC_GetAverage(ADC_LONG_IR) == ADC_NOT_READY);
+  CHECK(mock_delayed_us == before);
+  CHECK(IR_Measure() == 0);
+
+  //Nor is there forever if the tick has stopped coming
+  INTCONbits.T0IE = 1; ticking = false;
+  before = mock_delayed_us;
+  CHECK(ADC_GetAverage(ADC_SHORT_IR) == ADC_NOT_READY);
+  CHECK(mock_delayed_us - before <= (unsigned long) ADC_FILL_MS * 1000);
+
+  //A window fills with its channel's readings, no sooner than a full one
+  ticking = true;
+  for(i = 0; i < FILL_TICKS; i++){
+    CHECK(windowLen[ADC_SHORT_IR] < ADC_WINDOW || windowLen[ADC_LONG_IR] < ADC_WINDOW || i >= (FILL_TICKS - 2));
+    tick();
+  }
+  CHECK(windowLen[ADC_SHORT_IR] == ADC_WINDOW && windowLen[ADC_LONG_IR] == ADC_WINDOW);
+  CHECK(ADC_GetAverage(ADC_SHORT_IR) == 300 && ADC_GetAverage(ADC_LONG_IR) == 700);
+
+  //Restarted, the readings before are thrown away, and the wait is within the fill time
+  level[ADC_SHORT_IR] = 500;
+  IR_Restart();
+  CHECK(windowLen[ADC_SHORT_IR] == 0 && windowLen[ADC_LONG_IR] == 0);
+  before = mock_delayed_us;
+  CHECK(ADC_GetAverage(ADC_SHORT_IR) == 500);
+  CHECK(mock_delayed_us > before && mock_delayed_us - before <= (unsigned long) ADC_FILL_MS * 1000);
+  CHECK(ADC_GetAverage(ADC_LONG_IR) == 700);
+
+  //Half the window at a new level moves the average half way, the other channel unchanged
+  level[ADC_SHORT_IR] = 600;
+  for(i = 0; i < (ADC_CHANNELS * ADC_WINDOW); i++)
+    tick(); //Two ticks a reading, so half a window of each channel
+  CHECK(ADC_GetAverage(ADC_SHORT_IR) == 550 && ADC_GetAverage(ADC_LONG_IR) == 700);
+
+  //The channels are converted in turn
+  conversions = alternated;
+  for(i = 0; i < FILL_TICKS; i++)
+    tick();
+  CHECK(alternated - conversions == (FILL_TICKS / 2));
+}
+
+/*! @brief Measures with the two sensors reading steady levels. */
+static uint16_t measure(uint16_t shortCode, uint16_t longCode){
+  int i;
+
+  level[ADC_SHORT_IR] = shortCode; level[ADC_LONG_IR] = longCode;
+  IR_Restart();
+  for(i = 0; i < FILL_TICKS; i++)
+    tick();
+
+  return IR_Measure();
+}
+
+/*! @brief IR's conversion before the table, from the calibration of each 10cm. */
+static double calcDistance(double ADCdata) {
+  double dist_cm = 0;
+
+  if( ADCdata >= 379 && ADCdata < 510 ){  //20-30
+    dist_cm = ((ADCdata-772)/-13.1);
+  }
+  else if ( ADCdata >= 295 && ADCdata < 379 ){ //30-40
+    dist_cm = ((ADCdata-631)/-8.4);
+  }
+  else if ( ADCdata >= 240 && ADCdata < 295 ){  //40-50
+    dist_cm = ((ADCdata-515)/-5.5);
+  }
+  else if ( ADCdata >= 197 && ADCdata < 240 ){  //50-60
+    dist_cm = ((ADCdata-455)/-4.3);
+  }
+  else if ( ADCdata >= 173 && ADCdata < 197){  //60-70
+    dist_cm = ((ADCdata-341)/-2.4);
+  }
+  else if ( ADCdata >= 153 && ADCdata < 173){  //70-80
+    dist_cm = ((ADCdata-313)/-2);
+  }
+  else if ( ADCdata >= 137 && ADCdata < 153 ){  //80-90
+    dist_cm = ((ADCdata-281)/-1.6);
+  }
+  else if ( ADCdata >= 122 && ADCdata < 137){  //90-100
+    dist_cm = ((ADCdata-272)/-1.5);
+  }
+  else if ( ADCdata >= 108 && ADCdata < 122){  //100-110
+    dist_cm = ((ADCdata-262)/-1.4);
+  }
+  else if ( ADCdata >= 99 && ADCdata < 108 ){ //110-120
+    dist_cm = ((ADCdata - 207)/-0.9);
+  }
+  else if ( ADCdata >= 91 && ADCdata < 99 ){  //120-130
+    dist_cm = ((ADCdata-195)/-0.8);
+  }
+  else if ( ADCdata >= 83 && ADCdata < 91 ){  //130-140
+    dist_cm = ((ADCdata - 195)/-0.8);
+  }
+  else if ( ADCdata >= 78 && ADCdata < 83 ){  //140-150
+    dist_cm = ((ADCdata - 152)/-0.5);
+  }
+  else if (ADCdata >= 0 && ADCdata < 84){
+    dist_cm = 150;
+  }
+
+  return (dist_cm * 10); //Convert to mm before returning
+}
+
+static double elapsed(clock_t start){
+  return ((double) (clock() - start) * 1e9) / CLOCKS_PER_SEC;
+}
+
+int main(void){
+  uint16_t code, shortCode, longCode, shortDist, longDist, dist;
+  double want, sink = 0;
+  long blended = 0;
+  clock_t start;
+  int i;
+
+  mock_delay_hook = delayTicks;
+  INTCONbits.T0IE = 1;
+  CHECK(IR_Init());
+  checkWindows();
+
+  //Every short range code, the long range sensor seeing nothing
+  for(code = 0; code < ADC_CODES; code++){
+    CHECK(fabs(shortDistance(code) - calcDistance(code)) <= 1.0);
+#ifdef IR_LONG_RANGE
+    if(shortDistance(code) < IR_BLEND_NEAR)
+#endif
+      CHECK(measure(code, 0) == shortDistance(code));
+  }
+
+#ifdef IR_LONG_RANGE
+  //Both sensors seeing a wall between 1000 and 1500mm, the long range one trusted more the further it is
+  for(shortCode = 0; shortCode < IR_TABLE_SIZE; shortCode++){
+    shortDist = shortDistance(shortCode);
+    if(shortDist < IR_BLEND_NEAR)
+      continue;
+    for(longCode = IR_LONG_FIRST; longCode < (IR_LONG_FIRST + IR_LONG_SIZE); longCode += 7){
+      longDist = longDistance(longCode);
+      dist = measure(shortCode, longCode);
+      if(shortDist >= IR_BLEND_FAR){
+        CHECK(dist == longDist);
+        continue;
+      }
+
+      want = shortDist + ((double) longDist - shortDist) * (shortDist - IR_BLEND_NEAR) / (IR_BLEND_FAR - IR_BLEND_NEAR);
+      CHECK(fabs(dist - want) <= 1.0);
+      CHECK(dist >= (shortDist < longDist ? shortDist : longDist) && dist <= (shortDist > longDist ? shortDist : longDist));
+      blended++;
+    }
+  }
+  CHECK(blended > 0);
+
+  //Further than the long range sensor can see, or too close for it, only the short range sensor counts
+  CHECK(measure(IR_TABLE_SIZE - 1, IR_LONG_FIRST - 1) == shortDistance(IR_TABLE_SIZE - 1));
+  CHECK(measure(0, IR_LONG_FIRST + IR_LONG_SIZE) == shortDistance(0));
+#else
+  //The long range sensor is not calibrated, so whatever it reads is ignored
+  for(shortCode = 0; shortCode < IR_TABLE_SIZE; shortCode += 3){
+    for(longCode = IR_LONG_FIRST; longCode < (IR_LONG_FIRST + IR_LONG_SIZE); longCode += 7){
+      dist = measure(shortCode, longCode);
+      CHECK(dist == shortDistance(shortCode));
+      blended += (dist != 0);
+    }
+  }
+  CHECK(blended > 0);
+  (void) shortDist; (void) longDist; (void) want;
+#endif
+
+  //A conversion, from the table and with calcDistance
+  start = clock();
+  for(i = 0; i < BENCH_LOOPS; i++){
+    for(code = 0; code < ADC_CODES; code++)
+      sink += shortDistance(code ^ (uint16_t) i);
+  }
+  printf("IR conversion: table %.1f ns", elapsed(start) / ((double) BENCH_LOOPS * ADC_CODES));
+  start = clock();
+  for(i = 0; i < BENCH_LOOPS; i++){
+    for(code = 0; code < ADC_CODES; code++)
+      sink += calcDistance(code ^ (uint16_t) i);
+  }
+  printf(", calcDistance %.1f ns (host)%s\n", elapsed(start) / ((double) BENCH_LOOPS * ADC_CODES), (sink == 42) ? " " : "");
+
+  return TEST_DONE("test_ir");
+}
@@ -0,0 +1,201 @@
+/*! @file test_mission.c
+ *
+ *  @brief Replays the plans of a mission on the course, and checks the flood cache's
+ *         counters (PATH_STATS) after every lap.
+ *
+ *  Laps go round the way-points and home in the order of the maze definition, planning
+ *  and following each route a move at a time as IROBOT_MazeRun does. On the 2nd and 4th
+ *  laps a virtual wall is found on the first move where it leaves every point of the lap
+ *  reachable, and the route is planned again (as errorHandle does).
+ *
+ *  The counters are checked after every lap against what the cache should have done:
+ *
+ *    - While the map has no virtual walls, paths come from the path table (if built with
+ *      it) and nothing is flooded.
+ *    - Otherwise heading for a new point starts a flood, from the cache if the point's
+ *      flood is there (a hit) or from scratch (a miss). The cache holds a flood for every
+ *      other point of a lap, so none is ever pushed out.
+ *    - A wall throws away the floods of the other points it crossed, found with a
+ *      breadth-first search before the wall goes up.
+ *
+ *  The last lap re-drives the one before, so every flood is in the cache and flows no
+ *  further. TEST_ROOMS replays it over ROOMS.h, whose rooms leave room for both walls.
+ *
+ *  @author A.Pope
+ *  @date 17-10-2016
+ */
+#define PATH_STATS
+#define PATH_CACHE_SIZE 6 /* Every other point of a lap */
+#ifdef TEST_ROOMS
+#define PATH_MAZE_FILE "ROOMS.h"
+#endif
+#include "test.h"
+#include "PATH.c"
+
+#define LAP_POINTS (MAZE_NUM_WAYPOINTS + 1) /* The way-points, then home, as in IROBOT */
+#define LAPS       6
+
+#if (PATH_CACHE_SIZE < MAZE_NUM_WAYPOINTS)
+#error "test_mission needs a cache entry for every other point of a lap"
+#endif
+
+static TORDINATE lapList[LAP_POINTS];
+static TPATH_DIST truth[MAP_CELLS]; /*< Boxes from each box to a point, -1 if there is no way */
+static TBOX queue[MAP_CELLS];
+static uint8_t failed;              /*< Plans that found no route */
+static uint8_t walls;               /*< Virtual walls found */
+static uint8_t dropped;             /*< Floods the walls crossed */
+
+/* What the cache should have done */
+static bool tableUsed;              /*< TRUE while paths come from the path table */
+static bool held[LAP_POINTS];       /*< Points whose floods are kept */
+static uint8_t current;             /*< Point of the current flood, LAP_POINTS if none */
+static TPATH_STATS expected;        /*< Counters, as they should be */
+/*! @brief Breadth-first search out from a box, over the same walls PATH sees.
+ *
+ *  @param cutA, cutB - Boxes to search as if there was a wall between them
+ */
+static void search(TBOX goal, TBOX cutA, TBOX cutB){
+  TBOX box, next;
+  uint32_t head = 0, tail = 0;
+  uint8_t dir;
+
+  for(box = 0; box < MAP_CELLS; box++)
+    truth[box] = -1;
+  truth[goal] = 0;
+  queue[tail++] = goal;
+
+  while(head < tail){
+    box = queue[head++];
+    for(dir = 0; dir < 4; dir++){
+      if(!openNeighbour(box, dir, &next) || (box == cutA && next == cutB) || (box == cutB && next == cutA))
+        continue;
+      if(truth[next] == -1){
+        truth[next] = truth[box] + 1;
+        queue[tail++] = next;
+      }
+    }
+  }
+}
+
+/*! @brief Checks a wall in front of the robot would leave every point of the lap reachable. */
+static bool wallAllowed(TORDINATE ord){
+  TBOX box = BOX_INDEX(ord.x, ord.y), next;
+  uint8_t i;
+
+  openNeighbour(box, rotationFactor, &next);
+  search(BOX_INDEX(lapList[0].x, lapList[0].y), box, next);
+  for(i = 0; i < LAP_POINTS; i++){
+    if(truth[BOX_INDEX(lapList[i].x, lapList[i].y)] == -1)
+      return false;
+  }
+
+  return true;
+}
+
+/*! @brief Notes a plan to a point of the lap, as the cache should handle it. */
+static void expectPlan(uint8_t point){
+  if(tableUsed || point == current)
+    return; //From the table, or the flood is carried on
+
+  if(held[point])
+    expected.hits++;
+  else
+    expected.misses++;
+  held[point] = true;
+  current = point;
+}
+
+/*! @brief Finds a virtual wall in front of the robot, throwing away the expected floods
+ *         of the other points whose shortest paths ran through it first.
+ */
+static void findWall(TORDINATE ord, uint8_t point){
+  TBOX box = BOX_INDEX(ord.x, ord.y), next;
+  uint8_t i;
+
+  openNeighbour(box, rotationFactor, &next);
+  for(i = 0; i < LAP_POINTS; i++){
+    if(i == point || !held[i])
+      continue; //The flood headed for is repaired
+
+    search(BOX_INDEX(lapList[i].x, lapList[i].y), MAP_CELLS, MAP_CELLS);
+    if(truth[box] != -1 && truth[next] != -1 && (truth[box] == (truth[next] + 1) || truth[next] == (truth[box] + 1))){
+      held[i] = false;
+      dropped++;
+    }
+  }
+
+  if(tableUsed){
+    tableUsed = false;
+    current = LAP_POINTS; //Nothing was flooded while paths came from the table
+  }
+  walls++;
+  PATH_VirtWallFoundAt(ord);
+}
+
+/*! @brief Plans to a point of the lap and follows the route there, as IROBOT_MazeRun does.
+ *
+ *  @param wall - TRUE to find a virtual wall on the first move it can be, cleared once found
+ */
+static void driveTo(TORDINATE * ord, uint8_t point, bool * wall){
+  TTURN turn; TORDINATE next;
+
+  expectPlan(point);
+  if(!PATH_Plan(*ord, lapList[point])){
+    failed++;
+    return; //IROBOT moves on to the next way-point
+  }
+
+  while(PATH_NextMove(*ord, rotationFactor, &turn, &next)){
+    rotationFactor = (rotationFactor + turn) % 4;
+    if(*wall && wallAllowed(*ord)){
+      *wall = false;
+      findWall(*ord, point);
+      expectPlan(point);
+      if(!PATH_Plan(*ord, lapList[point])){
+        failed++;
+        return;
+      }
+      continue;
+    }
+    *ord = next;
+  }
+}
+
+int main(void){
+  static const TORDINATE wayPoints[MAZE_NUM_WAYPOINTS] = MAZE_WAYPOINTS;
+  TORDINATE ord = MAZE_HOME;
+  TPATH_STATS stats;
+  uint32_t flowed = 0;
+  uint8_t i, n;
+  bool wall;
+
+  for(i = 0; i < MAZE_NUM_WAYPOINTS; i++)
+    lapList[i] = wayPoints[i];
+  lapList[MAZE_NUM_WAYPOINTS] = ord;
+  PATH_Init();
+#ifndef PATH_NO_HOPS
+  tableUsed = hopsValid;
+  CHECK(tableUsed); //The course comes with its table
+#endif
+  current = LAP_POINTS;
+
+  for(n = 1; n <= LAPS; n++){
+    wall = (n == 2 || n == 4);
+    for(i = 0; i < LAP_POINTS; i++)
+      driveTo(&ord, i, &wall);
+
+    PATH_GetStats(&stats);
+    CHECK(stats.hits == expected.hits && stats.misses == expected.misses);
+    if(n == LAPS)
+      CHECK(stats.flowed == flowed); //Every flood had already reached where it is planned from
+    flowed = stats.flowed;
+  }
+
+  CHECK(walls > 0 && failed == 0);
+  CHECK(expected.hits > 0);
+#ifdef TEST_ROOMS
+  CHECK(walls == 2 && dropped > 0); //There is room for the second wall to cross the cached floods
+#endif
+  return TEST_DONE("test_mission");
+}
@@ -0,0 +1,577 @@
+/*! @file test_move.c
+ *
+ *  @brief Checks MOVE's sensor stream parser against a simulated Create.
+ *
+ *  The Create's frames are built as the OI streams them (header, byte count, a packet
+ *  id and its data for each packet MOVE_StartStream asks for, then the checksum) and
+ *  put in RCREG byte by byte, as the receive interrupt would. MOVE_StreamRx is run each
+ *  6 bytes, as often as the 1ms tick would at 57600 baud.
+ *
+ *  A frame that is received whole must be taken, with every value it holds. Frames with
+ *  a corrupted checksum, a wrong packet id, or a byte dropped must not be, and the
+ *  parser must get back in step by the next frame (the one after, if a dropped byte made
+ *  it take the next header as a checksum), even starting mid-frame, where the IR byte
+ *  looks like a header. Bytes lost by the USART must drop the frame they were in. Then a
+ *  long stream with random damage is parsed, checking no damaged frame is ever taken
+ *  and no whole frame after a taken one is ever missed.
+ *
+ *  MOVE_WaitFrames is checked with a frame streamed every 15ms of delay, and with the
+ *  stream stopped.
+ *
+ *  The serial traffic of a control loop pass is then counted, with a Create that takes
+ *  the bytes MOVE sends a byte time (174us) apart, answers queries, and drives at the
+ *  speeds it is sent. Before the stream, a pass of MOVE_Straight polled the bump and
+ *  virtual wall and then the distance, as the pass replayed here does. Now MOVE_Straight
+ *  and MOVE_Rotate must take a pass a frame with no bytes sent but drive commands, and
+ *  none received but the stream.
+ *
+ *  Last, MOVE_Straight's profile is driven at several top speeds and distances. The
+ *  Create acts on a drive command at its next 15ms cycle and its wheels change speed
+ *  at no more than CREATE_ACCEL. The fastest it drives must be no more than the table
+ *  allows over the distance (and reach that on long moves), it must never be more than
+ *  BRAKE_SLACK short of the distance it needs to brake in, and it must stop no more
+ *  than OVERSHOOT past the distance.
+ *
+ *  @author A.Pope
+ *  @date 17-10-2016
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "test.h"
+#include "USART.c"
+#include "POSE.c"
+#include "MOVE.c"
+
+#define FRAME_LEN   (FRAME_BYTES + 3) /* Header, byte count, body and checksum */
+#define TICK_BYTES  6                 /* Bytes received between 1ms ticks at 57600 baud */
+#define FUZZ_FRAMES 5000
+#define BYTE_US     174  /* Time a byte takes at 57600 baud (us) */
+#define WHEEL_BASE  258  /* Between the Create's wheels (mm) */
+#define PI          3.14159265358979323846
+#define POLL_PASSES 200
+#define CREATE_ACCEL 500 /* Fastest the wheels speed up or slow down (mm/s^2), as the profile allows for */
+#define BRAKE_SLACK 16   /* Most a move may be short of the distance to stop in (mm), an entry of the profile */
+#define OVERSHOOT   10   /* Furthest a move may go past its distance (mm) */
+
+typedef struct {
+  uint8_t bump, wall, ir, song;
+  int16_t dist, angle;
+} TFRAME; /* Sensor values the Create streams */
+
+static uint8_t tickBytes; /*< Bytes received since the last tick */
+static bool delayStreams; /*< TRUE while delays stream frames */
+static unsigned long streamUs; /*< Delay not yet made up into a frame */
+static TFRAME delayFrame; /*< The frame delays stream */
+
+/* The Create, for the traffic */
+static uint8_t cmd[10], cmdLen;   /*< Command being received */
+static uint8_t reply[4], replyLen, replyPos; /*< Answer to the last query, and how much has been sent */
+static int16_t leftDrive, rightDrive; /*< Wheel speeds (mm/s) last sent, acted on at the next 15ms cycle */
+static int16_t leftWant, rightWant;   /*< Wheel speeds (mm/s) being acted on */
+static double leftSpeed, rightSpeed;  /*< Wheel speeds (mm/s), getting to those wanted at CREATE_ACCEL */
+static double odometer;               /*< Distance (mm) the Create has truly driven */
+static double peakSpeed;              /*< Fastest it has driven (mm/s) */
+static double moveTo;                 /*< Distance (mm) of the move being driven, 0 if none */
+static double shortBy;                /*< Most the move has been short of the distance it needs to stop in (mm) */
+static double unreported[2];      /*< Distance (mm) and angle (deg) not reported yet */
+static bool createStreams;        /*< TRUE once the Create streams frames */
+static unsigned long createUs;    /*< Time not yet made up into a byte time */
+static unsigned long frameUs;     /*< Time since the last 15ms cycle */
+static long sentBytes;            /*< Bytes received by the Create, other than drive commands */
+static long repliedBytes;         /*< Bytes sent by the Create, other than the stream */
+static long roundTrips;           /*< Queries it answered */
+static long driveCmds;
+static long framesSent;
+
+/*! @brief Builds a frame as the Create streams it. */
+static void makeFrame(const TFRAME * f, uint8_t * out){
+  uint8_t i, sum = 0;
+
+  out[0] = OP_STREAM_HEADER; out[1] = FRAME_BYTES;
+  out[2 + FRAME_BUMP] = OP_SENS_BUMP;     out[3 + FRAME_BUMP] = f->bump;
+  out[2 + FRAME_VWALL] = OP_SENS_VWALL;   out[3 + FRAME_VWALL] = f->wall;
+  out[2 + FRAME_IR] = OP_SENS_IR;         out[3 + FRAME_IR] = f->ir;
+  out[2 + FRAME_DIST] = OP_SENS_DIST;     out[3 + FRAME_DIST] = (uint8_t) (f->dist >> 8);  out[4 + FRAME_DIST] = (uint8_t) f->dist;
+  out[2 + FRAME_ANGLE] = OP_SENS_ANGLE;   out[3 + FRAME_ANGLE] = (uint8_t) (f->angle >> 8); out[4 + FRAME_ANGLE] = (uint8_t) f->angle;
+  out[2 + FRAME_SONG] = OP_SONG_PLAYING;  out[3 + FRAME_SONG] = f->song;
+  for(i = 0; i < (FRAME_LEN - 1); i++)
+    sum += out[i];
+  out[FRAME_LEN - 1] = (uint8_t) -sum;
+}
+
+/*! @brief The receive interrupt, with the tick every TICK_BYTES bytes. */
+static void receive(uint8_t data){
+  RCREG = data;
+  USART_RxTick();
+  if(++tickBytes == TICK_BYTES){
+    tickBytes = 0;
+    MOVE_StreamRx();
+  }
+}
+
+static void send(const uint8_t * bytes, uint8_t len){
+  while(len--)
+    receive(*bytes++);
+}
+
+/*! @brief The tick after the last bytes received. */
+static void tick(void){
+  tickBytes = 0;
+  MOVE_StreamRx();
+}
+
+static void sendFrame(const TFRAME * f){
+  uint8_t bytes[FRAME_LEN];
+
+  makeFrame(f, bytes);
+  send(bytes, FRAME_LEN);
+  tick();
+}
+
+/*! @brief Checks a frame's values are the latest, taking the distance and angle. */
+static bool taken(const TFRAME * f){
+  TMOVE_SNAPSHOT snap;
+  TSENSORS sens;
+
+  MOVE_Snapshot(&snap, &sens);
+  return (snap.ir == f->ir && snap.dist == f->dist && snap.angle == f->angle && MOVE_GetIR() == f->ir
+          && sens.bump == ((f->bump & 0b00000011) != 0) && sens.wall == (f->wall != 0) && MOVE_IsSongPlaying() == (f->song != 0));
+}
+
+/*! @brief Streams delayFrame every 15ms of delay, while streaming. */
+static void streamDelay(unsigned long us){
+  for(streamUs += us; streamUs >= (FRAME_MS * 1000UL); streamUs -= (FRAME_MS * 1000UL)){
+    if(delayStreams)
+      sendFrame(&delayFrame);
+  }
+}
+
+/*! @brief The Create takes its part of the distance and angle moved not yet reported. */
+static int16_t report(uint8_t which){
+  int16_t value = (int16_t) lround(unreported[which]);
+
+  unreported[which] -= value;
+  return value;
+}
+
+/*! @brief The Create receives a byte, acting on each command once it is whole. */
+static void createByte(uint8_t data){
+  uint8_t need, i;
+
+  cmd[cmdLen++] = data;
+  switch(cmd[0]){
+    case OP_DRIVE_DIRECT: need = 5; break;
+    case OP_SENSORS: need = 2; break;
+    case OP_QUERY: case OP_STREAM: need = (cmdLen < 2) ? 2 : (2 + cmd[1]); break;
+    default: need = 1; break;
+  }
+  if(cmdLen < need)
+    return;
+
+  switch(cmd[0]){
+    case OP_DRIVE_DIRECT:
+      rightDrive = (int16_t) ((cmd[1] << 8) | cmd[2]);
+      leftDrive = (int16_t) ((cmd[3] << 8) | cmd[4]);
+      driveCmds++;
+      break;
+    case OP_SENSORS: //Distance or angle, 2 bytes
+      i = report(cmd[1] == OP_SENS_ANGLE);
+      reply[0] = (uint8_t) ((int16_t) i >> 8); reply[1] = i;
+      replyLen = 2; replyPos = 0; roundTrips++;
+      break;
+    case OP_QUERY: //Bump and virtual wall, a byte each
+      replyLen = cmd[1]; replyPos = 0; roundTrips++;
+      memset(reply, 0, sizeof(reply));
+      break;
+    case OP_STREAM:
+      createStreams = true;
+      break;
+  }
+  if(cmd[0] != OP_DRIVE_DIRECT)
+    sentBytes += cmdLen;
+  cmdLen = 0;
+}
+
+/*! @brief Notes how far short the move is of the distance the Create needs to stop in,
+ *         braking at CREATE_ACCEL once 30ms have passed, as the profile allows for.
+ */
+static void stopCheck(void){
+  double v = fabs(leftSpeed + rightSpeed) / 2;
+  double need = (v * 0.03) + ((v * v) / (2.0 * CREATE_ACCEL));
+
+  if(v > PROFILE_MIN_SPEED && (need - (moveTo - fabs(odometer))) > shortBy)
+    shortBy = need - (moveTo - fabs(odometer)); //At the finishing speed it crawls in
+}
+
+/*! @brief A wheel's speed a byte time on, getting to the speed wanted at CREATE_ACCEL. */
+static double accelerate(double speed, int16_t want){
+  double step = CREATE_ACCEL * BYTE_US / 1e6;
+
+  if(fabs(want - speed) <= step)
+    return want;
+  return (want > speed) ? (speed + step) : (speed - step);
+}
+
+/*! @brief Time passes for the Create: a byte each way each byte time, and every 15ms it
+ *         acts on the last drive command and streams a frame.
+ */
+static void createDelay(unsigned long us){
+  TFRAME f = { 0, 0, 255, 0, 0, 0 };
+
+  for(createUs += us; createUs >= BYTE_US; createUs -= BYTE_US){
+    leftSpeed = accelerate(leftSpeed, leftWant);
+    rightSpeed = accelerate(rightSpeed, rightWant);
+    odometer += ((leftSpeed + rightSpeed) / 2.0) * BYTE_US / 1e6;
+    if(fabs(leftSpeed + rightSpeed) / 2 > peakSpeed)
+      peakSpeed = fabs(leftSpeed + rightSpeed) / 2;
+    if(moveTo > 0)
+      stopCheck();
+    unreported[0] += ((leftSpeed + rightSpeed) / 2.0) * BYTE_US / 1e6;
+    unreported[1] += ((rightSpeed - leftSpeed) / (double) WHEEL_BASE) * (180 / PI) * BYTE_US / 1e6;
+
+    TXREG = 0;
+    if(PIE1bits.TXIE){
+      USART_TxTick();
+      if(PIE1bits.TXIE)
+        createByte(TXREG);
+    }
+    if(replyPos < replyLen){
+      receive(reply[replyPos++]);
+      repliedBytes++;
+    }
+
+    frameUs += BYTE_US;
+    if(frameUs >= (FRAME_MS * 1000UL)){
+      frameUs -= FRAME_MS * 1000UL;
+      leftWant = leftDrive; rightWant = rightDrive;
+      if(createStreams){
+        f.dist = report(0); f.angle = report(1);
+        sendFrame(&f);
+        framesSent++;
+      }
+    }
+  }
+}
+
+/*! @brief A pass of MOVE_Straight's loop as it was before the stream, polling the bump
+ *         and virtual wall, then the distance.
+ */
+static int16_t pollPass(TSENSORS * sens){
+  uint8_t data = 0, hi = 0, lo = 0;
+
+  USART_OutChar(OP_QUERY); USART_OutChar(2); USART_OutChar(OP_SENS_BUMP); USART_OutChar(OP_SENS_VWALL);
+  CHECK(USART_InChar(&data, 100)); sens->bump = (data & 0b00000011);
+  CHECK(USART_InChar(&data, 100)); sens->wall = data;
+  USART_OutChar(OP_SENSORS); USART_OutChar(OP_SENS_DIST);
+  CHECK(USART_InChar(&hi, 100) && USART_InChar(&lo, 100));
+
+  return (int16_t) ((hi << 8) | lo);
+}
+
+static void clearTraffic(void){
+  sentBytes = 0; repliedBytes = 0; roundTrips = 0; driveCmds = 0; framesSent = 0;
+}
+
+/*! @brief Counts the serial traffic of a control loop pass, polling and from the stream. */
+static void checkTraffic(void){
+  TSENSORS sens;
+  unsigned long before;
+  int16_t movBack = 0, travelled = 0;
+  double pollMs, streamMs;
+  long passes, cmds;
+  int i;
+
+  //Polling, as before the stream
+  mock_delay_hook = createDelay;
+  streaming = false; createStreams = false;
+  MOVE_DirectDrive(200, 200);
+  clearTraffic();
+  before = mock_delayed_us;
+  for(i = 0; i < POLL_PASSES; i++)
+    travelled += pollPass(&sens);
+  pollMs = (mock_delayed_us - before) / (1000.0 * POLL_PASSES);
+  CHECK(sentBytes == (6 * POLL_PASSES) && repliedBytes == (4 * POLL_PASSES) && roundTrips == (2 * POLL_PASSES));
+  CHECK(travelled > 0 && !sens.bump && !sens.wall);
+  printf("Per control pass: polling %ld bytes out, %ld in, %ld round trips, %.1f ms;", sentBytes / POLL_PASSES,
+         repliedBytes / POLL_PASSES, roundTrips / POLL_PASSES, pollMs);
+  MOVE_DirectDrive(0, 0);
+  createDelay(BYTE_US * 10);
+
+  //From the stream, a metre straight then a quarter turn
+  MOVE_StartStream();
+  createDelay(BYTE_US * 10);
+  CHECK(createStreams);
+  clearTraffic();
+  before = mock_delayed_us;
+  CHECK(!MOVE_Straight(300, 1000, true, &sens, &movBack));
+  CHECK(!MOVE_Rotate(200, 90, DIR_CCW, &sens));
+  passes = framesSent; //A pass a frame
+  streamMs = (mock_delayed_us - before) / (1000.0 * passes);
+  cmds = driveCmds;
+  CHECK(sentBytes == 0 && repliedBytes == 0 && roundTrips == 0);
+  CHECK(passes > 0 && fabs(streamMs - FRAME_MS) < 1);
+  CHECK(cmds < (passes / 2));
+
+  printf(" stream 0 bytes out (and %ld drive commands in %ld passes), 0 in, 0 round trips, %.1f ms\n",
+         cmds, passes, streamMs);
+  mock_delay_hook = NULL;
+}
+
+/*! @brief Fastest MOVE_Straight may drive over a distance: the most, at any point along it,
+ *         of the lesser of the table's speeds for the distance travelled and to go.
+ */
+static int16_t profileBound(int16_t top, int16_t distance){
+  uint16_t up, down, best = PROFILE_MIN_SPEED, speed;
+  int16_t x;
+
+  for(x = 0; x <= distance; x++){
+    up = (x >> PROFILE_SHIFT) + PROFILE_START;
+    down = (distance - x) >> PROFILE_SHIFT;
+    speed = top;
+    if(up < PROFILE_STEPS && StraightProfile[up] < speed)
+      speed = StraightProfile[up];
+    if(down < PROFILE_STEPS && StraightProfile[down] < speed)
+      speed = StraightProfile[down];
+    if(speed > best)
+      best = speed;
+  }
+
+  return (best < top) ? best : top;
+}
+
+/*! @brief Drives MOVE_Straight's profile on the Create, checking the peak speed against the
+ *         table, the distance left to stop in, and how far past the distance it stops.
+ */
+static void checkStraight(void){
+  static const int16_t tops[] = { 150, 300, 500 };
+  static const int16_t distances[] = { 100, 250, 500, 1000, 2000 };
+  TSENSORS sens;
+  int16_t movBack = 0, bound;
+  double over, worstOver = 0, worstShort = 0;
+  uint8_t t, d;
+
+  mock_delay_hook = createDelay;
+  for(t = 0; t < (sizeof(tops) / sizeof(tops[0])); t++){
+    printf("MOVE_Straight at %d mm/s, peak (bound) and overshoot:", tops[t]);
+    for(d = 0; d < (sizeof(distances) / sizeof(distances[0])); d++){
+      odometer = 0; peakSpeed = 0; shortBy = 0;
+      moveTo = distances[d];
+      CHECK(!MOVE_Straight(((d % 2) ? -tops[t] : tops[t]), distances[d], true, &sens, &movBack)); //Backwards too
+      while(PIE1bits.TXIE || leftDrive != leftWant || rightDrive != rightWant || leftSpeed != 0 || rightSpeed != 0)
+        createDelay(BYTE_US); //Until the stop is acted on and the wheels have stopped
+      moveTo = 0;
+      createDelay(FRAME_MS * 2000UL); //The last of the distance streamed
+      CHECK(movBack == 0);
+
+      bound = profileBound(tops[t], distances[d]);
+      over = fabs(odometer) - distances[d];
+      CHECK(peakSpeed <= bound);
+      if(distances[d] >= 1000)
+        CHECK(peakSpeed >= bound - 1); //Long enough to get up to it
+      CHECK(over >= 0 && over <= OVERSHOOT);
+      CHECK(shortBy <= BRAKE_SLACK);
+      printf(" %d mm %.0f (%d) %+.1f mm;", distances[d], peakSpeed, bound, over);
+      if(over > worstOver)
+        worstOver = over;
+      if(shortBy > worstShort)
+        worstShort = shortBy;
+    }
+    printf("\n");
+  }
+  printf("MOVE_Straight: at most %.1f mm past the distance, %.1f mm short of the distance to stop in\n", worstOver, worstShort);
+  mock_delay_hook = NULL;
+}
+
+static void checkStart(void){
+  static const uint8_t request[] = {OP_STREAM, 6, OP_SENS_BUMP, OP_SENS_VWALL, OP_SENS_IR,
+                                    OP_SENS_DIST, OP_SENS_ANGLE, OP_SONG_PLAYING};
+  TFRAME f = { 0, 0, 1, 0, 10, 0 };
+  uint8_t i;
+
+  //Nothing is parsed before the stream is asked for
+  sendFrame(&f);
+  CHECK(MOVE_FrameCount() == 0);
+  MOVE_StartStream();
+  for(i = 0; i < sizeof(request); i++){
+    CHECK(PIE1bits.TXIE);
+    USART_TxTick();
+    CHECK(TXREG == request[i]);
+  }
+  USART_TxTick();
+  CHECK(!PIE1bits.TXIE);
+}
+
+/*! @brief Single frames, whole and damaged. */
+static void checkFrames(void){
+  TFRAME good = { 0b00000001, 0, OP_STREAM_HEADER, 1, 300, -90 }; /* The IR byte looks like a header */
+  TFRAME next = { 0, 1, 246, 0, -3, 2 };
+  uint8_t bytes[FRAME_LEN], count = MOVE_FrameCount(), i;
+
+  //A frame received whole is taken, and its distance and angle added up until read
+  sendFrame(&good);
+  CHECK(MOVE_FrameCount() == (uint8_t) (count + 1));
+  CHECK(taken(&good));
+  sendFrame(&next); sendFrame(&next);
+  next.dist *= 2; next.angle *= 2;
+  CHECK(taken(&next));
+  next.dist /= 2; next.angle /= 2;
+  count = MOVE_FrameCount();
+
+  //A corrupted checksum, or any other byte, drops the frame, and the parser is back in
+  //step for the next (with the header or count hit, past the look-alike in the frame)
+  for(i = 0; i < FRAME_LEN; i++){
+    makeFrame(&good, bytes);
+    bytes[i] ^= 0x20;
+    send(bytes, FRAME_LEN); tick();
+    CHECK(MOVE_FrameCount() == count);
+    sendFrame(&next);
+    CHECK(MOVE_FrameCount() == (uint8_t) (count + 1) && taken(&next));
+    count = MOVE_FrameCount();
+  }
+
+  //A wrong packet id drops the frame, even with the checksum right
+  makeFrame(&good, bytes);
+  bytes[2 + FRAME_IR] = OP_SENS_WALL;
+  bytes[FRAME_LEN - 1] -= (OP_SENS_WALL - OP_SENS_IR);
+  send(bytes, FRAME_LEN); tick();
+  CHECK(MOVE_FrameCount() == count && MOVE_GetIR() == next.ir);
+  sendFrame(&next);
+  CHECK(MOVE_FrameCount() == (uint8_t) (count + 1) && taken(&next));
+  count = MOVE_FrameCount();
+
+  //A byte dropped anywhere loses the frame, and may take the next one's header as its
+  //checksum, but the one after is taken
+  for(i = 0; i < FRAME_LEN; i++){
+    makeFrame(&good, bytes);
+    send(bytes, i); send(&bytes[i + 1], FRAME_LEN - 1 - i);
+    sendFrame(&next);
+    sendFrame(&next);
+    CHECK((uint8_t) (MOVE_FrameCount() - count) >= 1 && (uint8_t) (MOVE_FrameCount() - count) <= 2);
+    next.dist *= (MOVE_FrameCount() - count); next.angle *= (MOVE_FrameCount() - count);
+    CHECK(taken(&next));
+    next.dist = -3; next.angle = 2;
+    count = MOVE_FrameCount();
+  }
+
+  //Starting mid-frame, from each byte (the look-alike included), the next frame is taken
+  for(i = 1; i < FRAME_LEN; i++){
+    makeFrame(&good, bytes);
+    send(&bytes[i], FRAME_LEN - i);
+    sendFrame(&good);
+    CHECK(MOVE_FrameCount() == (uint8_t) (count + 1) && taken(&good));
+    count = MOVE_FrameCount();
+  }
+}
+
+/*! @brief Bytes lost by the USART drop the frame they were in. */
+static void checkLost(void){
+  TFRAME f = { 0, 0, 7, 0, 5, 1 };
+  uint8_t bytes[FRAME_LEN], count = MOVE_FrameCount(), i;
+
+  CHECK(!MOVE_StreamLost());
+  makeFrame(&f, bytes);
+  for(i = 0; i < FRAME_LEN; i++){
+    RCREG = bytes[i];
+    USART_RxTick(); //No tick for the whole frame, the receive buffer fills
+  }
+  tick();
+  CHECK(MOVE_FrameCount() == count);
+  CHECK(MOVE_StreamLost() && !MOVE_StreamLost());
+
+  sendFrame(&f);
+  CHECK(MOVE_FrameCount() == (uint8_t) (count + 1) && taken(&f));
+}
+
+/*! @brief A long stream with random damage. */
+static void checkFuzz(void){
+  TFRAME f;
+  uint8_t frameBytes[FRAME_LEN], bytes[FRAME_LEN + 1], count, i, len;
+  bool whole, lastTaken = true;
+  long intact = 0, took = 0, damaged = 0;
+  int n;
+
+  srand(1);
+  for(n = 0; n < FUZZ_FRAMES; n++){
+    f.bump = rand(); f.wall = rand() & 1; f.ir = rand(); f.song = rand() & 1;
+    f.dist = (rand() % 1000) - 500; f.angle = (rand() % 360) - 180;
+    makeFrame(&f, frameBytes);
+    memcpy(bytes, frameBytes, FRAME_LEN);
+    len = FRAME_LEN;
+    if((rand() % 4) == 0){
+      i = rand() % FRAME_LEN;
+      switch(rand() % 4){
+        case 0: bytes[i] ^= (1 << (rand() % 8)); break;                                    //A bit flipped
+        case 1: for(; i < (FRAME_LEN - 1); i++) bytes[i] = bytes[i + 1]; len--; break;     //A byte dropped
+        case 2: for(len = FRAME_LEN; len > i; len--) bytes[len] = bytes[len - 1];
+                bytes[i] = rand(); len = FRAME_LEN + 1; break;                             //A byte inserted
+        default: len = i; break;                                                           //Cut short
+      }
+    }
+    //A byte put before the frame, or one that matches the byte it pushed on, leaves it whole
+    whole = (len >= FRAME_LEN) && (!memcmp(bytes, frameBytes, FRAME_LEN) || !memcmp(&bytes[1], frameBytes, FRAME_LEN));
+
+    count = MOVE_FrameCount();
+    send(bytes, len); tick();
+    if(MOVE_FrameCount() != count){
+      CHECK(whole && MOVE_FrameCount() == (uint8_t) (count + 1)); //Only ever the frame just sent
+      CHECK(taken(&f));
+      took++;
+    } else {
+      CHECK(!whole || !lastTaken); //A whole frame is missed only while getting back in step
+    }
+    lastTaken = (MOVE_FrameCount() != count);
+    intact += whole;
+    damaged += !whole;
+  }
+  CHECK((intact - took) <= damaged); //No more than a whole frame missed for each damaged one
+  printf("Stream: %ld of %ld whole frames taken, none of %ld damaged\n", took, intact, damaged);
+}
+
+static void checkWait(void){
+  unsigned long before;
+  uint8_t count;
+  int i;
+
+  delayFrame.ir = 42;
+  mock_delay_hook = streamDelay;
+  delayStreams = true;
+
+  //Frames come every 15ms, the wait is no longer than it takes for them
+  for(i = 0; i < 300; i++){ //Over the count wrapping
+    count = MOVE_FrameCount();
+    before = mock_delayed_us;
+    CHECK(MOVE_WaitFrames(count, (i % 3) + 1));
+    CHECK((uint8_t) (MOVE_FrameCount() - count) == ((i % 3) + 1));
+    CHECK(mock_delayed_us - before <= (unsigned long) (((i % 3) + 1) * FRAME_MS * 1000));
+  }
+  CHECK(MOVE_GetIR() == 42);
+
+  //Already there, no wait
+  count = MOVE_FrameCount() - 1;
+  before = mock_delayed_us;
+  CHECK(MOVE_WaitFrames(count, 1) && mock_delayed_us == before);
+
+  //The stream has stopped, give up after a few frame times
+  delayStreams = false;
+  count = MOVE_FrameCount();
+  before = mock_delayed_us;
+  CHECK(!MOVE_WaitFrames(count, 2));
+  CHECK(mock_delayed_us - before <= (unsigned long) ((2 + FRAME_SLACK) * FRAME_MS * 1000));
+  mock_delay_hook = NULL;
+}
+
+int main(void){
+  CHECK(USART_Init() && POSE_Init() && MOVE_Init());
+  INTCONbits.T0IE = 1;
+
+  checkStart();
+  checkFrames();
+  checkLost();
+  checkFuzz();
+  checkWait();
+  checkTraffic();
+  checkStraight();
+
+  return TEST_DONE("test_move");
+}
@@ -0,0 +1,375 @@
+/*! @file test_path.c
+ *
+ *  @brief Checks the PATH planner against a plain breadth-first search.
+ *
+ *  Every pair of boxes on the course is planned, then random virtual walls are added
+ *  one at a time and the plans checked again after each. Every route must be possible
+ *  to drive (no wall crossed, it ends at the way-point), and must be as short as the
+ *  search's unless the mode plans something else (PATH_HIERARCHY). With PATH_TURNS it
+ *  must also spend no longer turning than the quickest of the search's shortest routes.
+ *  Built once for each planner mode by the Makefile.
+ *
+ *  TEST_ROOMS plans PATH_HIERARCHY over the rooms of ROOMS.h instead, in clusters small
+ *  enough that the virtual walls split the open stretches of their borders, and with few
+ *  enough entrance paths that the pool has to be packed again.
+ *
+ *  TEST_TALL plans PATH_BITBOARD over TALL.h, which is too high for a row of boxes to
+ *  fit in one word.
+ *
+ *  TEST_TURNS plans PATH_TURNS over ROOMS.h, whose open rooms have many shortest routes
+ *  that turn more or less.
+ *
+ *  TEST_EXPLORE then explores an unknown copy of the course, as IROBOT_Explore does: the
+ *  robot scans each box it enters for sides not yet explored, heads for the box
+ *  PATH_NextFrontier picks, and moves a box at a time, planning again after each. It is
+ *  done again with random walls added to the course, some cutting parts of it off. The
+ *  robot must never drive through a wall, and must only visit boxes it can reach. Each
+ *  box it heads for must be one of the nearest with sides left to explore. When nothing
+ *  is left, every side of every box it can reach must be known, and must match the
+ *  course.
+ *
+ *  @author A.Pope
+ *  @date 17-10-2016
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#ifdef TEST_ROOMS
+#define PATH_HIERARCHY
+#define PATH_CLUSTER    4
+#define PATH_INTRA_POOL 160
+#define PATH_MAZE_FILE  "ROOMS.h"
+#endif
+#ifdef TEST_TURNS
+#define PATH_TURNS
+#define PATH_MAZE_FILE  "ROOMS.h"
+#endif
+#ifdef TEST_TALL
+#define PATH_BITBOARD
+#define PATH_NO_HOPS
+#define PATH_MAZE_FILE  "TALL.h"
+#endif
+#include "PATH.c"
+
+#ifndef PATH_HIERARCHY
+#define SHORTEST /* Every route is one of the shortest */
+#endif
+
+#define TRIALS 200 /* Sequences of virtual walls */
+#define WALLS  12  /* Virtual walls added in each */
+#define EXPLORE_TRIALS 100 /* Courses explored, with random walls added to all but the first */
+#define EXPLORE_WALLS  10  /* Most walls added to a course */
+
+#ifndef PATH_COMPACT
+static uint8_t surveyed[MAP_WIDTH][MAP_HEIGHT]; /*< Map as built, before any virtual walls */
+#endif
+static TPATH_DIST truth[MAP_CELLS]; /*< Boxes from each box to the goal, -1 if there is no way */
+static TBOX queue[MAP_CELLS];
+#ifdef TEST_EXPLORE
+static uint8_t world[MAP_WIDTH][MAP_HEIGHT]; /*< Walls of the course being explored */
+static bool reachable[MAP_CELLS];            /*< Boxes the robot can get to on it */
+static bool visited[MAP_CELLS];
+#endif
+#ifdef PATH_TURNS
+static long turning[MAP_CELLS][4]; /*< Least time turning from each box to the goal, facing each map direction */
+static long walkTurning;           /*< Time spent turning on the last walk */
+#endif
+
+/*! @brief Breadth-first search out from the goal, over the same walls PATH sees. */
+static void search(TBOX goal){
+  TBOX box, next;
+  uint32_t head = 0, tail = 0;
+  uint8_t dir;
+
+  for(box = 0; box < MAP_CELLS; box++)
+    truth[box] = -1;
+  truth[goal] = 0;
+  queue[tail++] = goal;
+
+  while(head < tail){
+    box = queue[head++];
+    for(dir = 0; dir < 4; dir++){
+      if(openNeighbour(box, dir, &next) && truth[next] == -1){
+        truth[next] = truth[box] + 1;
+        queue[tail++] = next;
+      }
+    }
+  }
+}
+
+#ifdef PATH_TURNS
+/*! @brief Works out turning from the search, over the shortest routes only, nearest boxes first. */
+static void searchTurns(void){
+  TPATH_DIST dist, far = 0;
+  TBOX box, next;
+  uint8_t face, dir;
+  long time;
+
+  for(box = 0; box < MAP_CELLS; box++)
+    if(truth[box] > far)
+      far = truth[box];
+
+  for(dist = 0; dist <= far; dist++){
+    for(box = 0; box < MAP_CELLS; box++){
+      if(truth[box] != dist)
+        continue;
+
+      for(face = 0; face < 4; face++){
+        turning[box][face] = (dist == 0) ? 0 : -1;
+        for(dir = 0; dir < 4; dir++){
+          if(!openNeighbour(box, dir, &next) || truth[next] != (dist - 1))
+            continue;
+
+          time = turnTime(face, dir) + turning[next][dir];
+          if(turning[box][face] == -1 || time < turning[box][face])
+            turning[box][face] = time;
+        }
+      }
+    }
+  }
+}
+#endif
+
+/*! @brief Drives the last plan from a box a move at a time, as IROBOT does.
+ *
+ *  @return boxes - Length of the route, or -1 if it crossed a wall or never arrived
+ */
+static long walk(TORDINATE ord, TORDINATE goal, uint8_t heading){
+  TTURN turn; TORDINATE next; TBOX reached;
+  long boxes = 0;
+
+#ifdef PATH_TURNS
+  walkTurning = 0;
+#endif
+  while(PATH_NextMove(ord, heading, &turn, &next)){
+#ifdef PATH_TURNS
+    walkTurning += turnTime(heading, (heading + turn) % 4);
+#endif
+    heading = (heading + turn) % 4;
+    if(!openNeighbour(BOX_INDEX(ord.x, ord.y), heading, &reached) || reached != BOX_INDEX(next.x, next.y))
+      return -1; //Drove through a wall
+    ord = next;
+    if(++boxes > (long) MAP_CELLS)
+      return -1; //Going round in circles
+  }
+
+  return (ord.x == goal.x && ord.y == goal.y) ? boxes : -1;
+}
+
+/*! @brief Plans from one box to another and checks the route. */
+static void checkPlan(TORDINATE robot, TORDINATE goal){
+  TSEGMENT segs[MAP_CELLS < 255 ? MAP_CELLS : 255];
+  uint8_t n, i; long boxes, segBoxes = 0;
+  TPATH_DIST best;
+  bool ok;
+
+  search(BOX_INDEX(goal.x, goal.y));
+  best = truth[BOX_INDEX(robot.x, robot.y)];
+  ok = PATH_Plan(robot, goal);
+  CHECK(ok == (best != -1));
+  if(!ok || best == -1)
+    return;
+
+  boxes = walk(robot, goal, rotationFactor);
+  CHECK(boxes != -1);
+#ifdef SHORTEST
+  CHECK(boxes == best);
+  CHECK(PATH_GetPathVal(robot) == best);
+#ifdef PATH_TURNS
+  searchTurns();
+  CHECK(walkTurning == turning[BOX_INDEX(robot.x, robot.y)][rotationFactor]);
+#endif
+#else
+  CHECK(boxes >= best);
+#endif
+
+  //The straight runs add up to the same route
+  n = PATH_GetSegments(robot, segs, sizeof(segs) / sizeof(segs[0]));
+  for(i = 0; i < n; i++)
+    segBoxes += segs[i].boxes;
+  CHECK(n < (sizeof(segs) / sizeof(segs[0])) ? (segBoxes == boxes) : (segBoxes <= boxes));
+}
+
+/*! @brief Takes the map back to the surveyed course, without virtual walls. */
+static void resetMap(void){
+#ifndef PATH_COMPACT
+  memcpy(Map, surveyed, sizeof(Map)); //PATH_COMPACT rebuilds its walls from the course in PATH_Init
+#endif
+  PATH_Init();
+}
+
+static TORDINATE randomBox(void){
+  TORDINATE ord;
+
+  ord.x = rand() % MAP_WIDTH;
+  ord.y = rand() % MAP_HEIGHT;
+  return ord;
+}
+
+#ifdef TEST_EXPLORE
+/*! @brief Scans the sides of a box not explored yet, as IROBOT's scanBox does, seeing the walls of the course. */
+static void scan(TORDINATE ord){
+  uint8_t dir;
+
+  for(dir = 0; dir < 4; dir++){
+    if(!PATH_IsWallKnown(ord, dir))
+      PATH_SetWall(ord, dir, (world[ord.x][ord.y] & (P_FRONT >> dir)) != 0);
+  }
+}
+
+/*! @brief Checks a frontier is one of the nearest boxes with sides left to explore, over the map as explored so far. */
+static bool nearestFrontier(TORDINATE robot, TORDINATE goal){
+  TPATH_DIST nearest = -1;
+  TBOX box;
+
+  search(BOX_INDEX(robot.x, robot.y));
+  for(box = 0; box < MAP_CELLS; box++){
+    if(truth[box] != -1 && KNOWN(box) != PWALLS && (nearest == -1 || truth[box] < nearest))
+      nearest = truth[box];
+  }
+
+  return (KNOWN(BOX_INDEX(goal.x, goal.y)) != PWALLS && truth[BOX_INDEX(goal.x, goal.y)] == nearest);
+}
+
+/*! @brief Explores the course in Map from a box, as IROBOT_Explore does.
+ *
+ *  @return moves - Boxes driven
+ */
+static long explore(TORDINATE robot){
+  TORDINATE goal, next; TTURN turn; TBOX box, reached;
+  TORDINATE ord;
+  long moves = 0;
+
+  //What the robot will find, and what it can get to
+  memcpy(world, Map, sizeof(Map));
+  search(BOX_INDEX(robot.x, robot.y));
+  for(box = 0; box < MAP_CELLS; box++){
+    reachable[box] = (truth[box] != -1);
+    visited[box] = false;
+  }
+
+  CHECK(PATH_ExploreStart());
+  visited[BOX_INDEX(robot.x, robot.y)] = true;
+  scan(robot);
+  while(PATH_NextFrontier(robot, &goal)){
+    CHECK(nearestFrontier(robot, goal));
+    if(!PATH_Plan(robot, goal) || !PATH_NextMove(robot, rotationFactor, &turn, &next)){
+      CHECK(false); //The frontier can always be reached over the map as explored
+      break;
+    }
+    rotationFactor = (rotationFactor + turn) % 4;
+    box = BOX_INDEX(robot.x, robot.y);
+    if(world[robot.x][robot.y] & (P_FRONT >> rotationFactor)){
+      CHECK(false); //Drove through a wall of the course
+      break;
+    }
+    CHECK(openNeighbour(box, rotationFactor, &reached) && reached == BOX_INDEX(next.x, next.y));
+
+    robot = next;
+    visited[BOX_INDEX(robot.x, robot.y)] = true;
+    scan(robot);
+    if(++moves > ((long) MAP_CELLS * MAP_CELLS)){
+      CHECK(false); //Never finishes
+      break;
+    }
+  }
+
+  //Only boxes it can reach are visited, and everything about those is known
+  for(ord.x = 0; ord.x < MAP_WIDTH; ord.x++){
+    for(ord.y = 0; ord.y < MAP_HEIGHT; ord.y++){
+      box = BOX_INDEX(ord.x, ord.y);
+      CHECK(!visited[box] || reachable[box]);
+      if(reachable[box])
+        CHECK(KNOWN(box) == PWALLS && (Map[ord.x][ord.y] & PWALLS) == (world[ord.x][ord.y] & PWALLS));
+    }
+  }
+
+  return moves;
+}
+
+/*! @brief Explores the course, then courses with walls added. */
+static void checkExplore(void){
+  static const TORDINATE home = MAZE_HOME;
+  TORDINATE robot = home, at;
+  TBOX box, next;
+  long moves, boxes, reached, mostMoves = 0, totalMoves = 0;
+  int trial, wall;
+
+  for(trial = 0; trial < EXPLORE_TRIALS; trial++){
+    resetMap();
+    if(trial > 0){
+      for(wall = rand() % (EXPLORE_WALLS + 1); wall > 0; wall--){
+        at = randomBox();
+        rotationFactor = rand() % 4;
+        if(openNeighbour(BOX_INDEX(at.x, at.y), rotationFactor, &next))
+          addWall(at, rotationFactor, true);
+      }
+      robot = randomBox();
+    }
+    rotationFactor = rand() % 4;
+
+    moves = explore(robot);
+    for(box = 0, boxes = 0, reached = 0; box < MAP_CELLS; box++){
+      boxes += visited[box];
+      reached += reachable[box];
+    }
+    if(trial == 0){
+      printf("Explored the course from home: %ld of %ld boxes visited in %ld moves\n", boxes, reached, moves);
+      continue;
+    }
+    if(moves > mostMoves)
+      mostMoves = moves;
+    totalMoves += moves;
+  }
+  printf("Explored %d courses with walls added: %.1f moves on average, at most %ld\n", EXPLORE_TRIALS - 1,
+         (double) totalMoves / (EXPLORE_TRIALS - 1), mostMoves);
+}
+#endif
+
+int main(void){
+  TORDINATE robot, goal, at;
+  TBOX next;
+  int trial, wall;
+
+  srand(1);
+#ifndef PATH_COMPACT
+  memcpy(surveyed, Map, sizeof(Map));
+#endif
+  resetMap();
+
+  //Every pair of boxes on the surveyed map
+  for(robot.x = 0; robot.x < MAP_WIDTH; robot.x++)
+    for(robot.y = 0; robot.y < MAP_HEIGHT; robot.y++)
+      for(goal.x = 0; goal.x < MAP_WIDTH; goal.x++)
+        for(goal.y = 0; goal.y < MAP_HEIGHT; goal.y++){
+          rotationFactor = rand() % 4;
+          checkPlan(robot, goal);
+        }
+
+  //Virtual walls found one at a time, re-planning after each as the robot does
+  for(trial = 0; trial < TRIALS; trial++){
+    resetMap();
+    goal = randomBox();
+    for(wall = 0; wall < WALLS; wall++){
+      robot = randomBox();
+      rotationFactor = rand() % 4;
+      checkPlan(robot, goal);
+      if(rand() % 4 == 0)
+        goal = randomBox(); //Sometimes head for another way-point
+
+      at = randomBox();
+      rotationFactor = rand() % 4;
+      if(openNeighbour(BOX_INDEX(at.x, at.y), rotationFactor, &next))
+        PATH_VirtWallFoundAt(at);
+#ifdef PATH_FLOOD
+      for(next = 0; next < sizeof(floodMark); next++)
+        CHECK(floodMark[next] == 0); //The repair leaves no box marked
+#endif
+    }
+  }
+
+#ifdef TEST_EXPLORE
+  checkExplore();
+#endif
+  return TEST_DONE("test_path");
+}
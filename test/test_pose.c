@@ -0,0 +1,138 @@
+/*! @file test_pose.c
+ *
+ *  @brief Checks POSE's odometry against a simulated iRobot.
+ *
+ *  The simulated Create drives a few courses in floating point and reports whole mm
+ *  and degrees every 15ms stream frame, keeping the remainders as the real one does.
+ *  The pose must stay within a few mm of where it really is, and POSE_GetCell must give
+ *  the box it is really in whenever it is clear of the box's edges.
+ *
+ *  @author A.Pope
+ *  @date 17-10-2016
+ */
+#include <math.h>
+#include "test.h"
+#include "POSE.c"
+
+#define PI       3.14159265358979323846
+#define FRAME_S  0.015 /* Seconds between stream frames */
+#define MAX_ERR  8.0   /* Furthest the pose may drift over a course (mm) */
+
+static double trueX, trueY, trueHead; /*< Where the Create really is (mm, radians CW from Front) */
+static double remDist, remAngle;      /*< Movement not reported yet */
+static double worstErr;               /*< Furthest the pose has been from the truth */
+
+/*! @brief Moves the simulated Create on one frame and reports it to POSE.
+ *
+ *  @param speed - Forward speed (mm/s)
+ *  @param turn - Turn rate (deg/s), CCW positive as the Create reports it
+ */
+static void frame(double speed, double turn){
+  double dist = speed * FRAME_S, angle = turn * FRAME_S;
+  double mid = trueHead - ((angle / 2) * PI / 180), ex, ey, bx, by;
+  int16_t reportDist, reportAngle;
+  TORDINATE ord; TPOSE pose;
+  long cx, cy;
+  bool in;
+
+  trueX -= dist * cos(mid);
+  trueY += dist * sin(mid);
+  trueHead -= angle * PI / 180;
+
+  remDist += dist; remAngle += angle;
+  reportDist = (int16_t) lround(remDist); reportAngle = (int16_t) lround(remAngle);
+  remDist -= reportDist; remAngle -= reportAngle;
+  POSE_Update(reportDist, reportAngle);
+
+  POSE_Get(&pose);
+  ex = (pose.x / 256.0) - trueX; ey = (pose.y / 256.0) - trueY;
+  if(sqrt((ex * ex) + (ey * ey)) > worstErr)
+    worstErr = sqrt((ex * ex) + (ey * ey));
+
+  //Only compare boxes where the drift can't have put the pose over an edge
+  bx = fmod(trueX + 500 + 100000, 1000); by = fmod(trueY + 500 + 100000, 1000);
+  if(bx < (MAX_ERR + 1) || bx > (999 - MAX_ERR) || by < (MAX_ERR + 1) || by > (999 - MAX_ERR))
+    return;
+
+  cx = (long) floor((trueX + 500) / 1000); cy = (long) floor((trueY + 500) / 1000);
+  in = POSE_GetCell(&ord);
+  CHECK(in == (cx >= 0 && cy >= 0 && cx < MAZE_WIDTH && cy < MAZE_HEIGHT));
+  if(in)
+    CHECK(ord.x == cx && ord.y == cy);
+}
+
+/*! @brief Places the simulated Create and the pose in the centre of a box. */
+static void start(TPATH_ORD x, TPATH_ORD y, uint8_t heading){
+  TORDINATE ord;
+
+  ord.x = x; ord.y = y;
+  POSE_Set(ord, heading);
+  trueX = x * 1000.0; trueY = y * 1000.0; trueHead = heading * PI / 2;
+  remDist = remAngle = 0; worstErr = 0;
+}
+
+/*! @brief Drives straight on at a steady speed. */
+static void drive(double mm, double speed){
+  long i;
+
+  for(i = 0; i < (long) ((mm / (speed * FRAME_S)) + 0.5); i++)
+    frame(speed, 0);
+}
+
+/*! @brief Turns on the spot, CW positive as the map counts. */
+static void rotate(double deg, double rate){
+  long i;
+
+  for(i = 0; i < (long) ((fabs(deg) / (rate * FRAME_S)) + 0.5); i++)
+    frame(0, (deg > 0) ? -rate : rate);
+}
+
+/*! @brief Checks the pose ended up where the Create did. */
+static void checkEnd(TPATH_ORD x, TPATH_ORD y, int16_t heading){
+  TORDINATE ord; TPOSE pose;
+
+  POSE_Get(&pose);
+  CHECK(worstErr < MAX_ERR);
+  CHECK(pose.heading == heading);
+  CHECK(POSE_GetCell(&ord) && ord.x == x && ord.y == y);
+}
+
+int main(void){
+  TORDINATE ord;
+  int i;
+
+  POSE_Init();
+
+  //Down the x axis when facing Front, up the y axis when facing Right
+  start(3, 0, 0);
+  drive(3000, 450);
+  checkEnd(0, 0, 0);
+  start(0, 0, 1);
+  drive(3000, 450);
+  checkEnd(0, 3, 90);
+
+  //A lap of the boxes: Front 1, Right 2, Back 1, Left 2
+  start(1, 1, 0);
+  for(i = 0; i < 4; i++){
+    drive((i % 2) ? 2000 : 1000, 450);
+    rotate(90, 120);
+  }
+  checkEnd(1, 1, 0);
+
+  //Turning the other way, and turning while driving
+  start(1, 3, 0);
+  rotate(-90, 120);
+  drive(2000, 300);
+  checkEnd(1, 1, 270);
+  start(3, 3, 0);
+  for(i = 0; i < 600; i++)
+    frame(300, 15);
+  CHECK(worstErr < MAX_ERR);
+
+  //Off the edge of the maze
+  start(0, 0, 0);
+  drive(1000, 300);
+  CHECK(!POSE_GetCell(&ord));
+
+  return TEST_DONE("test_pose");
+}
@@ -0,0 +1,393 @@
+/*! @file test_sm.c
+ *
+ *  @brief Checks SM's stepping, with Timer2, the step pin and the SPI played by the test.
+ *
+ *  Timer2 is simulated from its registers: once TMR2ON is set it interrupts (PR2 + 1)
+ *  counts of 51.2us later, and again each time from then on, with the PR2 the interrupt
+ *  left. Each interrupt calls SM_Tick, as the ISR does. Delays move the simulated time
+ *  on, so SM's waits for Timer2 are made up of interrupts. Each pulse of the step pin is
+ *  recorded with its time, and the direction and step size of the control byte in
+ *  SSPBUF.
+ *
+ *  Moves are checked to step at the periods of the ramp, speeding up then slowing down
+ *  symmetrically, in half-steps and full-steps, and to turn the SM off once done. Queued
+ *  moves are checked to wait for room and to run in order, and SM_MoveTo to take the
+ *  shorter way round.
+ *
+ *  The step timing model checks the speed of every step along the ramp against the
+ *  profile SM.c says the table was made from: 257 deg/s (3.5ms a half-step, as the
+ *  start-up torque was measured to need), speeding up at 10000 deg/s^2 to 1030 deg/s,
+ *  each wait within rounding of a Timer2 count. It then times turns of 45, 90 and 180
+ *  degrees, which must take no more than half the 700ms the SM took for a half turn at
+ *  a steady 7ms a full-step. The top speed comes from the profile, not the motor, so it
+ *  still has to be checked on the robot (see SM.c).
+ *
+ *  Steps are counted over a long run of the IR head's moves (to the orientations IROBOT
+ *  turns it to), some waited for and some left queued, with time let pass between them
+ *  or not. The half-steps pulsed out each way must add up to the half-steps asked for,
+ *  and the moves run must leave the head where SM says it is. The same run is then
+ *  stepped and timed turning straight to each orientation, and via the front first as
+ *  IROBOT used to.
+ *
+ *  @author A.Pope
+ *  @date 17-10-2016
+ */
+#include <math.h>
+#include "test.h"
+#include "pic.h"
+
+static void pulse(void);
+#undef NOP
+#define NOP() pulse() /* The step pin is high for the NOP between setting and clearing it */
+
+#include "SM.c"
+#include "SPI.c"
+
+#define T2_COUNT_US 51.2 /* Timer2 count, Fosc/4 through both 1:16 scalers */
+#define MAX_PULSES  1000
+#define MAX_MOVES   16
+#define HALF_TURN   200  /* SM_STEPS_FOR_180, for the array sizes */
+
+/* The profile the ramp was made from */
+#define DEG_PER_STEP 0.9     /* A half-step */
+#define START_SPEED  257.0   /* deg/s */
+#define RAMP_ACCEL   10000.0 /* deg/s^2 */
+#define TOP_SPEED    1030.0  /* deg/s */
+#define STEADY_MS    700.0   /* A half turn at 7ms a full-step, before the ramp */
+
+#define HEAD_MOVES   600     /* Moves of the IR head in the step count */
+
+typedef struct {
+  double us;       /* When the pin went high */
+  uint8_t size;    /* Half-steps the control byte said a pulse was */
+  TDIRECTION dir;
+  uint8_t move;    /* Move it was part of, in the order they started */
+} TPULSE;
+
+static TPULSE pulses[MAX_PULSES]; /*< Pulses since the last clear() */
+static int pulseCount;
+static double moveStart[MAX_MOVES]; /*< When each move was taken from the queue */
+static uint8_t moveCount;
+static double nowUs;                /*< Simulated time */
+static double nextTick;             /*< When Timer2 next matches PR2 */
+static bool timerOn;                /*< TRUE once Timer2's next match has been worked out */
+static long emitted[2];             /*< Half-steps pulsed out CW and CCW, never cleared */
+
+/*! @brief The step pin is high, records the pulse. */
+static void pulse(void){
+  TPULSE * p = &pulses[pulseCount];
+
+  CHECK(RC2 == 1);
+  CHECK((SSPBUF & ENABLE_MASK) && (SSPBUF & CLK_PIC_MASK)); //The module is enabled and clocked by the PIC
+  emitted[(SSPBUF & DIR_CCW) ? 1 : 0] += (SSPBUF & H_STEP_MASK) ? 1 : 2;
+  if(pulseCount == MAX_PULSES)
+    return;
+  p->us = nowUs;
+  p->size = (SSPBUF & H_STEP_MASK) ? 1 : 2;
+  p->dir = (TDIRECTION) (SSPBUF & DIR_CCW);
+  p->move = moveCount - 1;
+  pulseCount++;
+}
+
+/*! @brief Moves the simulated time on, Timer2 interrupting whenever it matches PR2. */
+static void runTimer(unsigned long us){
+  double end = nowUs + us;
+  bool idle;
+
+  for(;;){
+    if(!T2CONbits.TMR2ON){
+      timerOn = false;
+      break;
+    }
+    if(!timerOn){
+      timerOn = true; //Just started, from TMR2 = 0
+      nextTick = nowUs + ((PR2 + 1) * T2_COUNT_US);
+    }
+    if(nextTick > end)
+      break;
+
+    nowUs = nextTick;
+    if(PIE1bits.TMR2IE){
+      idle = (stepsLeft == 0);
+      SM_Tick();
+      if(idle && stepsLeft != 0 && moveCount < MAX_MOVES)
+        moveStart[moveCount++] = nowUs;
+    }
+    nextTick = nowUs + ((PR2 + 1) * T2_COUNT_US);
+  }
+  nowUs = end;
+}
+
+/*! @brief Lets Timer2 step out every queued move. */
+static void runAll(void){
+  long ms;
+
+  for(ms = 0; !SM_IsDone() && ms < 10000; ms++)
+    runTimer(1000);
+  CHECK(SM_IsDone());
+}
+
+static void clear(void){
+  pulseCount = 0;
+  moveCount = 0;
+}
+
+/*! @brief Checks a move's pulses came at the periods of the ramp.
+ *
+ *  @param first - Index of its first pulse
+ *  @param steps - Half-steps in the move
+ *  @param size - Half-steps a pulse
+ */
+static void checkRamp(int first, uint16_t steps, uint8_t size){
+  int i, n = steps / size;
+  uint16_t done, left, ramp;
+  double want;
+
+  for(i = 0; i < (n - 1); i++){
+    //The wait between two pulses is the entry of whichever end of the move is closer
+    done = i * size;
+    left = steps - ((i + 2) * size);
+    ramp = (done < left) ? done : left;
+    if(ramp >= SM_RAMP_STEPS)
+      ramp = SM_RAMP_STEPS - 1;
+    want = SmRamp[ramp] * size * T2_COUNT_US;
+    CHECK(fabs((pulses[first + i + 1].us - pulses[first + i].us) - want) < 0.01);
+  }
+}
+
+/*! @brief Checks a lone move, from a call to SM_Move to the SM being turned off.
+ *
+ *  @param size - Half-steps a pulse the move should take
+ */
+static void checkMove(uint16_t steps, TDIRECTION dir, uint8_t size){
+  uint16_t from = SM_GetOrientation(), want;
+  double start = nowUs;
+  int i, n = steps / size;
+
+  want = (dir == DIR_CW) ? ((from + steps) % (2 * HALF_TURN)) : ((from + (2 * HALF_TURN) - steps) % (2 * HALF_TURN));
+  clear();
+  CHECK(SM_Move(steps, dir) == want);
+  CHECK(SM_GetOrientation() == want);
+
+  CHECK(pulseCount == n && moveCount == 1);
+  for(i = 0; i < pulseCount; i++)
+    CHECK(pulses[i].size == size && pulses[i].dir == dir && pulses[i].move == 0);
+  CHECK(fabs(pulses[0].us - start - (2 * T2_COUNT_US)) < 0.01); //A tick to send the control byte, then the first pulse
+  checkRamp(0, steps, size);
+
+  //Speeds up and slows down alike
+  for(i = 0; i < (n - 1); i++)
+    CHECK(fabs((pulses[i + 1].us - pulses[i].us) - (pulses[n - 1 - i].us - pulses[n - 2 - i].us)) < 0.01);
+
+  //Then the SM is turned off and Timer2 stopped
+  CHECK(SSPBUF == 0 && stepSize == 0);
+  CHECK(!T2CONbits.TMR2ON);
+}
+
+/*! @brief Queues more moves than there is room for, each from a SM_MoveTo. */
+static void checkQueue(void){
+  static const uint16_t targets[SM_QUEUE_SIZE + 1] = { 100, 50, 350, 0, 200 };
+  static const uint16_t steps[SM_QUEUE_SIZE + 1] = { 100, 50, 100, 50, 200 };
+  static const TDIRECTION dirs[SM_QUEUE_SIZE + 1] = { DIR_CW, DIR_CCW, DIR_CCW, DIR_CW, DIR_CW };
+  unsigned long before;
+  int i, first = 0;
+  uint8_t m;
+
+  clear();
+  before = mock_delayed_us;
+  for(i = 0; i < SM_QUEUE_SIZE; i++)
+    SM_MoveTo(targets[i]);
+  CHECK(mock_delayed_us == before && queueLen == SM_QUEUE_SIZE && moveCount == 0);
+
+  //The last has to wait for the oldest to start, and no longer
+  SM_MoveTo(targets[SM_QUEUE_SIZE]);
+  CHECK(mock_delayed_us > before && moveCount == 1);
+  CHECK(nowUs >= moveStart[0] && nowUs < (moveStart[0] + SM_WAIT_US));
+  CHECK(queueLen == SM_QUEUE_SIZE && SM_GetOrientation() == targets[SM_QUEUE_SIZE]);
+
+  runAll();
+  CHECK(moveCount == (SM_QUEUE_SIZE + 1));
+  for(m = 0; m <= SM_QUEUE_SIZE; m++){
+    for(i = first; i < pulseCount && pulses[i].move == m; i++)
+      CHECK(pulses[i].dir == dirs[m] && pulses[i].size == 2);
+    CHECK((i - first) * 2 == steps[m]);
+    checkRamp(first, steps[m], 2);
+    first = i;
+  }
+  CHECK(first == pulseCount);
+}
+
+/*! @brief Turns to every orientation from a few others, checking the shorter way is taken. */
+static void checkMoveTo(void){
+  static const uint16_t froms[] = { 0, 37, 200, 399 };
+  uint16_t from, target, delta;
+  uint8_t f;
+  int i, cw;
+
+  for(f = 0; f < (sizeof(froms) / sizeof(froms[0])); f++){
+    for(target = 0; target < (2 * HALF_TURN); target++){
+      from = froms[f];
+      SM_MoveTo(from);
+      runAll();
+      CHECK(SM_GetOrientation() == from);
+
+      clear();
+      SM_MoveTo(target);
+      runAll();
+      CHECK(SM_GetOrientation() == target);
+
+      cw = 0;
+      for(i = 0; i < pulseCount; i++)
+        cw += (pulses[i].dir == DIR_CW) ? pulses[i].size : -pulses[i].size;
+      delta = (target + (2 * HALF_TURN) - from) % (2 * HALF_TURN);
+      CHECK(cw == ((delta > HALF_TURN) ? ((int) delta - (2 * HALF_TURN)) : delta));
+      CHECK(moveCount == (delta != 0));
+    }
+  }
+}
+
+/*! @brief Speed of the profile once a number of half-steps have been made. */
+static double profileSpeed(uint16_t halfSteps){
+  double speed = sqrt((START_SPEED * START_SPEED) + (2 * RAMP_ACCEL * DEG_PER_STEP * halfSteps));
+
+  return (speed < TOP_SPEED) ? speed : TOP_SPEED;
+}
+
+/*! @brief Times a turn from the call to SM_Move until SM_IsDone, in ms. */
+static double turnMs(uint16_t steps){
+  double start = nowUs;
+
+  clear();
+  SM_Move(steps, DIR_CW);
+  return (nowUs - start) / 1000;
+}
+
+/*! @brief The step timing model, checking each step against the profile and timing turns. */
+static void checkModel(void){
+  double want, top = 0, ms[3][2];
+  uint8_t size, t;
+  int i;
+
+  //Each step of a full turn against the profile, speeding up (the slowing down mirrors it)
+  for(size = 1; size <= 2; size++){
+    SM_SetHalfStep(size == 1);
+    turnMs(4 * HALF_TURN);
+    CHECK(pulseCount == ((4 * HALF_TURN) / size));
+    for(i = 0; i < (pulseCount / 2); i++){
+      want = (DEG_PER_STEP * size * 1e6) / profileSpeed(i * size);
+      CHECK(fabs((pulses[i + 1].us - pulses[i].us) - want) <= ((size * T2_COUNT_US) / 2));
+      if(((DEG_PER_STEP * size * 1e6) / (pulses[i + 1].us - pulses[i].us)) > top)
+        top = (DEG_PER_STEP * size * 1e6) / (pulses[i + 1].us - pulses[i].us);
+    }
+    CHECK(fabs((pulses[1].us - pulses[0].us) - (3500.0 * size)) <= (size * T2_COUNT_US));
+
+    //Turns of 45, 90 and 180 degrees
+    for(t = 0; t < 3; t++)
+      ms[t][size - 1] = turnMs(HALF_TURN >> (2 - t));
+    CHECK(ms[2][size - 1] <= (STEADY_MS / 2));
+  }
+  CHECK(top >= (TOP_SPEED - 1) && top <= (TOP_SPEED * 1.01));
+
+  printf("SM turns, half-steps (full-steps): 45 deg %.0f ms (%.0f), 90 deg %.0f ms (%.0f), 180 deg %.0f ms (%.0f), was %.0f ms;"
+         " top speed %.0f deg/s\n", ms[0][0], ms[0][1], ms[1][0], ms[1][1], ms[2][0], ms[2][1], STEADY_MS, top);
+}
+
+/*! @brief Turns the IR head about as IROBOT does, checking every half-step asked for is
+ *         pulsed out. Returns the half-steps moved.
+ *
+ *  @param viaFront - TRUE to turn to the front before each orientation, as resetIRPos did
+ *  @param queued - TRUE to leave some moves queued, and let time pass between others
+ *  @param ms - Returns the time spent
+ */
+static long headRun(bool viaFront, bool queued, double * ms){
+  static const uint16_t heads[] = { 0, 50, 350, 200, 100, 300 }; /* IR_FRONT, the 45s, IR_BACK and scanBox's sides */
+  long asked[2] = { 0, 0 }, before[2];
+  uint16_t at = SM_GetOrientation(), target, delta;
+  uint32_t seed = 12345;
+  double start = nowUs;
+  int i, leg;
+
+  before[0] = emitted[0]; before[1] = emitted[1];
+  for(i = 0; i < HEAD_MOVES; i++){
+    seed = (seed * 1103515245) + 12345;
+    for(leg = viaFront ? 0 : 1; leg < 2; leg++){
+      target = (leg == 0) ? 0 : heads[(seed >> 16) % (sizeof(heads) / sizeof(heads[0]))];
+      delta = (target + (2 * HALF_TURN) - at) % (2 * HALF_TURN);
+      if(delta > HALF_TURN)
+        asked[1] += (2 * HALF_TURN) - delta;
+      else
+        asked[0] += delta;
+      at = target;
+      SM_MoveTo(target);
+    }
+
+    if(!queued)
+      runAll();
+    else if(((seed >> 8) % 3) == 0)
+      runTimer((seed >> 4) % 300000); //Partly done before the next
+    else if(((seed >> 8) % 3) == 1)
+      runAll();                       //Else queued straight behind it
+  }
+  runAll();
+
+  CHECK(SM_GetOrientation() == at);
+  CHECK((emitted[0] - before[0]) == asked[0] && (emitted[1] - before[1]) == asked[1]);
+  CHECK(((((emitted[0] - emitted[1]) % (2 * HALF_TURN)) + (2 * HALF_TURN)) % (2 * HALF_TURN)) == at); //Where every pulse so far leaves the head
+  *ms = (nowUs - start) / 1000;
+
+  return asked[0] + asked[1];
+}
+
+/*! @brief Counts the half-steps pulsed out against those asked for, and what turning
+ *         straight to each orientation saves.
+ */
+static void checkCounts(void){
+  long direct, viaFront;
+  double directMs, viaFrontMs;
+
+  SM_SetHalfStep(false);
+  headRun(false, true, &directMs);
+  headRun(true, true, &directMs);
+  SM_SetHalfStep(true);
+  headRun(false, true, &directMs);
+
+  SM_SetHalfStep(false);
+  direct = headRun(false, false, &directMs);
+  viaFront = headRun(true, false, &viaFrontMs);
+  CHECK(direct < viaFront && directMs < viaFrontMs);
+  printf("IR head, %d moves: %ld half-steps in %.1f s, via the front %ld half-steps in %.1f s\n",
+         HEAD_MOVES, direct, directMs / 1000, viaFront, viaFrontMs / 1000);
+}
+
+int main(void){
+  mock_delay_hook = runTimer;
+  CHECK(SM_Init());
+  CHECK(SM_STEPS_FOR_180 == HALF_TURN);
+  CHECK(T2CON == SM_T2CON && !T2CONbits.TMR2ON && PIE1bits.TMR2IE);
+  CHECK(SM_IsDone() && SM_GetOrientation() == 0);
+
+  //Half-steps, full-steps, and odd moves which can only be half-stepped
+  SM_SetHalfStep(true);
+  checkMove(200, DIR_CW, 1);
+  checkMove(3, DIR_CCW, 1);
+  checkMove(150, DIR_CCW, 1);
+  SM_SetHalfStep(false);
+  checkMove(200, DIR_CCW, 2);
+  checkMove(2, DIR_CW, 2);
+  checkMove(7, DIR_CW, 1);
+  checkMove(400, DIR_CW, 2);
+
+  //Nothing to do, nothing started
+  clear();
+  CHECK(SM_Move(0, DIR_CW) == SM_GetOrientation());
+  CHECK(pulseCount == 0 && !T2CONbits.TMR2ON);
+
+  SM_MoveTo(0);
+  runAll();
+  checkQueue();
+  checkMoveTo();
+  checkModel();
+  checkCounts();
+
+  return TEST_DONE("test_sm");
+}
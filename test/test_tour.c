@@ -0,0 +1,106 @@
+/*! @file test_tour.c
+ *
+ *  @brief Checks TOUR's orders against trying every order.
+ *
+ *  The course's way-points are ordered from every box, then random distances are put
+ *  straight into the pair table. Each time the exact search must find an order as good
+ *  as the best of every order tried one by one, the heuristic no better, and TOUR_Order
+ *  must hand back the same way-points.
+ *
+ *  @author A.Pope
+ *  @date 17-10-2016
+ */
+#include <stdlib.h>
+#include "test.h"
+#include "PATH.c"
+#include "TOUR.c"
+
+#define RANDOM_TABLES 500 /* Random distance tables ordered */
+
+/*! @brief Tries every order of the way-points.
+ *
+ *  @return cost - The lowest tour cost of any order
+ */
+static TTOUR_COST bruteForce(uint8_t num){
+  uint8_t order[TOUR_MAX_POINTS], i, j, tmp;
+  TTOUR_COST cost, best;
+
+  for(i = 0; i < num; i++)
+    order[i] = i;
+  best = tourCost(order, num);
+
+  //Next permutation in lexicographic order, until the last
+  for(;;){
+    for(i = num - 1; i > 0 && order[i - 1] >= order[i]; i--);
+    if(i == 0)
+      break;
+    for(j = num - 1; order[j] <= order[i - 1]; j--);
+    tmp = order[i - 1]; order[i - 1] = order[j]; order[j] = tmp;
+    for(j = num - 1; i < j; i++, j--){
+      tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+    }
+
+    cost = tourCost(order, num);
+    if(cost < best)
+      best = cost;
+  }
+
+  return best;
+}
+
+/*! @brief Orders the points already in dist, and checks both searches. */
+static void checkOrders(uint8_t num){
+  TTOUR_COST best = bruteForce(num), heuristic;
+  uint16_t seen = 0;
+  uint8_t i;
+
+  orderHeuristic(num);
+  heuristic = tourCost(bestOrder, num);
+  orderExact(num);
+  CHECK(tourCost(bestOrder, num) == best);
+  CHECK(heuristic >= best);
+
+  for(i = 0; i < num; i++)
+    seen |= (1 << bestOrder[i]);
+  CHECK(seen == ((1 << num) - 1)); //Every way-point exactly once
+}
+
+int main(void){
+  static const TORDINATE waypoints[MAZE_NUM_WAYPOINTS] = MAZE_WAYPOINTS;
+  TORDINATE list[TOUR_MAX_POINTS], start, home = MAZE_HOME;
+  uint8_t num, i, j, k, pairs;
+  int table;
+
+  PATH_Init();
+  num = (MAZE_NUM_WAYPOINTS < TOUR_MAX_POINTS) ? (MAZE_NUM_WAYPOINTS + 1) : TOUR_MAX_POINTS;
+
+  //The course's way-points and home, from every box
+  for(start.x = 0; start.x < MAZE_WIDTH; start.x++)
+    for(start.y = 0; start.y < MAZE_HEIGHT; start.y++){
+      for(i = 0; i < (num - 1); i++)
+        list[i] = waypoints[i];
+      list[num - 1] = home;
+
+      buildDistances(start, list, num);
+      checkOrders(num);
+
+      TOUR_Order(start, list, num);
+      for(i = 0; i < (num - 1); i++){
+        for(j = 0, k = 0; j < num; j++)
+          k += (list[j].x == waypoints[i].x && list[j].y == waypoints[i].y);
+        CHECK(k == 1);
+      }
+    }
+
+  //Random distances, including some that can't be reached
+  srand(1);
+  for(table = 0; table < RANDOM_TABLES; table++){
+    num = 2 + (rand() % (TOUR_MAX_POINTS - 1));
+    pairs = ((num + 1) * num) / 2;
+    for(i = 0; i < pairs; i++)
+      dist[i] = (rand() % 16 == 0) ? UNREACHABLE : (TTOUR_DIST) (rand() % PATH_MAP_CELLS);
+    checkOrders(num);
+  }
+
+  return TEST_DONE("test_tour");
+}
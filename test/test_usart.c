@@ -0,0 +1,232 @@
+/*! @file test_usart.c
+ *
+ *  @brief Checks the USART ring buffers by playing the part of the hardware.
+ *
+ *  Bytes are put in RCREG and USART_RxTick called, as the receive interrupt would, and
+ *  USART_TxTick is called while TXIE is on, taking each byte from TXREG. The delay stub
+ *  stands in for time passing while USART_InChar waits. With interrupts off, TXIF is
+ *  set so USART_OutChar can send bytes by hand.
+ *
+ *  @author A.Pope
+ *  @date 17-10-2016
+ */
+#include <stdlib.h>
+#include "test.h"
+#include "USART.c"
+
+#define BYTE_US  174 /* Time a byte takes at 57600 baud (us) */
+#define TICK_US  1000 /* Time between the 1ms ticks that read the stream (us) */
+
+static unsigned long lateUs;  /*< Delay after which lateByte arrives, 0 if nothing is coming */
+static uint8_t lateByte;
+
+/*! @brief The receive interrupt, with a byte in RCREG. */
+static void receive(uint8_t data){
+  RCREG = data;
+  PIR1bits.RCIF = 1;
+  USART_RxTick();
+}
+
+/*! @brief The transmit interrupt, while it is on.
+ *
+ *  @return int - The byte sent, or -1 if there was nothing to send
+ */
+static int transmit(void){
+  TXREG = 0;
+  if(!PIE1bits.TXIE)
+    return -1;
+
+  USART_TxTick();
+  return PIE1bits.TXIE ? TXREG : -1;
+}
+
+/*! @brief Delivers lateByte once USART_InChar has waited long enough. */
+static void deliverLate(unsigned long us){
+  (void) us;
+  if(lateUs && mock_delayed_us >= lateUs){
+    lateUs = 0;
+    receive(lateByte);
+  }
+}
+
+static void checkInit(void){
+  USART_Init();
+  CHECK(SPBRG == BAUD_57600);
+  CHECK(PIE1bits.RCIE && !PIE1bits.TXIE && INTCONbits.PEIE);
+  CHECK(RCSTAbits.SPEN && RCSTAbits.CREN && TXSTAbits.TXEN);
+}
+
+static void checkReceive(void){
+  TUSART_OVERRUNS overruns;
+  uint8_t data, sent = 0, read = 0, i, n;
+  int round;
+
+  USART_Init();
+  CHECK(!USART_ReadChar(&data));
+
+  //Bytes come back in order while the indexes wrap round many times
+  srand(1);
+  for(round = 0; round < 500; round++){
+    n = rand() % (RX_SIZE + 1);
+    for(i = 0; i < n; i++)
+      receive(sent++);
+    for(i = 0; i < n; i++)
+      CHECK(USART_ReadChar(&data) && data == read++);
+    CHECK(!USART_ReadChar(&data));
+  }
+  USART_GetOverruns(&overruns);
+  CHECK(overruns.hardware == 0 && overruns.buffer == 0);
+
+  //A full buffer keeps the oldest bytes and counts the rest
+  for(i = 0; i < (RX_SIZE + 3); i++)
+    receive(i);
+  USART_GetOverruns(&overruns);
+  CHECK(overruns.buffer == 3);
+  for(i = 0; i < RX_SIZE; i++)
+    CHECK(USART_ReadChar(&data) && data == i);
+  CHECK(!USART_ReadChar(&data));
+
+  //The counts stop at 255
+  for(i = 0; i < RX_SIZE; i++)
+    receive(i);
+  for(round = 0; round < 300; round++)
+    receive(0);
+  USART_GetOverruns(&overruns);
+  CHECK(overruns.buffer == 255);
+}
+
+static void checkHardwareOverrun(void){
+  TUSART_OVERRUNS overruns;
+  uint8_t data;
+
+  USART_Init();
+  RCSTAbits.OERR = 1;
+  CREN = 0;
+  receive(0x42);
+  RCSTAbits.OERR = 0;
+  USART_GetOverruns(&overruns);
+  CHECK(overruns.hardware == 1 && overruns.buffer == 0);
+  CHECK(CREN); //The receiver is running again
+  CHECK(USART_ReadChar(&data) && data == 0x42);
+}
+
+static void checkInChar(void){
+  uint8_t data = 0;
+
+  USART_Init();
+  mock_delay_hook = deliverLate;
+
+  //Nothing comes: gives up after the timeout
+  mock_delayed_us = 0;
+  CHECK(!USART_InChar(&data, 5));
+  CHECK(mock_delayed_us == 5000);
+
+  //A byte comes part way through
+  mock_delayed_us = 0;
+  lateUs = 2300; lateByte = 0x99;
+  CHECK(USART_InChar(&data, 5) && data == 0x99);
+  CHECK(mock_delayed_us >= 2300 && mock_delayed_us < 2500);
+
+  //Already waiting: no delay at all
+  receive(0x17);
+  mock_delayed_us = 0;
+  CHECK(USART_InChar(&data, 5) && data == 0x17);
+  CHECK(mock_delayed_us == 0);
+
+  //Timeouts too long to count in 100us waits in 16 bits
+  mock_delayed_us = 0;
+  CHECK(!USART_InChar(&data, 7000));
+  CHECK(mock_delayed_us == 7000000UL);
+  mock_delayed_us = 0;
+  CHECK(!USART_InChar(&data, 65535));
+  CHECK(mock_delayed_us == 65535000UL);
+
+  mock_delay_hook = 0;
+}
+
+static void checkTransmit(void){
+  const uint8_t command[] = {145, 0, 200, 0, 200, 137, 0, 0};
+  uint8_t next = 0, sent = 0;
+  int round, data, i;
+
+  USART_Init();
+  CHECK(transmit() == -1);
+
+  //A command is queued without waiting, and sent in order in the background
+  USART_Write(command, sizeof(command));
+  CHECK(PIE1bits.TXIE);
+  for(i = 0; i < (int) sizeof(command); i++)
+    CHECK(transmit() == command[i]);
+  CHECK(transmit() == -1 && !PIE1bits.TXIE);
+
+  //Bytes stay in order while the indexes wrap round many times
+  srand(2);
+  for(round = 0; round < 500; round++){
+    for(i = rand() % (TX_SIZE + 1); i > 0; i--)
+      USART_OutChar(next++);
+    while((data = transmit()) != -1)
+      CHECK(data == sent++);
+    CHECK(sent == next);
+  }
+}
+
+/*! @brief With interrupts off, a full buffer is emptied by hand rather than waited on. */
+static void checkTransmitNoInterrupts(void){
+  uint8_t i;
+  int data;
+
+  USART_Init();
+  INTCONbits.GIE = 0;
+  PIR1bits.TXIF = 1; //TXREG free whenever it is looked at
+  for(i = 0; i < (TX_SIZE + 5); i++)
+    USART_OutChar(i);
+  CHECK(TXREG == 4); //The first 5 went by hand, oldest first
+  CHECK((uint8_t) (txHead - txTail) == TX_SIZE);
+  for(i = 5; i < (TX_SIZE + 5); i++)
+    CHECK((data = transmit()) == i);
+  CHECK(transmit() == -1);
+
+  //With room in the buffer nothing is sent by hand
+  TXREG = 0;
+  USART_OutChar(0x55);
+  CHECK(TXREG == 0 && transmit() == 0x55);
+  PIR1bits.TXIF = 0;
+}
+
+/*! @brief The Create streaming without a break, read every 1ms tick. */
+static void checkStreamRate(void){
+  TUSART_OVERRUNS overruns;
+  uint8_t data, sent = 0, read = 0, waiting, most = 0;
+  long us, nextByte = 0;
+
+  USART_Init();
+  for(us = 0; us < 1000000; us++){
+    if(us == nextByte){
+      receive(sent++);
+      nextByte += BYTE_US;
+    }
+    if((us % TICK_US) == (TICK_US - 1)){
+      waiting = (uint8_t) (rxHead - rxTail);
+      if(waiting > most)
+        most = waiting;
+      while(USART_ReadChar(&data))
+        CHECK(data == read++);
+    }
+  }
+
+  USART_GetOverruns(&overruns);
+  CHECK(overruns.buffer == 0);
+  CHECK(most <= ((TICK_US / BYTE_US) + 1) && most < RX_SIZE);
+}
+
+int main(void){
+  checkInit();
+  checkReceive();
+  checkHardwareOverrun();
+  checkInChar();
+  checkTransmit();
+  checkTransmitNoInterrupts();
+  checkStreamRate();
+
+  return TEST_DONE("test_usart");
+}
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""Generates the IR sensor distance tables.
+
+Evaluates the calibration of the short and long range IR distance sensors for
+every raw ADC value, and writes a header holding the distance in whole
+millimetres for each one. IR can then convert a reading with a single lookup,
+rather than picking a calibration segment and dividing in floating point on
+the PIC.
+
+Short range readings at or above the closest calibration segment (under 20cm)
+read as 0, so the table stops there rather than covering all 1024 ADC values.
+The long range table only covers the readings the sensor gives between its
+nearest and furthest distances.
+
+Usage:
+    tools/irgen.py [-o src/IRTABLE.h] [--report]
+"""
+import argparse
+import os
+
+# Calibration segments of the sensor, (lowest ADC value, first ADC value above
+# the segment, ADC value at 0cm, ADC change per cm). Within a segment the
+# distance is (adc - intercept) / slope cm. Below the last segment the sensor
+# can't see a wall, which reads as 150cm.
+SEGMENTS = (
+    (379, 510, 772, -13.1),  # 20-30cm
+    (295, 379, 631, -8.4),   # 30-40cm
+    (240, 295, 515, -5.5),   # 40-50cm
+    (197, 240, 455, -4.3),   # 50-60cm
+    (173, 197, 341, -2.4),   # 60-70cm
+    (153, 173, 313, -2),     # 70-80cm
+    (137, 153, 281, -1.6),   # 80-90cm
+    (122, 137, 272, -1.5),   # 90-100cm
+    (108, 122, 262, -1.4),   # 100-110cm
+    (99, 108, 207, -0.9),    # 110-120cm
+    (91, 99, 195, -0.8),     # 120-130cm
+    (83, 91, 195, -0.8),     # 130-140cm
+    (78, 83, 152, -0.5),     # 140-150cm
+)
+FAR_CM = 150
+
+# Calibration of the long range sensor (AN1), distance = LONG_SCALE / (adc - LONG_OFFSET) cm
+# between LONG_NEAR_CM and LONG_FAR_CM. Closer than LONG_NEAR_CM its output falls again, so
+# those readings can't be told apart from far ones. This is the typical curve from the
+# datasheet of a 100-550cm Sharp sensor with a 5V reference, re-measure it with the robot.
+LONG_SCALE = 34526
+LONG_OFFSET = 166
+LONG_NEAR_CM = 100
+LONG_FAR_CM = 550
+
+ADC_VALUES = 1024  # 10-bit ADC
+
+REPO = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def distance_mm(adc):
+    """Returns the calibrated distance (mm) of a raw ADC value, as a real number."""
+    for low, high, intercept, slope in SEGMENTS:
+        if low <= adc < high:
+            return (adc - intercept) / slope * 10
+    if adc < SEGMENTS[-1][0]:
+        return FAR_CM * 10
+    return 0.0  # Closer than the sensor is calibrated for
+
+
+def long_distance_mm(adc):
+    """Returns the calibrated distance (mm) of a raw long range ADC value, as a real number."""
+    return LONG_SCALE / (adc - LONG_OFFSET) * 10
+
+
+def build_table():
+    size = max(high for _, high, _, _ in SEGMENTS)
+    return [int(distance_mm(adc) + 0.5) for adc in range(size)]
+
+
+def build_long_table():
+    """Returns (first ADC value, table) for the long range sensor."""
+    first = next(adc for adc in range(LONG_OFFSET + 1, ADC_VALUES) if long_distance_mm(adc) <= LONG_FAR_CM * 10)
+    last = max(adc for adc in range(first, ADC_VALUES) if long_distance_mm(adc) >= LONG_NEAR_CM * 10)
+    return first, [int(long_distance_mm(adc) + 0.5) for adc in range(first, last + 1)]
+
+
+def write_array(out, name, size, table):
+    out.write("static const uint16_t %s[%s] = {\n" % (name, size))
+    for i in range(0, len(table), 12):
+        row = ", ".join("%4d" % v for v in table[i:i + 12])
+        out.write("  " + row + ("," if i + 12 < len(table) else "") + "\n")
+    out.write("};\n\n")
+
+
+def write_header(path, table, first, long_table):
+    with open(path, "w") as out:
+        out.write("/*! @file %s\n" % os.path.basename(path))
+        out.write(" *\n")
+        out.write(" *  @brief Distance (mm) measured by the IR sensor for each raw ADC value.\n")
+        out.write(" *\n")
+        out.write(" *  GENERATED by tools/irgen.py from the sensor calibration - do not edit.\n")
+        out.write(" *  Re-run the generator whenever the calibration changes.\n")
+        out.write(" *\n")
+        out.write(" *  IrDistance[adc] = distance to the wall from the short range sensor, rounded to\n")
+        out.write(" *  the nearest mm. ADC values of IR_TABLE_SIZE and above are closer than the sensor\n")
+        out.write(" *  is calibrated for.\n")
+        out.write(" *\n")
+        out.write(" *  IrLongDistance[adc - IR_LONG_FIRST] = the same for the long range sensor. ADC values\n")
+        out.write(" *  below IR_LONG_FIRST are further than it can see, and above the table closer. Only\n")
+        out.write(" *  built with IR_LONG_RANGE.\n")
+        out.write(" */\n")
+        out.write("#ifndef IRTABLE_H\n#define\tIRTABLE_H\n\n")
+        out.write("#define IR_TABLE_SIZE %d /* First ADC value the table doesn't cover */\n" % len(table))
+        out.write("#define IR_LONG_FIRST %d /* First ADC value in the long range table */\n" % first)
+        out.write("#define IR_LONG_SIZE  %d /* ADC values in the long range table */\n\n" % len(long_table))
+        write_array(out, "IrDistance", "IR_TABLE_SIZE", table)
+        out.write("#ifdef IR_LONG_RANGE\n")
+        write_array(out, "IrLongDistance", "IR_LONG_SIZE", long_table)
+        out.write("#endif\n\n")
+        out.write("#endif\t/* IRTABLE_H */\n")
+
+
+def report(table, first, long_table):
+    worst = max(abs(table[adc] - distance_mm(adc)) for adc in range(len(table)))
+    print("short range:    %d of %d ADC values (%d bytes of program memory)" % (len(table), ADC_VALUES, len(table) * 2))
+    print("worst rounding: %.2f mm" % worst)
+    worst = max(abs(v - long_distance_mm(first + i)) for i, v in enumerate(long_table))
+    print("long range:     ADC %d to %d, %d mm to %d mm (%d bytes of program memory)"
+          % (first, first + len(long_table) - 1, long_table[0], long_table[-1], len(long_table) * 2))
+    print("worst rounding: %.2f mm" % worst)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("-o", "--output", default=os.path.join(REPO, "src", "IRTABLE.h"))
+    parser.add_argument("--report", action="store_true", help="check the tables against the calibration instead of writing them")
+    args = parser.parse_args()
+
+    table = build_table()
+    first, long_table = build_long_table()
+    if args.report:
+        report(table, first, long_table)
+        return
+
+    write_header(args.output, table, first, long_table)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,369 @@
+#!/usr/bin/env python3
+"""Generates the maze definition and its precomputed path tables.
+
+With --ascii, the maze is read from an ASCII drawing (src/MAZE.txt) and the
+maze definition (src/MAZE.h) is written from it first. Otherwise the maze is
+read from the maze definition. Either way, the walls are checked to match on
+both sides of every shared wall.
+
+Then writes a header holding, for every pair of boxes, the number of boxes on
+the shortest path between them and the map direction of the first move. Only
+physical walls are used, as virtual walls are only found during a run.
+
+The table is indexed [way-point][robot], so PATH can plan to a way-point with a
+single lookup while the maze only has its physical walls. With
+--waypoints-only, it only has rows for the home box and the way-points marked
+in the drawing, which is much smaller for large mazes.
+
+The drawing has a '+' at every corner. Walls between boxes are '---' or '|'
+for physical walls, '...' or ':' for virtual walls, and spaces for no wall.
+x runs down the page (Front is up), y runs across (Left is left). A box can
+be marked 'H' for home, or with a number for a way-point (visited in order
+of number). Lines starting with '#' are ignored, e.g.
+
+    +---+---+
+    | H   1 |
+    +   +---+
+    |   :   |
+    +---+---+
+
+Usage:
+    tools/mazegen.py [--ascii src/MAZE.txt] [-i src/MAZE.h] [-o src/MAZEHOPS.h]
+                     [--waypoints-only] [--report] [--to-ascii]
+"""
+import argparse
+import os
+import re
+import sys
+from collections import deque
+
+# Physical wall bits of a box (lower nibble), in map direction order:
+# 0 - Front (x - 1), 1 - Right (y + 1), 2 - Back (x + 1), 3 - Left (y - 1)
+# The same wall of any kind is the bit four higher.
+P_WALLS = (0b1000, 0b0100, 0b0010, 0b0001)
+STEPS = ((-1, 0), (0, 1), (1, 0), (0, -1))
+NAMES = ("front", "right", "back", "left")
+
+PIC_ROM_WORDS = 8192  # Program memory of the PIC16F877A
+
+REPO = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def parse_maze(path):
+    """Returns (width, height, walls) from a maze definition header."""
+    text = open(path).read()
+    width = int(re.search(r"#define\s+MAZE_WIDTH\s+(\d+)", text).group(1))
+    height = int(re.search(r"#define\s+MAZE_HEIGHT\s+(\d+)", text).group(1))
+
+    body = re.search(r"#define\s+MAZE_WALLS\s*((?:.*\\\n)*.*)", text).group(1)
+    values = [int(tok, 0) for tok in re.findall(r"\b(?:0b[01]+|0x[0-9a-fA-F]+|\d+)\b", body)]
+    if len(values) != width * height:
+        sys.exit("%s: expected %d wall bytes, found %d" % (path, width * height, len(values)))
+
+    walls = [values[x * height:(x + 1) * height] for x in range(width)]
+    return width, height, walls
+
+
+def parse_points(path):
+    """Returns (home, waypoints) from a maze definition header, or (None, []) if it has none."""
+    text = open(path).read()
+    home = re.search(r"#define\s+MAZE_HOME\s+\{\s*(\d+)\s*,\s*(\d+)\s*\}", text)
+    if home is None:
+        return None, []
+    points = re.search(r"#define\s+MAZE_WAYPOINTS\s+\{(.*)\}", text)
+    waypoints = re.findall(r"\{\s*(\d+)\s*,\s*(\d+)\s*\}", points.group(1)) if points else []
+    return (int(home.group(1)), int(home.group(2))), [(int(x), int(y)) for x, y in waypoints]
+
+
+def parse_ascii(path):
+    """Returns (width, height, walls, home, waypoints) from a maze drawing."""
+    lines = [line.rstrip("\n") for line in open(path) if not line.startswith("#") and line.strip()]
+    if len(lines) < 3 or len(lines) % 2 == 0 or not lines[0].startswith("+"):
+        sys.exit("%s: expected lines of corners and boxes in turn, starting and ending with corners" % path)
+
+    width = (len(lines) - 1) // 2
+    height = (len(lines[0].rstrip()) - 1) // 4
+    lines = [line.ljust(height * 4 + 1) for line in lines]
+    walls = [[0] * height for _ in range(width)]
+    home, numbered = None, {}
+
+    def wall(ch, physical, virtual, where):
+        if ch in physical:
+            return 0b10001
+        if ch in virtual:
+            return 0b10000
+        if ch.strip():
+            sys.exit("%s: unknown wall %r %s" % (path, ch, where))
+        return 0
+
+    for x in range(width + 1):
+        row = lines[x * 2]
+        for y in range(height):
+            bits = wall(row[y * 4 + 1:y * 4 + 4].strip()[:1] or " ", "-", ".",
+                        "above box (%d, %d)" % (x, y))
+            if x > 0:
+                walls[x - 1][y] |= bits * P_WALLS[2]
+            if x < width:
+                walls[x][y] |= bits * P_WALLS[0]
+
+        if x == width:
+            break
+
+        row = lines[x * 2 + 1]
+        for y in range(height + 1):
+            bits = wall(row[y * 4], "|", ":", "left of box (%d, %d)" % (x, y))
+            if y > 0:
+                walls[x][y - 1] |= bits * P_WALLS[1]
+            if y < height:
+                walls[x][y] |= bits * P_WALLS[3]
+
+            mark = row[y * 4 + 1:y * 4 + 4].strip() if y < height else ""
+            if mark == "H":
+                home = (x, y)
+            elif mark.isdigit():
+                numbered[int(mark)] = (x, y)
+            elif mark:
+                sys.exit("%s: unknown mark %r in box (%d, %d)" % (path, mark, x, y))
+
+    if home is None:
+        sys.exit("%s: no home box (H) marked" % path)
+
+    return width, height, walls, home, [numbered[n] for n in sorted(numbered)]
+
+
+def check_maze(path, width, height, walls):
+    """Exits if a wall isn't the same from both sides, or the outside of the maze is open."""
+    errors = []
+    for x in range(width):
+        for y in range(height):
+            box = walls[x][y]
+            if (box & 0x0F) & ~(box >> 4):
+                errors.append("box (%d, %d) has a physical wall that isn't in its upper nibble" % (x, y))
+            for d, (dx, dy) in enumerate(STEPS):
+                nx, ny = x + dx, y + dy
+                if not (0 <= nx < width and 0 <= ny < height):
+                    if not box & P_WALLS[d]:
+                        errors.append("box (%d, %d) has no physical %s wall on the outside" % (x, y, NAMES[d]))
+                    continue
+                opposite = (d + 2) % 4
+                mine = box & (P_WALLS[d] * 0b10001)
+                theirs = walls[nx][ny] & (P_WALLS[opposite] * 0b10001)
+                if (mine != 0) != (theirs != 0) or (mine & 0x0F != 0) != (theirs & 0x0F != 0):
+                    errors.append("box (%d, %d) %s wall doesn't match box (%d, %d) %s wall"
+                                  % (x, y, NAMES[d], nx, ny, NAMES[opposite]))
+
+    if errors:
+        sys.exit("%s: walls don't match\n  " % path + "\n  ".join(errors))
+
+
+def write_maze(path, source, width, height, walls, home, waypoints):
+    with open(path, "w") as out:
+        out.write("/*! @file %s\n" % os.path.basename(path))
+        out.write(" *\n")
+        out.write(" *  @brief Definition of the maze (competition arena) the robot runs in.\n")
+        out.write(" *\n")
+        out.write(" *  GENERATED by tools/mazegen.py from %s - do not edit. Change the\n" % os.path.basename(source))
+        out.write(" *  drawing and re-run the generator whenever the course changes.\n")
+        out.write(" *\n")
+        out.write(" *  This contains the size of the maze, the layout of its walls, and the home box\n")
+        out.write(" *  and way-points of a run. To run a different course, provide another file with\n")
+        out.write(" *  the same definitions and build with PATH_MAZE_FILE set to it (see PATH.h).\n")
+        out.write(" *\n")
+        out.write(" *  Each box in the maze holds one byte of wall information:\n")
+        out.write(" *    - Upper nibble: Walls of any kind (Front, Right, Back, Left)\n")
+        out.write(" *    - Lower nibble: Physical walls only (Front, Right, Back, Left)\n")
+        out.write(" *  'Front' is towards x = 0, 'Left' is towards y = 0. A wall shared by two boxes\n")
+        out.write(" *  is set in both of them.\n")
+        out.write(" */\n")
+        out.write("#ifndef MAZE_H\n#define\tMAZE_H\n\n")
+        out.write("#ifdef\t__cplusplus\nextern \"C\" {\n#endif\n\n")
+        out.write("#define MAZE_WIDTH  %d /* Number of boxes along the x ordinate */\n" % width)
+        out.write("#define MAZE_HEIGHT %d /* Number of boxes along the y ordinate */\n\n" % height)
+        out.write("#define MAZE_WALLS {" + " " * 38 + "\\\n")
+        for x in range(width):
+            row = "  {" + ", ".join("0b{:08b}".format(v) for v in walls[x]) + "}"
+            row += "," if x != width - 1 else ""
+            out.write(row.ljust(58) + "\\\n")
+        out.write("}\n\n")
+        out.write("#define MAZE_HOME          {%d, %d} /* Box the robot starts in, and returns to */\n" % home)
+        out.write("#define MAZE_NUM_WAYPOINTS %d /* Way-points visited on each lap, as well as home */\n" % len(waypoints))
+        out.write("#define MAZE_WAYPOINTS     {" + ", ".join("{%d, %d}" % p for p in waypoints) + "}\n\n")
+        out.write("#ifdef\t__cplusplus\n}\n#endif\n\n#endif\t/* MAZE_H */\n")
+
+
+def to_ascii(width, height, walls):
+    """Draws a maze in the form parse_ascii reads (without marks)."""
+    def horizontal(x, y):
+        bits = walls[x][y] if x < width else walls[x - 1][y]
+        d = 0 if x < width else 2
+        return "---" if bits & P_WALLS[d] else "..." if bits & (P_WALLS[d] << 4) else "   "
+
+    def vertical(x, y):
+        bits = walls[x][y] if y < height else walls[x][y - 1]
+        d = 3 if y < height else 1
+        return "|" if bits & P_WALLS[d] else ":" if bits & (P_WALLS[d] << 4) else " "
+
+    lines = []
+    for x in range(width + 1):
+        lines.append("+" + "+".join(horizontal(x, y) for y in range(height)) + "+")
+        if x < width:
+            lines.append("   ".join(vertical(x, y) for y in range(height + 1)))
+    return "\n".join(lines)
+
+
+def flood(width, height, walls, goal):
+    """Breadth first flood over the physical walls. Returns the distance to every box."""
+    dist = [[-1] * height for _ in range(width)]
+    dist[goal[0]][goal[1]] = 0
+    queue = deque([goal])
+
+    while queue:
+        x, y = queue.popleft()
+        for d, (dx, dy) in enumerate(STEPS):
+            nx, ny = x + dx, y + dy
+            if walls[x][y] & P_WALLS[d] or not (0 <= nx < width and 0 <= ny < height):
+                continue
+            if dist[nx][ny] == -1:
+                dist[nx][ny] = dist[x][y] + 1
+                queue.append((nx, ny))
+
+    return dist
+
+
+def hop_type(cells):
+    """Smallest C type holding (distance << 2 | direction), with all ones meaning no path."""
+    for name, bits in (("uint8_t", 8), ("uint16_t", 16), ("uint32_t", 32)):
+        if (cells - 1) < (1 << (bits - 2)) - 1:
+            return name, bits
+    sys.exit("maze too large for a hop table")
+
+
+def checksum(width, height, walls):
+    """Must match the check PATH_Init does on the map it was built with."""
+    total = 0
+    for x in range(width):
+        for y in range(height):
+            total = (total + ((x * height) + y + 1) * (walls[x][y] & 0x0F)) & 0xFFFF
+    return total
+
+
+def build_table(width, height, walls, goals):
+    cells = width * height
+    _, bits = hop_type(cells)
+    none = (1 << bits) - 1
+    table = []
+
+    for gx, gy in goals:
+        dist = flood(width, height, walls, (gx, gy))
+        row = []
+        for x in range(width):
+            for y in range(height):
+                if dist[x][y] == -1:
+                    row.append(none)
+                    continue
+                hop = 0
+                for d, (dx, dy) in enumerate(STEPS):
+                    nx, ny = x + dx, y + dy
+                    if (not walls[x][y] & P_WALLS[d] and 0 <= nx < width and 0 <= ny < height
+                            and dist[nx][ny] == dist[x][y] - 1):
+                        hop = d
+                        break
+                row.append((dist[x][y] << 2) | hop)
+        table.append(row)
+
+    return table
+
+
+def write_header(path, source, width, height, walls, table, rows=None):
+    cells = width * height
+    ctype, bits = hop_type(cells)
+    digits = bits // 4
+
+    with open(path, "w") as out:
+        out.write("/*! @file %s\n" % os.path.basename(path))
+        out.write(" *\n")
+        out.write(" *  @brief Precomputed shortest paths between every pair of boxes in the maze.\n")
+        out.write(" *\n")
+        out.write(" *  GENERATED by tools/mazegen.py from %s - do not edit. Re-run the\n" % os.path.basename(source))
+        out.write(" *  generator whenever the maze changes.\n")
+        out.write(" *\n")
+        out.write(" *  MazeHops[way-point box][robot box] = (boxes to the way-point << 2) | map direction\n")
+        out.write(" *  of the first move (0 - Front, 1 - Right, 2 - Back, 3 - Left). All ones if there is\n")
+        out.write(" *  no path. Boxes are numbered (x * MAZE_HEIGHT) + y.\n")
+        if rows is not None:
+            out.write(" *\n")
+            out.write(" *  Only the way-points in MazeHopRows have a row, MazeHops[i] being the row for\n")
+            out.write(" *  MazeHopRows[i]. Plans to any other box are flooded.\n")
+        out.write(" */\n")
+        out.write("#ifndef MAZEHOPS_H\n#define\tMAZEHOPS_H\n\n")
+        out.write("#if (MAZE_WIDTH != %d) || (MAZE_HEIGHT != %d)\n" % (width, height))
+        out.write("#error \"MAZEHOPS.h was generated for a different maze, re-run tools/mazegen.py\"\n")
+        out.write("#endif\n\n")
+        out.write("#define MAZE_HOPS_CHECK %d /* Checksum of the physical walls the table was built from */\n\n" % checksum(width, height, walls))
+        out.write("typedef %s TMAZE_HOP;\n\n" % ctype)
+        if rows is not None:
+            out.write("#define MAZE_HOPS_ROWS %d /* Way-points with a row in MazeHops */\n\n" % len(rows))
+            out.write("static const %s MazeHopRows[%d] = {" % (hop_type(cells)[0], len(rows)))
+            out.write(", ".join("%d" % (x * height + y) for x, y in rows) + "};\n\n")
+        out.write("static const TMAZE_HOP MazeHops[%d][%d] = {\n" % (len(table), cells))
+        for i, row in enumerate(table):
+            out.write("  {" + ", ".join("0x%0*X" % (digits, v) for v in row) + "}")
+            out.write(",\n" if i != len(table) - 1 else "\n")
+        out.write("};\n\n#endif\t/* MAZEHOPS_H */\n")
+
+
+def report(width, height, points):
+    print("%-12s %10s %12s %10s %16s" % ("maze", "bytes", "PIC words", "fits PIC", "way-points only"))
+    sizes = [(width, height), (8, 8), (16, 16), (32, 32), (64, 64)]
+    for w, h in sizes:
+        cells = w * h
+        _, bits = hop_type(cells)
+        size = cells * cells * bits // 8
+        words = size  # One RETLW instruction word per byte of const data
+        rows = points * cells * bits // 8 + points * bits // 8
+        print("%-12s %10d %12d %10s %16d" % ("%dx%d" % (w, h), size, words,
+                                               "yes" if words < PIC_ROM_WORDS // 2 else "no", rows))
+    print("Way-points only is for the %d boxes of a run (home and way-points)." % points)
+    print("Planning with the table is one lookup. A live flood visits up to every box.")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("-i", "--input", default=os.path.join(REPO, "src", "MAZE.h"))
+    parser.add_argument("-o", "--output", default=os.path.join(REPO, "src", "MAZEHOPS.h"))
+    parser.add_argument("--ascii", metavar="MAZE.txt", help="write the maze definition from this drawing first")
+    parser.add_argument("--waypoints-only", action="store_true",
+                        help="only build rows for the home box and way-points")
+    parser.add_argument("--report", action="store_true", help="print table sizes instead of writing it")
+    parser.add_argument("--to-ascii", action="store_true", help="print the maze definition as a drawing")
+    args = parser.parse_args()
+
+    if args.ascii:
+        width, height, walls, home, waypoints = parse_ascii(args.ascii)
+        check_maze(args.ascii, width, height, walls)
+        write_maze(args.input, args.ascii, width, height, walls, home, waypoints)
+    else:
+        width, height, walls = parse_maze(args.input)
+        check_maze(args.input, width, height, walls)
+        home, waypoints = parse_points(args.input)
+
+    if args.to_ascii:
+        print(to_ascii(width, height, walls))
+        return
+
+    rows = None
+    if args.waypoints_only:
+        if home is None:
+            sys.exit("%s: --waypoints-only needs MAZE_HOME and MAZE_WAYPOINTS" % args.input)
+        rows = sorted(set([home] + waypoints))
+
+    if args.report:
+        report(width, height, len(set([home] + waypoints)) if home is not None else 1)
+        return
+
+    goals = rows if rows is not None else [(x, y) for x in range(width) for y in range(height)]
+    write_header(args.output, args.input, width, height, walls, build_table(width, height, walls, goals), rows)
+
+
+if __name__ == "__main__":
+    main()